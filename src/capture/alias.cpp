@@ -68,6 +68,8 @@ void ka_set_aliases(const std::vector<mode_alias_s> &aliases)
 {
     ALIASES = aliases;
 
+    kc_prepare_mode_states();
+
     if (!kc_no_signal())
     {
         // If one of the aliases matches the current input resolution, change the
@@ -6,73 +6,249 @@
  *
  */
 
+#include <algorithm>
 #include <cstring>
 #include <atomic>
+#include <map>
+#include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <cmath>
 #include "common/command_line.h"
+#include "capture/capture_dump.h"
+#include "capture/frame_dedup.h"
+#include "capture/test_pattern.h"
+#include "capture/frame_ring.h"
 #include "common/propagate.h"
 #include "capture/capture.h"
 #include "display/display.h"
 #include "common/globals.h"
 #include "capture/alias.h"
+#include "filter/filter.h"
 #include "common/disk.h"
 
 // All local RGBEASY API callbacks lock this for their duration.
 std::mutex INPUT_OUTPUT_MUTEX;
 
-// Set to true upon first receiving a signal after 'no signal'.
-static bool SIGNAL_WOKE_UP = false;
-
-// If set to true, the scaler should skip the next frame we send.
-static u32 SKIP_NEXT_NUM_FRAMES = false;
+// The number of frames to be skipped, e.g. so as not to display the visual
+// corruption that changing the capture settings may cause; and when the change
+// was made. Only frames captured since then are skipped, as frames captured
+// before it may still be queued. See skip_frames_captured_since().
+static u32 SKIP_NEXT_NUM_FRAMES = 0;
+static std::chrono::steady_clock::time_point SKIP_FRAMES_SINCE;
 
 static std::vector<video_mode_params_s> KNOWN_MODES;
 
-// The color depth/format in which the capture hardware captures the frames.
-static PIXELFORMAT CAPTURE_PIXEL_FORMAT = RGB_PIXELFORMAT_888;
-
-// The color depth in which the capture hardware is expected to be sending the
-// frames. This depends on the current pixel format, such that e.g. formats
-// 555 and 565 are probably sent as 16-bit, and 888 as 32-bit.
-static u32 CAPTURE_OUTPUT_COLOR_DEPTH = 32;
-
-// Used to keep track of whether we have new frames to be processed (i.e. if the
-// current count of captured frames doesn't equal the number of processed frames).
-// Doesn't matter if these counters wrap around.
-static std::atomic<unsigned int> CNT_FRAMES_PROCESSED(0);
-static std::atomic<unsigned int> CNT_FRAMES_CAPTURED(0);
-
-// The number of frames the capture hardware has sent which VCS was too busy to
-// receive and had to skip. Call kc_reset_missed_frames_count() to reset it.
-static std::atomic<unsigned int> CNT_FRAMES_SKIPPED(0);
-
-// Whether the capture hardware is receiving a signal from its input.
-static std::atomic<bool> RECEIVING_A_SIGNAL(true);
-
-// Will be set to true by the capture hardware callback if the card experiences an
-// unrecoverable error.
-static bool UNRECOVERABLE_CAPTURE_ERROR = false;
+// What switching to a given video mode calls for, worked out ahead of time so
+// that a mode switch needn't search through the aliases and the known modes'
+// parameters. See mode_state().
+struct mode_state_s
+{
+    // The resolution to which the capture hardware is to be set on switching to
+    // the mode: the mode's alias, if it has one; otherwise, its own.
+    resolution_s aliasedRes;
+
+    // The index in KNOWN_MODES of the mode's parameters, or -1 if it has none,
+    // in which case the defaults apply.
+    int paramsIdx;
+};
+
+// The states of the video modes in the mode params and alias files, prepared
+// by kc_prepare_mode_states(), and of any other modes that have been switched
+// to since.
+static std::map<std::pair<unsigned long, unsigned long>, mode_state_s> MODE_STATES;
+
+// The capture hardware's default mode parameters, for modes without parameters
+// of their own. Polled by kc_prepare_mode_states(), rather than on each switch
+// to such a mode.
+static capture_color_settings_s DEFAULT_COLOR_SETTINGS = {0};
+static capture_video_settings_s DEFAULT_VIDEO_SETTINGS = {0};
+
+// When the capture hardware reported the most recent video mode, and whether a
+// frame in that mode has yet been output; and how long, in milliseconds, it took
+// from the report until the first frame was, or -1 if no mode switch has yet
+// completed. See kc_mode_switch_latency().
+static std::chrono::steady_clock::time_point MODE_SWITCH_TIMESTAMP;
+static bool IS_MODE_SWITCH_PENDING = false;
+static int MODE_SWITCH_LATENCY = -1;
+
+// Whether VCS chooses the pixel format in which frames are captured - see
+// kc_negotiate_capture_pixel_format() -, rather than the user.
+static bool NEGOTIATE_PIXEL_FORMAT = false;
+
+// The interval at which test patterns are generated unless a rate was given on
+// the command line; about 60 frames per second.
+static const std::chrono::microseconds DEFAULT_TEST_PATTERN_INTERVAL(16667);
+
+// An input channel on the capture hardware, and the state of capturing from it.
+// Several inputs can be captured from at once, each one a capture source of its
+// own. Of these, VCS displays the frames of the selected source; the others keep
+// capturing in the background, their frames being processed - and, if they're
+// being recorded, recorded - like the selected source's, but not displayed; and
+// switching to one of them doesn't require the capture hardware to reacquire its
+// signal.
+struct capture_source_s
+{
+    // The capture hardware input channel (0-indexed) that this source captures.
+    uint inputChannelIdx = 0;
+
+    HRGB handle = 0;
+
+    // Set to true while the capture hardware is capturing from this source.
+    bool isCapturing = false;
+
+    // Whether this is the selected source. Read by the capture hardware's
+    // callbacks.
+    std::atomic<bool> isSelected{false};
+
+    // Frames sent by the capture hardware will be queued here until VCS has had
+    // time to process them. If the capture hardware sends in a new frame while
+    // all of the ring's slots are still occupied, the new frame will be ignored.
+    frame_ring_s frameRing;
+
+    // Whether the capture hardware writes its frames directly into the frame
+    // ring's slots (zero-copy capture), or into its own buffers, from which we
+    // then copy them into the ring. In zero-copy capture, each free slot of the
+    // ring is lent to the capture hardware, in ring order, and is given back to
+    // us filled with a new frame.
+    bool zeroCopy = false;
+
+    // Set by the capture hardware's callbacks if, in zero-copy capture, the
+    // hardware gives back a slot's buffer other than the one expected next in
+    // ring order; and once VCS has reported this.
+    std::atomic<bool> receivedBufferOutOfOrder{false};
+    bool reportedBufferOutOfOrder = false;
 
-// Set to true if the capture signal is invalid.
-static std::atomic<bool> SIGNAL_IS_INVALID(false);
-
-// Will be set to true when the input signal is lost, and back to false once the
-// events processor has acknowledged the loss of signal.
-static bool SIGNAL_WAS_LOST = false;
-
-// Set to true if the capture hardware reports the current signal as invalid. Will be
-// automatically set back to false once the events processor has acknowledged the
-// invalidity of the signal.
-static bool SIGNAL_BECAME_INVALID = false;
-
-// Frames sent by the capture hardware will be stored here. Note that only one frame
-// will fit at a time - if the capture hardware sends in a new frame before the
-// previous one has been processed, the new frame will be ignored.
-static captured_frame_s FRAME_BUFFER;
+#if USE_RGBEASY_API
+    // Describes the frame ring's slot buffers to the capture hardware in
+    // zero-copy capture.
+    BITMAPINFO outputBufferInfo;
+#endif
 
-// Set to true if the capture hardware's input mode changes.
-static bool RECEIVED_NEW_VIDEO_MODE = false;
+    // The color depth/format in which the capture hardware captures the frames.
+    // Set by VCS's main thread (or by virtual capture, in place of the capture
+    // hardware) and read by the capture hardware's callbacks, so atomic. Only
+    // set once the hardware has accepted the format.
+    std::atomic<PIXELFORMAT> pixelFormat{RGB_PIXELFORMAT_888};
+
+    // The color depth in which the capture hardware is expected to be sending
+    // the frames. This depends on the current pixel format, such that e.g.
+    // formats 555 and 565 are probably sent as 16-bit, and 888 as 32-bit.
+    u32 outputColorDepth = 32;
+
+    // The size to which VCS has asked the capture hardware to scale this
+    // source's frames (see kc_set_hardware_output_size()), and the capture
+    // resolution at the time; or 0 x 0 if VCS hasn't asked, or if the size has
+    // since been reset along with the capture resolution.
+    resolution_s requestedOutputSize = {0, 0, 0};
+    resolution_s requestedOutputSizeCaptureRes = {0, 0, 0};
+
+    // The number of frames the capture hardware has sent which VCS was too busy
+    // to receive (i.e. which arrived while all slots in the frame ring were
+    // occupied) and had to skip. Call kc_reset_missed_frames_count() to reset it.
+    std::atomic<unsigned int> cntFramesSkipped{0};
+
+    // The sequence number to be given to the next frame that the capture
+    // hardware sends in from this source, and the number of frames it has sent
+    // in and which had to be skipped since the last one that was queued. Only
+    // accessed by the capture hardware's callbacks (or virtual capture in their
+    // place).
+    u32 nextSequenceNumber = 0;
+    u32 numSkippedSinceQueued = 0;
+
+    // Set to true upon first receiving a signal after 'no signal'.
+    bool signalWokeUp = false;
+
+    // Whether the capture hardware is receiving a signal from its input.
+    std::atomic<bool> receivingASignal{true};
+
+    // Will be set to true by the capture hardware callback if the card
+    // experiences an unrecoverable error.
+    bool unrecoverableError = false;
+
+    // Set to true if the capture signal is invalid.
+    std::atomic<bool> signalIsInvalid{false};
+
+    // Will be set to true when the input signal is lost, and back to false once
+    // the events processor has acknowledged the loss of signal.
+    bool signalWasLost = false;
+
+    // Set to true if the capture hardware reports the current signal as invalid.
+    // Will be automatically set back to false once the events processor has
+    // acknowledged the invalidity of the signal.
+    bool signalBecameInvalid = false;
+
+    // Set to true if the capture hardware's input mode changes; and when it
+    // last did.
+    bool receivedNewVideoMode = false;
+    std::chrono::steady_clock::time_point newVideoModeTimestamp;
+
+    // The capture hardware's status, as reported to the rest of VCS by
+    // CAPTURE_HARDWARE.status. Polling the hardware is comparatively costly,
+    // and the status only changes on capture events (a new video mode, or a
+    // lost or invalid signal) or when VCS itself alters the capture settings;
+    // so we poll it only at those times, via refresh_status_snapshot(), and
+    // otherwise serve status queries from this snapshot.
+    capture_status_snapshot_s statusSnapshot;
+
+    // How many capture hardware API calls it took to poll each of the snapshot's
+    // values, as counted by the poll_*() functions. Serving a status query from
+    // the snapshot saves that many calls.
+    struct
+    {
+        uint captureResolution;
+        uint signal;
+        uint colorSettings;
+        uint videoSettings;
+    } statusPollCost = {0, 0, 0, 0};
+
+    // When there's no capture hardware, this thread feeds frames into the frame
+    // ring in its place; either replaying a capture dump or generating test
+    // patterns.
+    std::thread virtualCaptureThread;
+    std::atomic<bool> stopVirtualCapture{false};
+
+    // Signaled when a slot of the frame ring is freed, or virtual capture is
+    // asked to stop; for virtual capture to wait on when the ring is full.
+    std::mutex frameRingSpaceMutex;
+    std::condition_variable frameRingSpaceFreed;
+
+    // Set to true if the virtual capture thread is replaying a capture dump.
+    bool isReplaying = false;
+
+    // The resolution of the frames being fed in by virtual capture. Stands in
+    // for the capture hardware's input resolution.
+    resolution_s virtualCaptureResolution = {0, 0, 0};
+
+    // Stands in for the capture hardware's own frame buffer when a test pattern
+    // is inserted without zero-copy capture.
+    heap_bytes_s<u8> testImageBuffer;
+
+    // For making the test pattern move with successive frames.
+    uint testPatternFrameNumber = 0;
+};
+
+// The capture sources that have been opened, one for each of the input channels
+// given on the command line.
+static capture_source_s CAPTURE_SOURCES[MAX_INPUT_CHANNELS];
+static uint NUM_CAPTURE_SOURCES = 0;
+
+// The source whose frames VCS displays, as selected by the user.
+static capture_source_s *SELECTED_SOURCE = &CAPTURE_SOURCES[0];
+
+// The source whose frames and events VCS is processing. Functions acting on
+// "the" capture hardware act on this source; as do the other units' functions
+// that keep state for each source, which they find by kc_active_source_idx().
+// This is the selected source, except while a background source is being
+// processed - see kc_activate_source().
+static capture_source_s *ACTIVE_SOURCE = &CAPTURE_SOURCES[0];
+
+static void refresh_status_snapshot(void);
+
+// The number of capture hardware API calls that status queries have avoided by
+// being served from the status snapshot. Call kc_reset_saved_status_queries_count()
+// to reset it.
+static std::atomic<unsigned int> CNT_STATUS_QUERIES_SAVED(0);
 
 // The maximum image depth that the capturer can handle.
 static const u32 MAX_BIT_DEPTH = 32;
@@ -80,15 +256,8 @@ static const u32 MAX_BIT_DEPTH = 32;
 // Set to 1 if we've acquired access to the RGBEASY API.
 static bool RGBEASY_IS_LOADED = 0;
 
-static HRGB CAPTURE_HANDLE = 0;
 static HRGBDLL RGBAPI_HANDLE = 0;
 
-// Set to 1 if we're currently capturing.
-static bool CAPTURE_IS_ACTIVE = false;
-
-// Set to 1 if the input channel we were requested to use was invalid.
-static bool INPUT_CHANNEL_IS_INVALID = 0;
-
 // Aliases are resolutions that stand in for others; i.e. if 640 x 480 is an alias
 // for 1024 x 768, VCS will ask the capture hardware to switch to 640 x 480 every time
 // the card sets 1024 x 768.
@@ -111,6 +280,155 @@ static struct capture_interface_s
     bool set_capture_resolution(const resolution_s &r);
 } CAPTURE_INTERFACE;
 
+// Lends the given frame ring slot buffer to the given source's capture hardware,
+// for it to write a future frame into. For zero-copy capture.
+//
+static bool chain_output_buffer(capture_source_s *const source, const heap_bytes_s<u8> &buffer)
+{
+#if USE_RGBEASY_API
+    return (RGBChainOutputBuffer(source->handle, &source->outputBufferInfo, buffer.ptr()) == RGBERROR_NO_ERROR);
+#else
+    return (RGBChainOutputBuffer(source->handle, nullptr, buffer.ptr()) == RGBERROR_NO_ERROR);
+#endif
+}
+
+// Accounts for a frame that the capture hardware sent in from the source but
+// which couldn't be queued for processing.
+//
+static void skip_frame(capture_source_s *const source)
+{
+    source->cntFramesSkipped++;
+    source->numSkippedSinceQueued++;
+    source->nextSequenceNumber++;
+
+    return;
+}
+
+// Stamps the given frame, which is being queued from the source, with its
+// capture metadata. Called as the frame arrives from the capture hardware, so
+// that the timestamp reflects when it was captured rather than when it ends up
+// getting processed. The pixel format is the one in which the frame's producer
+// says it made the frame, since the source's format may have been switched
+// while the frame was in flight.
+//
+static void stamp_frame(capture_source_s *const source,
+                        captured_frame_s *const frame,
+                        const PIXELFORMAT pixelFormat)
+{
+    frame->pixelFormat = pixelFormat;
+    frame->meta.timestamp = std::chrono::steady_clock::now();
+    frame->meta.sequenceNumber = source->nextSequenceNumber++;
+    frame->meta.numSkippedBefore = source->numSkippedSinceQueued;
+
+    source->numSkippedSinceQueued = 0;
+
+    return;
+}
+
+// Copies the given frame, which the capture hardware has written into its own
+// buffer, into the next free slot of the source's frame ring.
+//
+static void push_frame_by_copying(capture_source_s *const source,
+                                  const u8 *const frameData,
+                                  const resolution_s &r,
+                                  const PIXELFORMAT pixelFormat)
+{
+    captured_frame_s *const frame = source->frameRing.begin_write();
+    if (frame == nullptr)
+    {
+        // All of the ring's slots are waiting to be processed, so there's
+        // nowhere to put this frame.
+        skip_frame(source);
+        return;
+    }
+
+    if ((r.w * r.h * (r.bpp / 8)) > frame->pixels.size())
+    {
+        source->frameRing.cancel_write();
+        skip_frame(source);
+        return;
+    }
+
+    frame->r = r;
+    stamp_frame(source, frame, pixelFormat);
+    memcpy(frame->pixels.ptr(), frameData, (r.w * r.h * (r.bpp / 8)));
+
+    source->frameRing.end_write();
+    kd_wake_event_loop();
+
+    return;
+}
+
+// Returns the frame of the slot in the source's frame ring whose buffer is the
+// given one, or nullptr if it's none of theirs. For zero-copy capture.
+//
+static const captured_frame_s* frame_ring_slot_frame(capture_source_s *const source, const u8 *const buffer)
+{
+    for (uint i = 0; i < source->frameRing.num_slots(); i++)
+    {
+        const captured_frame_s &frame = source->frameRing.frame_in_slot(i);
+
+        if (frame.pixels.ptr() == buffer)
+        {
+            return &frame;
+        }
+    }
+
+    return nullptr;
+}
+
+// Publishes the slot of the source's frame ring into which the capture hardware
+// has written the given frame. For zero-copy capture.
+//
+// Since the ring's slots are lent to the capture hardware in ring order, and the
+// hardware fills them in the order it received them, the filled buffer is
+// expected to be that of the ring's next free slot. A frame that arrives in any
+// other slot's buffer can't be published in ring order, and is skipped.
+//
+static void push_frame_in_place(capture_source_s *const source,
+                                const u8 *const frameData,
+                                const resolution_s &r,
+                                const PIXELFORMAT pixelFormat)
+{
+    captured_frame_s *const frame = source->frameRing.begin_write();
+
+    if ((frame == nullptr) ||
+        (frame->pixels.ptr() != frameData) ||
+        ((r.w * r.h * (r.bpp / 8)) > frame->pixels.size()))
+    {
+        if (frame != nullptr)
+        {
+            source->frameRing.cancel_write();
+        }
+
+        // We can't use the frame, but the buffer it came in is one of ours, so
+        // lend it back to the capture hardware to keep it in circulation.
+        const captured_frame_s *const bufferOwner = frame_ring_slot_frame(source, frameData);
+
+        if (bufferOwner != nullptr)
+        {
+            if ((frame != nullptr) &&
+                (bufferOwner != frame))
+            {
+                source->receivedBufferOutOfOrder = true;
+            }
+
+            chain_output_buffer(source, bufferOwner->pixels);
+        }
+
+        skip_frame(source);
+        return;
+    }
+
+    frame->r = r;
+    stamp_frame(source, frame, pixelFormat);
+
+    source->frameRing.end_write();
+    kd_wake_event_loop();
+
+    return;
+}
+
 // Callback functions for the RGBEasy API, through which the API communicates
 // with VCS.
 namespace api_callbacks_n
@@ -118,8 +436,6 @@ namespace api_callbacks_n
 #if !USE_RGBEASY_API
     void frame_captured(void)
     {
-        (void)SIGNAL_WOKE_UP;
-        (void)CAPTURE_HANDLE;
         (void)RGBAPI_HANDLE;
     }
     void video_mode_changed(void){}
@@ -127,20 +443,50 @@ namespace api_callbacks_n
     void no_signal(void){}
     void error(void){}
 #else
-    // Called by the capture hardware when a new frame has been captured. The
-    // captured RGBA data is in frameData.
-    void RGBCBKAPI frame_captured(HWND, HRGB, LPBITMAPINFOHEADER frameInfo, void *frameData, ULONG_PTR)
+    // Returns the pixel format in which the capture hardware says, by the given
+    // frame header, that it captured the frame; or the given fallback if the
+    // header doesn't tell the formats apart (e.g. 16-bit BI_RGB).
+    static PIXELFORMAT reported_pixel_format(const BITMAPINFOHEADER *const frameInfo,
+                                             const PIXELFORMAT fallback)
     {
-        if (CNT_FRAMES_CAPTURED != CNT_FRAMES_PROCESSED)
+        static const DWORD yuy2FourCC = ('Y' | ('U' << 8) | ('Y' << 16) | ((DWORD)'2' << 24));
+
+        if (frameInfo->biCompression == yuy2FourCC)
         {
-            //ERRORI(("The capture hardware sent in a frame before VCS had finished processing "
-            //        "the previous one. Skipping this new one. (Captured: %u, processed: %u.)",
-            //        CNT_FRAMES_CAPTURED.load(), CNT_FRAMES_PROCESSED.load()));
-            CNT_FRAMES_SKIPPED++;
-            return;
+            return RGB_PIXELFORMAT_YUY2;
+        }
+        else if (frameInfo->biBitCount >= 24)
+        {
+            return RGB_PIXELFORMAT_888;
         }
+        else if ((frameInfo->biBitCount == 16) &&
+                 (frameInfo->biCompression == BI_BITFIELDS))
+        {
+            // The red, green, and blue masks follow the header.
+            const DWORD greenMask = ((const DWORD*)(frameInfo + 1))[1];
 
-        std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+            if (greenMask == 0x07e0) return RGB_PIXELFORMAT_565;
+            if (greenMask == 0x03e0) return RGB_PIXELFORMAT_555;
+        }
+
+        return fallback;
+    }
+
+    // Called by the capture hardware when a new frame has been captured. The
+    // captured RGBA data is in frameData; which, in zero-copy capture, is the
+    // buffer of one of the frame ring's slots.
+    //
+    // Each of the callbacks is registered with the capture source it's called
+    // for as its user data.
+    //
+    // Note that this callback doesn't lock INPUT_OUTPUT_MUTEX: the frame ring is
+    // safe for the callback to write into while VCS is processing an earlier
+    // frame, and locking would stall the capture hardware for the duration of
+    // that processing.
+    void RGBCBKAPI frame_captured(HWND, HRGB, LPBITMAPINFOHEADER frameInfo, void *frameData, ULONG_PTR userData)
+    {
+        capture_source_s *const source = (capture_source_s*)userData;
+        resolution_s r;
 
         // Ignore new callback events if the user has signaled to quit the program.
         if (PROGRAM_EXIT_REQUESTED)
@@ -148,20 +494,14 @@ namespace api_callbacks_n
             goto done;
         }
 
-        // This could happen e.g. if direct DMA transfer is enabled.
+        // This could happen e.g. if direct DMA transfer is enabled, or if in
+        // zero-copy capture the capture hardware ran out of buffers to use.
         if (frameData == nullptr ||
                 frameInfo == nullptr)
         {
             goto done;
         }
 
-        if (FRAME_BUFFER.pixels.is_null())
-        {
-            //ERRORI(("The capture hardware sent in a frame but the frame buffer was uninitialized. "
-            //        "Ignoring the frame."));
-            goto done;
-        }
-
         if (frameInfo->biBitCount > MAX_BIT_DEPTH)
         {
             //ERRORI(("The capture hardware sent in a frame that had an illegal bit depth (%u). "
@@ -169,23 +509,32 @@ namespace api_callbacks_n
             goto done;
         }
 
-        FRAME_BUFFER.r.w = frameInfo->biWidth;
-        FRAME_BUFFER.r.h = abs(frameInfo->biHeight);
-        FRAME_BUFFER.r.bpp = frameInfo->biBitCount;
+        r.w = frameInfo->biWidth;
+        r.h = abs(frameInfo->biHeight);
+        r.bpp = frameInfo->biBitCount;
 
-        // Copy the frame's data into our local buffer so we can work on it.
-        memcpy(FRAME_BUFFER.pixels.ptr(), (u8*)frameData,
-               FRAME_BUFFER.pixels.up_to(FRAME_BUFFER.r.w * FRAME_BUFFER.r.h * (FRAME_BUFFER.r.bpp / 8)));
+        {
+            const PIXELFORMAT pixelFormat = reported_pixel_format(frameInfo, source->pixelFormat);
+
+            if (source->zeroCopy)
+            {
+                push_frame_in_place(source, (u8*)frameData, r, pixelFormat);
+            }
+            else
+            {
+                push_frame_by_copying(source, (u8*)frameData, r, pixelFormat);
+            }
+        }
 
     done:
-        CNT_FRAMES_CAPTURED++;
         return;
     }
 
     // Called by the capture hardware when the input video mode changes.
-    void RGBCBKAPI video_mode_changed(HWND, HRGB, PRGBMODECHANGEDINFO, ULONG_PTR)
+    void RGBCBKAPI video_mode_changed(HWND, HRGB, PRGBMODECHANGEDINFO, ULONG_PTR userData)
     {
         std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+        capture_source_s *const source = (capture_source_s*)userData;
 
         // Ignore new callback events if the user has signaled to quit the program.
         if (PROGRAM_EXIT_REQUESTED)
@@ -193,18 +542,22 @@ namespace api_callbacks_n
             goto done;
         }
 
-        SIGNAL_WOKE_UP = !RECEIVING_A_SIGNAL;
-        RECEIVED_NEW_VIDEO_MODE = true;
-        SIGNAL_IS_INVALID = false;
+        source->signalWokeUp = !source->receivingASignal;
+        source->receivedNewVideoMode = true;
+        source->newVideoModeTimestamp = std::chrono::steady_clock::now();
+        source->signalIsInvalid = false;
+
+        kd_wake_event_loop();
 
     done:
         return;
     }
 
     // Called by the capture hardware when it's given a signal it can't handle.
-    void RGBCBKAPI invalid_signal(HWND, HRGB, unsigned long horClock, unsigned long verClock, ULONG_PTR captureHandle)
+    void RGBCBKAPI invalid_signal(HWND, HRGB captureHandle, unsigned long horClock, unsigned long verClock, ULONG_PTR userData)
     {
         std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+        capture_source_s *const source = (capture_source_s*)userData;
 
         // Ignore new callback events if the user has signaled to quit the program.
         if (PROGRAM_EXIT_REQUESTED)
@@ -215,30 +568,38 @@ namespace api_callbacks_n
         // Let the card apply its own no signal handler as well, just in case.
         RGBInvalidSignal(captureHandle, horClock, verClock);
 
-        SIGNAL_IS_INVALID = true;
+        source->signalIsInvalid = true;
+
+        kd_wake_event_loop();
 
     done:
         return;
     }
 
     // Called by the capture hardware when no input signal is present.
-    void RGBCBKAPI no_signal(HWND, HRGB, ULONG_PTR captureHandle)
+    void RGBCBKAPI no_signal(HWND, HRGB captureHandle, ULONG_PTR userData)
     {
         std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+        capture_source_s *const source = (capture_source_s*)userData;
 
         // Let the card apply its own no signal handler as well, just in case.
         RGBNoSignal(captureHandle);
 
-        SIGNAL_WAS_LOST = true;
+        source->signalWasLost = true;
+
+        kd_wake_event_loop();
 
         return;
     }
 
-    void RGBCBKAPI error(HWND, HRGB, unsigned long, ULONG_PTR, unsigned long*)
+    void RGBCBKAPI error(HWND, HRGB, unsigned long, ULONG_PTR userData, unsigned long*)
     {
         std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+        capture_source_s *const source = (capture_source_s*)userData;
+
+        source->unrecoverableError = true;
 
-        UNRECOVERABLE_CAPTURE_ERROR = true;
+        kd_wake_event_loop();
 
         return;
     }
@@ -257,6 +618,15 @@ bool apicall_succeeds(long callReturnValue)
     return true;
 }
 
+// Like apicall_succeeds(), but also increments the given count of API calls made.
+//
+static bool counted_apicall_succeeds(const long callReturnValue, uint *const numApiCalls)
+{
+    (*numApiCalls)++;
+
+    return apicall_succeeds(callReturnValue);
+}
+
 const capture_hardware_s& kc_hardware(void)
 {
     return CAPTURE_HARDWARE;
@@ -281,6 +651,8 @@ void update_known_video_mode_params(const resolution_s r,
                            CAPTURE_HARDWARE.meta.default_color_settings(),
                            CAPTURE_HARDWARE.meta.default_video_settings()});
 
+    kc_prepare_mode_states();
+
     mode_exists:
     // Update the existing mode with the new parameters.
     if (c != nullptr) KNOWN_MODES[idx].color = *c;
@@ -294,66 +666,500 @@ void update_known_video_mode_params(const resolution_s r,
 //
 bool kc_are_frames_being_dropped(void)
 {
-    return bool(CNT_FRAMES_SKIPPED > 0);
+    return bool(ACTIVE_SOURCE->cntFramesSkipped > 0);
 }
 
 uint kc_num_missed_frames(void)
 {
-    return CNT_FRAMES_SKIPPED;
+    return ACTIVE_SOURCE->cntFramesSkipped;
 }
 
 void kc_reset_missed_frames_count(void)
 {
-    CNT_FRAMES_SKIPPED = 0;
+    ACTIVE_SOURCE->cntFramesSkipped = 0;
+
+    return;
+}
+
+// Allocates memory for the source's frame ring, such that each of its slots can
+// hold a frame of the capture hardware's maximum resolution.
+//
+static void allocate_frame_ring(capture_source_s *const source)
+{
+    const resolution_s maxres = CAPTURE_HARDWARE.meta.maximum_capture_resolution();
+    const uint numSlots = kcom_num_capture_buffers();
+
+    INFO(("Allocating %u capture buffer(s) for %u x %u max.", numSlots, maxres.w, maxres.h));
+
+    source->frameRing.allocate(numSlots, (maxres.w * maxres.h * (MAX_BIT_DEPTH / 8)));
+
+    return;
+}
+
+// Asks the capture hardware to write the source's frames directly into its frame
+// ring's slots, and lends it all of the slots. Falls back to copying the frames
+// if the capture hardware refuses.
+//
+static void enable_zero_copy_capture(capture_source_s *const source)
+{
+#if USE_RGBEASY_API
+    // Describe the buffers as being able to hold a frame of the maximum capture
+    // size. The capture hardware tells us the actual size of each frame as it
+    // hands a buffer back.
+    {
+        const resolution_s maxres = CAPTURE_HARDWARE.meta.maximum_capture_resolution();
+
+        memset(&source->outputBufferInfo, 0, sizeof(source->outputBufferInfo));
+        source->outputBufferInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        source->outputBufferInfo.bmiHeader.biWidth = maxres.w;
+        source->outputBufferInfo.bmiHeader.biHeight = -long(maxres.h); // Top-down.
+        source->outputBufferInfo.bmiHeader.biPlanes = 1;
+        source->outputBufferInfo.bmiHeader.biBitCount = MAX_BIT_DEPTH;
+        source->outputBufferInfo.bmiHeader.biCompression = BI_RGB;
+        source->outputBufferInfo.bmiHeader.biSizeImage = (maxres.w * maxres.h * (MAX_BIT_DEPTH / 8));
+    }
+#endif
+
+    if (!apicall_succeeds(RGBUseOutputBuffers(source->handle, TRUE)))
+    {
+        NBENE(("The capture hardware doesn't support capturing into VCS's buffers. "
+               "Falling back to copying the frames."));
+        goto fail;
+    }
+
+    // The ring is empty at this point, so its slots are lent out in ring order.
+    for (uint i = 0; i < source->frameRing.num_slots(); i++)
+    {
+        if (!chain_output_buffer(source, source->frameRing.frame_in_slot(i).pixels))
+        {
+            NBENE(("Failed to hand capture buffer #%u to the capture hardware. "
+                   "Falling back to copying the frames.", (i + 1)));
+
+            RGBUseOutputBuffers(source->handle, FALSE);
+            goto fail;
+        }
+    }
 
+    INFO(("Capturing directly into VCS's capture buffers."));
+    source->zeroCopy = true;
+    return;
+
+    fail:
+    source->zeroCopy = false;
     return;
 }
 
-// Creates a test pattern into the frame buffer.
+// Allocates the stand-in for the capture hardware's own buffer into which the
+// source's test pattern is drawn, unless the pattern is drawn directly into VCS's
+// capture buffers or the stand-in has been allocated already. Sources that only
+// ever capture from the hardware thus don't reserve memory for it.
 //
+// Not thread-safe; to be called before the source's frames are generated.
+//
+static void allocate_test_image_buffer(capture_source_s *const source)
+{
+    const test_pattern_s &pattern = kcom_test_pattern();
+
+#if !USE_RGBEASY_API
+    if (source->zeroCopy)
+    {
+        return;
+    }
+#endif
+
+    if (!source->testImageBuffer.is_null())
+    {
+        return;
+    }
+
+    source->testImageBuffer.alloc((pattern.r.w * pattern.r.h * (pattern.r.bpp / 8)), "Capture test pattern");
+
+    return;
+}
+
+// Creates the next frame of the test pattern given on the command line, as if
+// the capture hardware had sent it in from the given source. In zero-copy
+// capture, the pattern is drawn into the buffer that the (mock) capture hardware
+// hands back; otherwise, it's drawn into a stand-in for the hardware's own
+// buffer, and copied into the frame ring from there.
+//
+static void insert_test_image(capture_source_s *const source)
+{
+    const test_pattern_s &pattern = kcom_test_pattern();
+    u8 *pixels = nullptr;
+
+#if !USE_RGBEASY_API
+    if (source->zeroCopy)
+    {
+        pixels = (u8*)NULL_RGBEASY_next_output_buffer(source->handle);
+        if (pixels == nullptr)
+        {
+            skip_frame(source);
+            return;
+        }
+    }
+    else
+#endif
+    {
+        pixels = source->testImageBuffer.ptr();
+    }
+
+    ktp_draw_test_pattern(pixels, pattern, source->testPatternFrameNumber++);
+
+    // The pattern is drawn at the capture resolution, so scale it to the
+    // output size, as the capture hardware would.
+    resolution_s r = pattern.r;
+#if !USE_RGBEASY_API
+    NULL_RGBEASY_scale_to_output_size(source->handle, pixels, &r, pattern.pixelFormat);
+#endif
+
+    if (source->zeroCopy)
+    {
+        push_frame_in_place(source, pixels, r, pattern.pixelFormat);
+    }
+    else
+    {
+        push_frame_by_copying(source, pixels, r, pattern.pixelFormat);
+    }
+
+    return;
+}
+
 void kc_insert_test_image(void)
 {
-    // For making the test pattern move with successive calls.
-    static uint offset = 0;
-    offset++;
+    allocate_test_image_buffer(SELECTED_SOURCE);
+    insert_test_image(SELECTED_SOURCE);
 
-    for (uint y = 0; y < FRAME_BUFFER.r.h; y++)
+    return;
+}
+
+#if !USE_RGBEASY_API
+// Blocks until the source's frame ring has a free slot, or until virtual capture
+// is asked to stop.
+//
+static void wait_for_frame_ring_space(capture_source_s *const source)
+{
+    std::unique_lock<std::mutex> lock(source->frameRingSpaceMutex);
+
+    source->frameRingSpaceFreed.wait(lock, [source]
+    {
+        return (!source->frameRing.is_full() || source->stopVirtualCapture);
+    });
+
+    return;
+}
+
+// Feeds test patterns into the source's frame ring at regular intervals, as the
+// capture hardware would feed in captured frames, until asked to stop. Meant to
+// be run in its own thread.
+//
+// Frames are fed in at the rate given by kcom_virtual_capture_rate(); if that's
+// 0, each frame is held back until there's room for it in the frame ring, so
+// that none get skipped.
+//
+static void generate_test_images(capture_source_s *const source)
+{
+    const int rate = kcom_virtual_capture_rate();
+    const std::chrono::nanoseconds interval = ((rate > 0)? std::chrono::nanoseconds(1000000000 / rate)
+                                                         : std::chrono::nanoseconds(DEFAULT_TEST_PATTERN_INTERVAL));
+
+    auto nextFrameTime = std::chrono::steady_clock::now();
+
+    while (!source->stopVirtualCapture)
+    {
+        if (rate == 0)
+        {
+            wait_for_frame_ring_space(source);
+        }
+        else
+        {
+            nextFrameTime += interval;
+            std::this_thread::sleep_until(nextFrameTime);
+        }
+
+        insert_test_image(source);
+    }
+
+    return;
+}
+
+// Feeds the frames of the open capture dump into the source's frame ring, as the
+// capture hardware would feed in captured frames, until asked to stop. Loops
+// over the dump. Meant to be run in its own thread.
+//
+// Frames are fed in at the rate given by kcom_virtual_capture_rate(); if that's
+// 0, each frame is held back until there's room for it in the frame ring, so
+// that none get skipped.
+//
+static void replay_capture_dump(capture_source_s *const source)
+{
+    const int replayRate = kcom_virtual_capture_rate();
+    const uint numFrames = kdump_num_frames();
+
+    // For looping at the original timing, the interval between the last frame
+    // and the first one of the next loop. We use the dump's average interval.
+    const u64 loopIntervalNs = ((numFrames > 1)? (kdump_frame(numFrames - 1).timestampNs / (numFrames - 1))
+                                               : (1000000000 / 60));
+
+    const auto startTime = std::chrono::steady_clock::now();
+    u64 loopStartNs = 0;
+    u64 numFramesReplayed = 0;
+    uint frameIdx = 0;
+
+    while (!source->stopVirtualCapture)
     {
-        for (uint x = 0; x < FRAME_BUFFER.r.w; x++)
+        const dump_frame_s frame = kdump_frame(frameIdx);
+
+        // Wait until it's time to feed in this frame.
+        if (replayRate < 0)
+        {
+            std::this_thread::sleep_until(startTime + std::chrono::nanoseconds(loopStartNs + frame.timestampNs));
+        }
+        else if (replayRate > 0)
+        {
+            std::this_thread::sleep_until(startTime + std::chrono::nanoseconds((numFramesReplayed * 1000000000) / replayRate));
+        }
+        else
+        {
+            wait_for_frame_ring_space(source);
+        }
+
+        // Announce a change in the video mode as the capture hardware would.
+        if ((frame.r.w != source->virtualCaptureResolution.w) ||
+            (frame.r.h != source->virtualCaptureResolution.h) ||
+            (frame.r.bpp != source->outputColorDepth) ||
+            (frame.pixelFormat != source->pixelFormat))
         {
-            const uint idx = ((x + y * FRAME_BUFFER.r.w) * 4);
-            FRAME_BUFFER.pixels[idx + 0] = (offset+x)%256;
-            FRAME_BUFFER.pixels[idx + 1] = (offset+y)%256;
-            FRAME_BUFFER.pixels[idx + 2] = 150;
-            FRAME_BUFFER.pixels[idx + 3] = 255;
+            std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+
+            source->virtualCaptureResolution = frame.r;
+            source->pixelFormat = frame.pixelFormat;
+            source->outputColorDepth = frame.r.bpp;
+            source->receivedNewVideoMode = true;
+            source->newVideoModeTimestamp = std::chrono::steady_clock::now();
+
+            kd_wake_event_loop();
+        }
+
+        // The dump file's memory mapping stands in for the capture hardware's
+        // own buffer.
+        if (source->zeroCopy)
+        {
+            u8 *const buffer = (u8*)NULL_RGBEASY_next_output_buffer(source->handle);
+
+            if (buffer == nullptr)
+            {
+                skip_frame(source);
+            }
+            else
+            {
+                memcpy(buffer, frame.pixels, (frame.r.w * frame.r.h * (frame.r.bpp / 8)));
+                push_frame_in_place(source, buffer, frame.r, frame.pixelFormat);
+            }
+        }
+        else
+        {
+            push_frame_by_copying(source, frame.pixels, frame.r, frame.pixelFormat);
+        }
+
+        numFramesReplayed++;
+
+        if (++frameIdx >= numFrames)
+        {
+            loopStartNs += (frame.timestampNs + loopIntervalNs);
+            frameIdx = 0;
         }
     }
 
     return;
 }
+#endif
 
+// Starts feeding frames into the source's frame ring in place of the capture
+// hardware: from the capture dump file given on the command line, if any, or
+// otherwise the test pattern given on the command line. Only the first source
+// replays the capture dump; any others generate the test pattern.
+//
+static bool start_virtual_capture(capture_source_s *const source)
+{
+#if USE_RGBEASY_API
+    (void)source;
+
+    NBENE(("Virtual capture is only available when VCS is built without the RGBEASY API."));
+    return false;
+#else
+    const std::string &replayFilename = kcom_capture_replay_file_name();
+
+    source->stopVirtualCapture = false;
+
+    if (!replayFilename.empty() &&
+        (source == &CAPTURE_SOURCES[0]))
+    {
+        if (!kdump_open_dump(replayFilename))
+        {
+            return false;
+        }
+
+        INFO(("Replaying capture dump \"%s\" in place of the capture hardware.", replayFilename.c_str()));
+
+        source->isReplaying = true;
+        source->virtualCaptureThread = std::thread(replay_capture_dump, source);
+    }
+    else
+    {
+        const test_pattern_s &pattern = kcom_test_pattern();
+
+        // The test pattern's format stands in for the capture hardware's.
+        source->virtualCaptureResolution = pattern.r;
+        source->pixelFormat = pattern.pixelFormat;
+        source->outputColorDepth = pattern.r.bpp;
+
+        allocate_test_image_buffer(source);
+
+        INFO(("Generating a %u x %u x %u test pattern in place of input channel %u.",
+              pattern.r.w, pattern.r.h, pattern.r.bpp, (source->inputChannelIdx + 1)));
+
+        source->virtualCaptureThread = std::thread(generate_test_images, source);
+    }
+
+    return true;
+#endif
+}
+
+static void stop_virtual_capture(capture_source_s *const source)
+{
+    if (source->virtualCaptureThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(source->frameRingSpaceMutex);
+            source->stopVirtualCapture = true;
+        }
+
+        source->frameRingSpaceFreed.notify_all();
+        source->virtualCaptureThread.join();
+    }
+
+    if (source->isReplaying)
+    {
+        kdump_close_dump();
+        source->isReplaying = false;
+    }
+
+    return;
+}
+
+bool kc_is_replaying_capture_dump(void)
+{
+    return ACTIVE_SOURCE->isReplaying;
+}
+
+// Returns the oldest captured frame that's waiting to be processed. The frame
+// remains reserved for processing - and will be returned by successive calls -
+// until it's released with kc_mark_current_frame_as_processed().
+//
 const captured_frame_s& kc_latest_captured_frame(void)
 {
-    return FRAME_BUFFER;
+    const captured_frame_s *const frame = ACTIVE_SOURCE->frameRing.begin_read();
+
+    k_assert((frame != nullptr),
+             "Was asked for the latest captured frame while none was waiting to be processed.");
+
+    return *frame;
+}
+
+// Returns the number of captured frames that're waiting to be processed.
+//
+uint kc_num_queued_frames(void)
+{
+    return ACTIVE_SOURCE->frameRing.num_occupied();
 }
 
 void kc_initialize_capture(void)
 {
     INFO(("Initializing capture."));
 
-    FRAME_BUFFER.pixels.alloc(MAX_FRAME_SIZE);
+    if (!kcom_capture_dump_file_name().empty())
+    {
+        kdump_start_dumping(kcom_capture_dump_file_name());
+    }
+
+    kdedup_initialize();
 
-    #ifndef USE_RGBEASY_API
-        FRAME_BUFFER.r = {640, 480, 32};
+    // Set up a capture source for each of the input channels we were asked to
+    // capture from, the first of which is initially selected.
+    {
+        const std::vector<uint> &inputChannels = kcom_input_channels();
+
+        k_assert((!inputChannels.empty() && (inputChannels.size() <= MAX_INPUT_CHANNELS)),
+                 "Was asked to capture from an invalid number of input channels.");
+
+        NUM_CAPTURE_SOURCES = inputChannels.size();
+
+        for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+        {
+            capture_source_s *const source = &CAPTURE_SOURCES[i];
+
+            source->inputChannelIdx = inputChannels[i];
+            source->isSelected = (i == 0);
+        }
+
+        SELECTED_SOURCE = &CAPTURE_SOURCES[0];
+        ACTIVE_SOURCE = SELECTED_SOURCE;
+    }
 
+    #ifndef USE_RGBEASY_API
         INFO(("The RGBEASY API is disabled by code. Skipping capture initialization."));
+
+        for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+        {
+            capture_source_s *const source = &CAPTURE_SOURCES[i];
+
+            // Give each source a handle of its own, so that the null RGBEASY
+            // API can tell their output buffers apart.
+            source->handle = (HRGB)source;
+
+            allocate_frame_ring(source);
+
+            if (kcom_zero_copy_capture())
+            {
+                enable_zero_copy_capture(source);
+            }
+
+            if (!start_virtual_capture(source))
+            {
+                NBENE(("Failed to start virtual capture."));
+
+                PROGRAM_EXIT_REQUESTED = 1;
+                goto done;
+            }
+        }
+
         goto done;
     #endif
 
     // Open an input on the capture hardware, and have it start sending in frames.
     {
-        if (!CAPTURE_INTERFACE.initialize_hardware() ||
-            !CAPTURE_INTERFACE.start_capture())
+        if (!CAPTURE_INTERFACE.initialize_hardware())
+        {
+            NBENE(("Failed to initialize capture."));
+
+            PROGRAM_EXIT_REQUESTED = 1;
+            goto done;
+        }
+
+        // The frame rings' slots are sized by the hardware's maximum capture
+        // resolution, which we can only query once the hardware's been opened.
+        for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+        {
+            allocate_frame_ring(&CAPTURE_SOURCES[i]);
+
+            if (kcom_zero_copy_capture())
+            {
+                enable_zero_copy_capture(&CAPTURE_SOURCES[i]);
+            }
+        }
+
+        if (!CAPTURE_INTERFACE.start_capture())
         {
             NBENE(("Failed to initialize capture."));
 
@@ -363,6 +1169,15 @@ void kc_initialize_capture(void)
     }
 
     done:
+    // The background sources' status is needed for processing their frames, too.
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+    {
+        kc_activate_source(i);
+        refresh_status_snapshot();
+    }
+    kc_activate_source(kc_selected_source_idx());
+
+    kc_prepare_mode_states();
     kpropagate_news_of_new_capture_video_mode();
     return;
 }
@@ -371,13 +1186,77 @@ void kc_set_mode_params(const std::vector<video_mode_params_s> &modeParams)
 {
     KNOWN_MODES = modeParams;
 
+    kc_prepare_mode_states();
+
+    return;
+}
+
+// Works out the given video mode's state; see mode_state_s.
+//
+static mode_state_s new_mode_state(const resolution_s &r)
+{
+    mode_state_s state = {ka_aliased(r), -1};
+
+    for (uint i = 0; i < KNOWN_MODES.size(); i++)
+    {
+        if ((KNOWN_MODES[i].r.w == r.w) &&
+            (KNOWN_MODES[i].r.h == r.h))
+        {
+            state.paramsIdx = i;
+            break;
+        }
+    }
+
+    return state;
+}
+
+// Returns the state of the given video mode; working it out, if the mode isn't
+// one whose state was prepared ahead of time, and keeping it for the next time.
+//
+static const mode_state_s& mode_state(const resolution_s &r)
+{
+    const auto key = std::make_pair(r.w, r.h);
+    auto state = MODE_STATES.find(key);
+
+    if (state == MODE_STATES.end())
+    {
+        state = MODE_STATES.insert({key, new_mode_state(r)}).first;
+    }
+
+    return state->second;
+}
+
+// Prepares the states of the video modes in the mode params and alias files,
+// so that switching to any of them is a lookup. To be called whenever the
+// known modes or the aliases change.
+//
+void kc_prepare_mode_states(void)
+{
+    MODE_STATES.clear();
+
+    DEFAULT_COLOR_SETTINGS = CAPTURE_HARDWARE.meta.default_color_settings();
+    DEFAULT_VIDEO_SETTINGS = CAPTURE_HARDWARE.meta.default_video_settings();
+
+    for (const auto &mode: KNOWN_MODES)
+    {
+        mode_state(mode.r);
+    }
+
+    for (const auto &alias: ka_aliases())
+    {
+        mode_state(alias.from);
+        mode_state(alias.to);
+    }
+
+    DEBUG(("Prepared the states of %u video mode(s).", MODE_STATES.size()));
+
     return;
 }
 
 bool kc_adjust_video_vertical_offset(const int delta)
 {
     if (!delta) return true;
-    if (!RECEIVING_A_SIGNAL) return false;
+    if (!ACTIVE_SOURCE->receivingASignal) return false;
 
     const long newPos = (CAPTURE_HARDWARE.status.video_settings().verticalPosition + delta);
     if (newPos < std::max(2, (int)CAPTURE_HARDWARE.meta.minimum_video_settings().verticalPosition) ||
@@ -389,8 +1268,10 @@ bool kc_adjust_video_vertical_offset(const int delta)
         return false;
     }
 
-    if (apicall_succeeds(RGBSetVerPosition(CAPTURE_HANDLE, newPos)))
+    if (apicall_succeeds(RGBSetVerPosition(ACTIVE_SOURCE->handle, newPos)))
     {
+        refresh_status_snapshot();
+
         // Assume that this was a user-requested change, and as such that it
         // should affect the user's custom mode parameter settings.
         const auto currentVideoParams = kc_hardware().status.video_settings();
@@ -405,7 +1286,7 @@ bool kc_adjust_video_vertical_offset(const int delta)
 bool kc_adjust_video_horizontal_offset(const int delta)
 {
     if (!delta) return true;
-    if (!RECEIVING_A_SIGNAL) return false;
+    if (!ACTIVE_SOURCE->receivingASignal) return false;
 
     const long newPos = (CAPTURE_HARDWARE.status.video_settings().horizontalPosition + delta);
     if (newPos < CAPTURE_HARDWARE.meta.minimum_video_settings().horizontalPosition ||
@@ -414,8 +1295,10 @@ bool kc_adjust_video_horizontal_offset(const int delta)
         return false;
     }
 
-    if (apicall_succeeds(RGBSetHorPosition(CAPTURE_HANDLE, newPos)))
+    if (apicall_succeeds(RGBSetHorPosition(ACTIVE_SOURCE->handle, newPos)))
     {
+        refresh_status_snapshot();
+
         // Assume that this was a user-requested change, and as such that it
         // should affect the user's custom mode parameter settings.
         const auto currentVideoParams = kc_hardware().status.video_settings();
@@ -431,6 +1314,16 @@ void kc_release_capture(void)
 {
     INFO(("Releasing the capturer."));
 
+    // Virtual capture stands in for the capture hardware, so stop it first.
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+    {
+        stop_virtual_capture(&CAPTURE_SOURCES[i]);
+    }
+
+    kdump_stop_dumping();
+
+    kdedup_release();
+
     if (CAPTURE_INTERFACE.stop_capture() &&
         CAPTURE_INTERFACE.release_hardware())
     {
@@ -441,19 +1334,42 @@ void kc_release_capture(void)
         NBENE(("Failed to release the capture hardware."));
     }
 
-    FRAME_BUFFER.pixels.release_memory();
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+    {
+        capture_source_s *const source = &CAPTURE_SOURCES[i];
+
+        // Make sure the capture hardware no longer holds on to any of the
+        // ring's buffers before we free them.
+        if (source->zeroCopy)
+        {
+            RGBUseOutputBuffers(source->handle, FALSE);
+            source->zeroCopy = false;
+        }
+
+        source->frameRing.release();
+
+        if (!source->testImageBuffer.is_null())
+        {
+            source->testImageBuffer.release_memory();
+        }
+    }
 
     return;
 }
 
 uint kc_input_channel_idx(void)
 {
-    return INPUT_CHANNEL_IDX;
+    return ACTIVE_SOURCE->inputChannelIdx;
+}
+
+uint kc_num_capture_sources(void)
+{
+    return NUM_CAPTURE_SOURCES;
 }
 
 bool kc_is_capture_active(void)
 {
-    return CAPTURE_IS_ACTIVE;
+    return ACTIVE_SOURCE->isCapturing;
 }
 
 bool kc_set_resolution(const resolution_s r)
@@ -463,19 +1379,15 @@ bool kc_set_resolution(const resolution_s r)
 
 video_mode_params_s kc_mode_params_for_resolution(const resolution_s r)
 {
-    for (const auto &m: KNOWN_MODES)
+    const mode_state_s &state = mode_state(r);
+
+    if (state.paramsIdx >= 0)
     {
-        if (m.r.w == r.w &&
-            m.r.h == r.h)
-        {
-            return m;
-        }
+        return KNOWN_MODES.at(state.paramsIdx);
     }
 
     INFO(("Unknown video mode; returning default parameters."));
-    return {r,
-            CAPTURE_HARDWARE.meta.default_color_settings(),
-            CAPTURE_HARDWARE.meta.default_video_settings()};
+    return {r, DEFAULT_COLOR_SETTINGS, DEFAULT_VIDEO_SETTINGS};
 }
 
 bool kc_set_mode_parameters_for_resolution(const resolution_s r)
@@ -486,19 +1398,21 @@ bool kc_set_mode_parameters_for_resolution(const resolution_s r)
 
     // Apply the set of mode parameters for the current input resolution.
     /// TODO. Add error-checking.
-    RGBSetPhase(CAPTURE_HANDLE,         p.video.phase);
-    RGBSetBlackLevel(CAPTURE_HANDLE,    p.video.blackLevel);
-    RGBSetHorScale(CAPTURE_HANDLE,      p.video.horizontalScale);
-    RGBSetHorPosition(CAPTURE_HANDLE,   p.video.horizontalPosition);
-    RGBSetVerPosition(CAPTURE_HANDLE,   p.video.verticalPosition);
-    RGBSetBrightness(CAPTURE_HANDLE,    p.color.overallBrightness);
-    RGBSetContrast(CAPTURE_HANDLE,      p.color.overallContrast);
-    RGBSetColourBalance(CAPTURE_HANDLE, p.color.redBrightness,
-                                        p.color.greenBrightness,
-                                        p.color.blueBrightness,
-                                        p.color.redContrast,
-                                        p.color.greenContrast,
-                                        p.color.blueContrast);
+    RGBSetPhase(ACTIVE_SOURCE->handle,         p.video.phase);
+    RGBSetBlackLevel(ACTIVE_SOURCE->handle,    p.video.blackLevel);
+    RGBSetHorScale(ACTIVE_SOURCE->handle,      p.video.horizontalScale);
+    RGBSetHorPosition(ACTIVE_SOURCE->handle,   p.video.horizontalPosition);
+    RGBSetVerPosition(ACTIVE_SOURCE->handle,   p.video.verticalPosition);
+    RGBSetBrightness(ACTIVE_SOURCE->handle,    p.color.overallBrightness);
+    RGBSetContrast(ACTIVE_SOURCE->handle,      p.color.overallContrast);
+    RGBSetColourBalance(ACTIVE_SOURCE->handle, p.color.redBrightness,
+                                               p.color.greenBrightness,
+                                               p.color.blueBrightness,
+                                               p.color.redContrast,
+                                               p.color.greenContrast,
+                                               p.color.blueContrast);
+
+    refresh_status_snapshot();
 
     (void)p;
 
@@ -508,7 +1422,7 @@ bool kc_set_mode_parameters_for_resolution(const resolution_s r)
 void kc_apply_new_capture_resolution(void)
 {
     resolution_s currentRes = kc_hardware().status.capture_resolution();
-    resolution_s aliasedRes = ka_aliased(currentRes);
+    resolution_s aliasedRes = mode_state(currentRes).aliasedRes;
 
     // If the current resolution has an alias, switch to that.
     if ((currentRes.w != aliasedRes.w) ||
@@ -523,40 +1437,166 @@ void kc_apply_new_capture_resolution(void)
 
     kc_set_mode_parameters_for_resolution(currentRes);
 
-    RECEIVED_NEW_VIDEO_MODE = false;
+    // Time the switch, unless the mode was re-applied for some other reason,
+    // e.g. its parameters having been reloaded. Only the selected source's
+    // switches are timed, as only its output is shown.
+    if (ACTIVE_SOURCE->receivedNewVideoMode &&
+        ACTIVE_SOURCE->isSelected)
+    {
+        MODE_SWITCH_TIMESTAMP = ACTIVE_SOURCE->newVideoModeTimestamp;
+        IS_MODE_SWITCH_PENDING = true;
+    }
+
+    ACTIVE_SOURCE->receivedNewVideoMode = false;
 
     INFO(("Capturer reports new input mode: %u x %u.", currentRes.w, currentRes.h));
 
     return;
 }
 
+// Has the given number of frames captured at or after the given time be skipped.
+// If frames are still to be skipped for an earlier change, the count runs from
+// that change instead.
+//
+static void skip_frames_captured_since(const std::chrono::steady_clock::time_point &timestamp,
+                                       const u32 numFrames)
+{
+    if (SKIP_NEXT_NUM_FRAMES == 0)
+    {
+        SKIP_FRAMES_SINCE = timestamp;
+    }
+
+    SKIP_NEXT_NUM_FRAMES += numFrames;
+
+    return;
+}
+
+// The frames to be skipped are the selected source's; a background source's
+// frames are never skipped.
+//
 bool kc_should_current_frame_be_skipped(void)
 {
-    return bool(SKIP_NEXT_NUM_FRAMES > 0);
+    const captured_frame_s *const frame = ACTIVE_SOURCE->frameRing.begin_read();
+
+    return (ACTIVE_SOURCE->isSelected &&
+            (SKIP_NEXT_NUM_FRAMES > 0) &&
+            (frame != nullptr) &&
+            (frame->meta.timestamp >= SKIP_FRAMES_SINCE));
+}
+
+// Frees the slot of the source's frame ring that holds its oldest queued frame,
+// for the capture hardware to reuse.
+//
+static void release_oldest_frame(capture_source_s *const source)
+{
+    const captured_frame_s *const releasedFrame = source->frameRing.end_read();
+
+    // Wake virtual capture if it's waiting for the slot. The mutex is taken so
+    // that the wakeup can't land between its check of the ring and its wait.
+    {
+        std::lock_guard<std::mutex> lock(source->frameRingSpaceMutex);
+    }
+    source->frameRingSpaceFreed.notify_one();
+
+    // In zero-copy capture, the capture hardware can now reuse the slot.
+    if (source->zeroCopy &&
+        (releasedFrame != nullptr) &&
+        !chain_output_buffer(source, releasedFrame->pixels))
+    {
+        NBENE(("Failed to hand a capture buffer back to the capture hardware."));
+    }
+
+    // The capture hardware's callbacks can't log, so report on their behalf.
+    if (source->receivedBufferOutOfOrder &&
+        !source->reportedBufferOutOfOrder)
+    {
+        NBENE(("The capture hardware on input channel %u is filling capture buffers out of the order "
+               "they were lent in. Frames that arrive out of order are skipped.", (source->inputChannelIdx + 1)));
+
+        source->reportedBufferOutOfOrder = true;
+    }
+
+    return;
 }
 
+// Releases the frame most recently returned by kc_latest_captured_frame(),
+// freeing its slot in the frame ring for the capture hardware to reuse.
+//
 void kc_mark_current_frame_as_processed(void)
 {
-    CNT_FRAMES_PROCESSED = CNT_FRAMES_CAPTURED.load();
+    if (!ACTIVE_SOURCE->isSelected)
+    {
+        release_oldest_frame(ACTIVE_SOURCE);
 
-    if (SKIP_NEXT_NUM_FRAMES > 0)
+        return;
+    }
+
+    const bool isSkipped = kc_should_current_frame_be_skipped();
+
+    // The first frame in a new video mode that's output completes the switch
+    // to the mode. Frames captured before the switch may still be queued.
+    if (IS_MODE_SWITCH_PENDING &&
+        !isSkipped &&
+        (kc_latest_captured_frame().meta.timestamp >= MODE_SWITCH_TIMESTAMP))
+    {
+        const auto latency = (std::chrono::steady_clock::now() - MODE_SWITCH_TIMESTAMP);
+
+        MODE_SWITCH_LATENCY = std::chrono::duration_cast<std::chrono::milliseconds>(latency).count();
+        IS_MODE_SWITCH_PENDING = false;
+
+        INFO(("The first frame in the new video mode was output %.1f ms after the mode switch.",
+              (std::chrono::duration_cast<std::chrono::microseconds>(latency).count() / 1000.0)));
+    }
+
+    release_oldest_frame(ACTIVE_SOURCE);
+
+    if (isSkipped)
     {
         SKIP_NEXT_NUM_FRAMES--;
     }
 
-    FRAME_BUFFER.processed = true;
+    return;
+}
+
+uint kc_selected_source_idx(void)
+{
+    return (SELECTED_SOURCE - CAPTURE_SOURCES);
+}
+
+uint kc_active_source_idx(void)
+{
+    return (ACTIVE_SOURCE - CAPTURE_SOURCES);
+}
+
+bool kc_is_selected_source_active(void)
+{
+    return (ACTIVE_SOURCE == SELECTED_SOURCE);
+}
+
+// Has VCS's processing act on the capture source of the given index - e.g. so
+// that a background source's events and frames can be processed like the
+// selected source's, through kc_latest_capture_event() and the rest. Processing
+// should be returned to the selected source by activating it once done, before
+// control returns to the GUI. The caller is expected to hold INPUT_OUTPUT_MUTEX.
+//
+void kc_activate_source(const uint sourceIdx)
+{
+    k_assert((sourceIdx < NUM_CAPTURE_SOURCES),
+             "Was asked to activate a capture source that doesn't exist.");
+
+    ACTIVE_SOURCE = &CAPTURE_SOURCES[sourceIdx];
 
     return;
 }
 
 bool kc_is_invalid_signal(void)
 {
-    return SIGNAL_IS_INVALID;
+    return ACTIVE_SOURCE->signalIsInvalid;
 }
 
 bool kc_no_signal(void)
 {
-    return !RECEIVING_A_SIGNAL;
+    return !ACTIVE_SOURCE->receivingASignal;
 }
 
 // Examine the state of the capture system and decide which has been the most recent
@@ -566,41 +1606,47 @@ bool kc_no_signal(void)
 /// is a getter, but also modifies the unit's state.
 capture_event_e kc_latest_capture_event(void)
 {
-    if (UNRECOVERABLE_CAPTURE_ERROR)
+    if (ACTIVE_SOURCE->unrecoverableError)
     {
         return capture_event_e::unrecoverable_error;
     }
-    else if (RECEIVED_NEW_VIDEO_MODE)
+    else if (ACTIVE_SOURCE->receivedNewVideoMode)
     {
-        RECEIVING_A_SIGNAL = true;
-        SIGNAL_IS_INVALID = false;
+        ACTIVE_SOURCE->receivingASignal = true;
+        ACTIVE_SOURCE->signalIsInvalid = false;
+
+        refresh_status_snapshot();
 
         return capture_event_e::new_video_mode;
     }
-    else if (SIGNAL_WAS_LOST)
+    else if (ACTIVE_SOURCE->signalWasLost)
     {
-        RECEIVING_A_SIGNAL = false;
-        SIGNAL_WAS_LOST = false;
+        ACTIVE_SOURCE->receivingASignal = false;
+        ACTIVE_SOURCE->signalWasLost = false;
+
+        refresh_status_snapshot();
 
         return capture_event_e::no_signal;
     }
-    else if (!RECEIVING_A_SIGNAL)
+    else if (!ACTIVE_SOURCE->receivingASignal)
     {
         return capture_event_e::sleep;
     }
-    else if (SIGNAL_BECAME_INVALID)
+    else if (ACTIVE_SOURCE->signalBecameInvalid)
     {
-        RECEIVING_A_SIGNAL = false;
-        SIGNAL_IS_INVALID = true;
-        SIGNAL_BECAME_INVALID = false;
+        ACTIVE_SOURCE->receivingASignal = false;
+        ACTIVE_SOURCE->signalIsInvalid = true;
+        ACTIVE_SOURCE->signalBecameInvalid = false;
+
+        refresh_status_snapshot();
 
         return capture_event_e::invalid_signal;
     }
-    else if (SIGNAL_IS_INVALID)
+    else if (ACTIVE_SOURCE->signalIsInvalid)
     {
         return capture_event_e::sleep;
     }
-    else if (CNT_FRAMES_CAPTURED != CNT_FRAMES_PROCESSED)
+    else if (!ACTIVE_SOURCE->frameRing.is_empty())
     {
         return capture_event_e::new_frame;
     }
@@ -609,12 +1655,77 @@ capture_event_e kc_latest_capture_event(void)
     return capture_event_e::none;
 }
 
+// Asks the capture hardware to scale the frames it sends to the given size, or
+// as near to it as the hardware can, rather than sending them at the capture
+// resolution; so that they take less to transfer and to process, and the scaler
+// has less left to do. The hardware is only ever asked to downscale: in either
+// direction in which the size isn't smaller than the capture resolution, the
+// frames are sent unscaled. Asking for the capture resolution turns the scaling
+// off.
+//
+// Meant to be called as often as once per frame; the hardware is only talked to
+// when the size or the capture resolution has changed.
+//
+void kc_set_hardware_output_size(const resolution_s &size)
+{
+    capture_source_s *const source = ACTIVE_SOURCE;
+    const resolution_s captureRes = kc_hardware().status.capture_resolution();
+    resolution_s outputSize;
+    unsigned long w = 0, h = 0;
+
+    if (!captureRes.w ||
+        !captureRes.h)
+    {
+        goto done;
+    }
+
+    if ((size.w == source->requestedOutputSize.w) &&
+        (size.h == source->requestedOutputSize.h) &&
+        (captureRes.w == source->requestedOutputSizeCaptureRes.w) &&
+        (captureRes.h == source->requestedOutputSizeCaptureRes.h))
+    {
+        goto done;
+    }
+
+    source->requestedOutputSize = size;
+    source->requestedOutputSizeCaptureRes = captureRes;
+
+    // Frames smaller than the minimum capture resolution would be rejected by
+    // the scaler.
+    {
+        const resolution_s minRes = kc_hardware().meta.minimum_capture_resolution();
+
+        outputSize.w = std::max(minRes.w, std::min(size.w, captureRes.w));
+        outputSize.h = std::max(minRes.h, std::min(size.h, captureRes.h));
+    }
+
+    if (!apicall_succeeds(RGBSetOutputSize(source->handle, outputSize.w, outputSize.h)) ||
+        !apicall_succeeds(RGBGetOutputSize(source->handle, &w, &h)))
+    {
+        NBENE(("The capture hardware failed to set the output size to %u x %u.", outputSize.w, outputSize.h));
+        goto done;
+    }
+
+    if ((w == captureRes.w) &&
+        (h == captureRes.h))
+    {
+        DEBUG(("The capture hardware is sending frames at the capture resolution."));
+    }
+    else
+    {
+        DEBUG(("The capture hardware is downscaling frames to %u x %u.", w, h));
+    }
+
+    done:
+    return;
+}
+
 bool kc_set_frame_dropping(const u32 drop)
 {
     // Sanity check.
     k_assert(drop < 100, "Odd frame drop number.");
 
-    if (apicall_succeeds(RGBSetFrameDropping(CAPTURE_HANDLE, drop)))
+    if (apicall_succeeds(RGBSetFrameDropping(ACTIVE_SOURCE->handle, drop)))
     {
         INFO(("Setting frame drop to %u.", drop));
 
@@ -635,6 +1746,10 @@ bool kc_set_frame_dropping(const u32 drop)
     return false;
 }
 
+// Switches to capturing from the given input channel. If a capture source is
+// already open on that channel, it becomes the selected source; otherwise, the
+// selected source is moved over to the channel.
+//
 bool kc_set_input_channel(const u32 channel)
 {
     if (channel >= MAX_INPUT_CHANNELS)
@@ -642,11 +1757,59 @@ bool kc_set_input_channel(const u32 channel)
         goto fail;
     }
 
-    if (apicall_succeeds(RGBSetInput(CAPTURE_HANDLE, channel)))
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+    {
+        capture_source_s *const source = &CAPTURE_SOURCES[i];
+
+        if ((source->inputChannelIdx == channel) &&
+            (source != SELECTED_SOURCE))
+        {
+            INFO(("Switching to the capture source on input channel %u.", (channel + 1)));
+
+            {
+                std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+
+                // The previously-selected source carries on in the background,
+                // its queued frames to be processed as such.
+                SELECTED_SOURCE->isSelected = false;
+                source->isSelected = true;
+                SELECTED_SOURCE = source;
+                ACTIVE_SOURCE = source;
+
+                // The source's video mode is likely different from the previous
+                // one's, so have it be handled as a new mode.
+                if (source->receivingASignal)
+                {
+                    source->receivedNewVideoMode = true;
+                    source->newVideoModeTimestamp = std::chrono::steady_clock::now();
+                }
+            }
+
+            INPUT_CHANNEL_IDX = channel;
+
+            kc_negotiate_capture_pixel_format();
+
+            // The new input's default mode parameters may differ.
+            kc_prepare_mode_states();
+
+            refresh_status_snapshot();
+            kpropagate_news_of_changed_capture_source();
+            kd_wake_event_loop();
+
+            return true;
+        }
+    }
+
+    if (apicall_succeeds(RGBSetInput(ACTIVE_SOURCE->handle, channel)))
     {
         INFO(("Setting capture input channel to %u.", (channel + 1)));
 
+        ACTIVE_SOURCE->inputChannelIdx = channel;
         INPUT_CHANNEL_IDX = channel;
+
+        kc_prepare_mode_states();
+
+        refresh_status_snapshot();
     }
     else
     {
@@ -663,49 +1826,79 @@ bool kc_set_input_channel(const u32 channel)
 
 uint kc_output_color_depth(void)
 {
-    return CAPTURE_OUTPUT_COLOR_DEPTH;
+    return ACTIVE_SOURCE->outputColorDepth;
 }
 
 PIXELFORMAT kc_pixel_format(void)
 {
-    return CAPTURE_PIXEL_FORMAT;
+    return ACTIVE_SOURCE->pixelFormat;
 }
 
 uint kc_input_color_depth(void)
 {
-    switch (CAPTURE_PIXEL_FORMAT)
+    switch (ACTIVE_SOURCE->pixelFormat)
     {
         case RGB_PIXELFORMAT_888: return 24;
         case RGB_PIXELFORMAT_565: return 16;
         case RGB_PIXELFORMAT_555: return 15;
+        case RGB_PIXELFORMAT_YUY2: return 16;
         default: k_assert(0, "Found an unknown pixel format while being queried for it."); return 0;
     }
 }
 
 bool kc_set_input_color_depth(const u32 bpp)
 {
-    const PIXELFORMAT previousFormat = CAPTURE_PIXEL_FORMAT;
-    const uint previousColorDepth = CAPTURE_OUTPUT_COLOR_DEPTH;
-
     switch (bpp)
     {
-        case 24: CAPTURE_PIXEL_FORMAT = RGB_PIXELFORMAT_888; CAPTURE_OUTPUT_COLOR_DEPTH = 32; break;
-        case 16: CAPTURE_PIXEL_FORMAT = RGB_PIXELFORMAT_565; CAPTURE_OUTPUT_COLOR_DEPTH = 16; break;
-        case 15: CAPTURE_PIXEL_FORMAT = RGB_PIXELFORMAT_555; CAPTURE_OUTPUT_COLOR_DEPTH = 16; break;
-        default: k_assert(0, "Was asked to set an unknown pixel format."); break;
+        case 24: return kc_set_capture_pixel_format(RGB_PIXELFORMAT_888);
+        case 16: return kc_set_capture_pixel_format(RGB_PIXELFORMAT_565);
+        case 15: return kc_set_capture_pixel_format(RGB_PIXELFORMAT_555);
+        default: k_assert(0, "Was asked to set an unknown color depth."); return false;
+    }
+}
+
+// Asks the capture hardware to send its frames in the given pixel format: 888,
+// 565, or 555 RGB, or YUY2 (YUV 4:2:2). All but 888, which arrives in 32 bits
+// per pixel, arrive in 16 bits per pixel; so they halve the amount of data that
+// needs to be moved per frame, though at the cost of some color information.
+//
+bool kc_set_capture_pixel_format(const PIXELFORMAT pixelFormat)
+{
+    const auto changeTimestamp = std::chrono::steady_clock::now();
+    uint colorDepth = 0;
+
+    if ((pixelFormat == RGB_PIXELFORMAT_YUY2) &&
+        !kc_hardware().supports.yuv())
+    {
+        NBENE(("Was asked to capture in YUV, which the capture hardware doesn't support. Ignoring the request."));
+        goto fail;
     }
 
-    if (!apicall_succeeds(RGBSetPixelFormat(CAPTURE_HANDLE, CAPTURE_PIXEL_FORMAT)))
+    switch (pixelFormat)
     {
-        CAPTURE_PIXEL_FORMAT = previousFormat;
-        CAPTURE_OUTPUT_COLOR_DEPTH = previousColorDepth;
+        case RGB_PIXELFORMAT_888:  colorDepth = 32; break;
+        case RGB_PIXELFORMAT_565:  colorDepth = 16; break;
+        case RGB_PIXELFORMAT_555:  colorDepth = 16; break;
+        case RGB_PIXELFORMAT_YUY2: colorDepth = 16; break;
+        default: k_assert(0, "Was asked to set an unknown pixel format."); break;
+    }
 
+    if (!apicall_succeeds(RGBSetPixelFormat(ACTIVE_SOURCE->handle, pixelFormat)))
+    {
         goto fail;
     }
 
+    // Publish the switch only now that the hardware has accepted it, so the
+    // capture callbacks never see a format the hardware isn't capturing in.
+    // Frames already in flight carry the format they were captured in (see
+    // stamp_frame()), and the first frame captured after the switch gets
+    // skipped below.
+    ACTIVE_SOURCE->pixelFormat = pixelFormat;
+    ACTIVE_SOURCE->outputColorDepth = colorDepth;
+
     // Ignore the next frame to avoid displaying some visual corruption from
     // switching the bit depth.
-    SKIP_NEXT_NUM_FRAMES += 1;
+    skip_frames_captured_since(changeTimestamp, 1);
 
     return true;
 
@@ -713,6 +1906,49 @@ bool kc_set_input_color_depth(const u32 bpp)
     return false;
 }
 
+void kc_set_pixel_format_negotiation_enabled(const bool enabled)
+{
+    NEGOTIATE_PIXEL_FORMAT = enabled;
+
+    kc_negotiate_capture_pixel_format();
+
+    return;
+}
+
+// If VCS is to choose the capture pixel format, switches capture into the
+// cheapest format - in terms of the amount of data moved per frame - that the
+// current processing accepts. Frames are converted to BGRA for processing in
+// any case, but some filters analyze the exact colors of the frames, and so
+// need them captured in full color. Should be called whenever the set of active
+// filters changes.
+//
+void kc_negotiate_capture_pixel_format(void)
+{
+    PIXELFORMAT pixelFormat = RGB_PIXELFORMAT_888;
+
+    if (!NEGOTIATE_PIXEL_FORMAT)
+    {
+        return;
+    }
+
+    // YUV 4:2:2 keeps the full luma resolution, so it's a better fit for video
+    // in general than 565 and 555, which we leave for the user to choose.
+    if (!kf_active_filters_need_full_color() &&
+        kc_hardware().supports.yuv())
+    {
+        pixelFormat = RGB_PIXELFORMAT_YUY2;
+    }
+
+    if (pixelFormat != ACTIVE_SOURCE->pixelFormat)
+    {
+        INFO(("Switching capture into %s.", ((pixelFormat == RGB_PIXELFORMAT_YUY2)? "YUV 4:2:2" : "24-bit RGB")));
+
+        kc_set_capture_pixel_format(pixelFormat);
+    }
+
+    return;
+}
+
 const std::vector<video_mode_params_s>& kc_mode_params(void)
 {
     return KNOWN_MODES;
@@ -727,14 +1963,16 @@ void kc_set_color_settings(const capture_color_settings_s c)
         return;
     }
 
-    RGBSetBrightness(CAPTURE_HANDLE, c.overallBrightness);
-    RGBSetContrast(CAPTURE_HANDLE, c.overallContrast);
-    RGBSetColourBalance(CAPTURE_HANDLE, c.redBrightness,
-                                        c.greenBrightness,
-                                        c.blueBrightness,
-                                        c.redContrast,
-                                        c.greenContrast,
-                                        c.blueContrast);
+    RGBSetBrightness(ACTIVE_SOURCE->handle, c.overallBrightness);
+    RGBSetContrast(ACTIVE_SOURCE->handle, c.overallContrast);
+    RGBSetColourBalance(ACTIVE_SOURCE->handle, c.redBrightness,
+                                               c.greenBrightness,
+                                               c.blueBrightness,
+                                               c.redContrast,
+                                               c.greenContrast,
+                                               c.blueContrast);
+
+    refresh_status_snapshot();
 
     update_known_video_mode_params(kc_hardware().status.capture_resolution(), &c, nullptr);
 
@@ -750,11 +1988,13 @@ void kc_set_video_settings(const capture_video_settings_s v)
         return;
     }
 
-    RGBSetPhase(CAPTURE_HANDLE, v.phase);
-    RGBSetBlackLevel(CAPTURE_HANDLE, v.blackLevel);
-    RGBSetHorPosition(CAPTURE_HANDLE, v.horizontalPosition);
-    RGBSetHorScale(CAPTURE_HANDLE, v.horizontalScale);
-    RGBSetVerPosition(CAPTURE_HANDLE, v.verticalPosition);
+    RGBSetPhase(ACTIVE_SOURCE->handle, v.phase);
+    RGBSetBlackLevel(ACTIVE_SOURCE->handle, v.blackLevel);
+    RGBSetHorPosition(ACTIVE_SOURCE->handle, v.horizontalPosition);
+    RGBSetHorScale(ACTIVE_SOURCE->handle, v.horizontalScale);
+    RGBSetVerPosition(ACTIVE_SOURCE->handle, v.verticalPosition);
+
+    refresh_status_snapshot();
 
     update_known_video_mode_params(kc_hardware().status.capture_resolution(), nullptr, &v);
 
@@ -764,13 +2004,13 @@ void kc_set_video_settings(const capture_video_settings_s v)
 #ifdef VALIDATION_RUN
     void kc_VALIDATION_set_capture_color_depth(const uint bpp)
     {
-        CAPTURE_COLOR_DEPTH = bpp;
+        ACTIVE_SOURCE->outputColorDepth = bpp;
         return;
     }
 
     void kc_VALIDATION_set_capture_pixel_format(const PIXELFORMAT pf)
     {
-        CAPTURE_PIXEL_FORMAT = pf;
+        ACTIVE_SOURCE->pixelFormat = pf;
         return;
     }
 #endif
@@ -871,14 +2111,14 @@ std::string capture_hardware_s::metainfo_s::model_name() const
 int capture_hardware_s::metainfo_s::minimum_frame_drop() const
 {
     unsigned long frameDrop = 0;
-    if (!apicall_succeeds(RGBGetFrameDroppingMinimum(CAPTURE_HANDLE, &frameDrop))) return -1;
+    if (!apicall_succeeds(RGBGetFrameDroppingMinimum(ACTIVE_SOURCE->handle, &frameDrop))) return -1;
     return frameDrop;
 }
 
 int capture_hardware_s::metainfo_s::maximum_frame_drop() const
 {
     unsigned long frameDrop = 0;
-    if (!apicall_succeeds(RGBGetFrameDroppingMaximum(CAPTURE_HANDLE, &frameDrop))) return -1;
+    if (!apicall_succeeds(RGBGetFrameDroppingMaximum(ACTIVE_SOURCE->handle, &frameDrop))) return -1;
     return frameDrop;
 }
 
@@ -889,7 +2129,7 @@ std::string capture_hardware_s::metainfo_s::driver_version() const
     RGBINPUTINFO ii = {0};
     ii.Size = sizeof(ii);
 
-    if (!apicall_succeeds(RGBGetInputInfo(INPUT_CHANNEL_IDX, &ii))) return unknownVersion;
+    if (!apicall_succeeds(RGBGetInputInfo(ACTIVE_SOURCE->inputChannelIdx, &ii))) return unknownVersion;
 
     return std::string(std::to_string(ii.Driver.Major) + "." +
                        std::to_string(ii.Driver.Minor) + "." +
@@ -904,7 +2144,7 @@ std::string capture_hardware_s::metainfo_s::firmware_version() const
     RGBINPUTINFO ii = {0};
     ii.Size = sizeof(ii);
 
-    if (!apicall_succeeds(RGBGetInputInfo(INPUT_CHANNEL_IDX, &ii))) return unknownVersion;
+    if (!apicall_succeeds(RGBGetInputInfo(ACTIVE_SOURCE->inputChannelIdx, &ii))) return unknownVersion;
 
     return std::to_string(ii.FirmWare);
 }
@@ -913,14 +2153,14 @@ capture_color_settings_s capture_hardware_s::metainfo_s::default_color_settings(
 {
     capture_color_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetBrightnessDefault(CAPTURE_HANDLE, &p.overallBrightness)) ||
-        !apicall_succeeds(RGBGetContrastDefault(CAPTURE_HANDLE, &p.overallContrast)) ||
-        !apicall_succeeds(RGBGetColourBalanceDefault(CAPTURE_HANDLE, &p.redBrightness,
-                                                                     &p.greenBrightness,
-                                                                     &p.blueBrightness,
-                                                                     &p.redContrast,
-                                                                     &p.greenContrast,
-                                                                     &p.blueContrast)))
+    if (!apicall_succeeds(RGBGetBrightnessDefault(ACTIVE_SOURCE->handle, &p.overallBrightness)) ||
+        !apicall_succeeds(RGBGetContrastDefault(ACTIVE_SOURCE->handle, &p.overallContrast)) ||
+        !apicall_succeeds(RGBGetColourBalanceDefault(ACTIVE_SOURCE->handle, &p.redBrightness,
+                                                                            &p.greenBrightness,
+                                                                            &p.blueBrightness,
+                                                                            &p.redContrast,
+                                                                            &p.greenContrast,
+                                                                            &p.blueContrast)))
     {
         return {0};
     }
@@ -932,14 +2172,14 @@ capture_color_settings_s capture_hardware_s::metainfo_s::minimum_color_settings(
 {
     capture_color_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetBrightnessMinimum(CAPTURE_HANDLE, &p.overallBrightness)) ||
-        !apicall_succeeds(RGBGetContrastMinimum(CAPTURE_HANDLE, &p.overallContrast)) ||
-        !apicall_succeeds(RGBGetColourBalanceMinimum(CAPTURE_HANDLE, &p.redBrightness,
-                                                                     &p.greenBrightness,
-                                                                     &p.blueBrightness,
-                                                                     &p.redContrast,
-                                                                     &p.greenContrast,
-                                                                     &p.blueContrast)))
+    if (!apicall_succeeds(RGBGetBrightnessMinimum(ACTIVE_SOURCE->handle, &p.overallBrightness)) ||
+        !apicall_succeeds(RGBGetContrastMinimum(ACTIVE_SOURCE->handle, &p.overallContrast)) ||
+        !apicall_succeeds(RGBGetColourBalanceMinimum(ACTIVE_SOURCE->handle, &p.redBrightness,
+                                                                            &p.greenBrightness,
+                                                                            &p.blueBrightness,
+                                                                            &p.redContrast,
+                                                                            &p.greenContrast,
+                                                                            &p.blueContrast)))
     {
         return {0};
     }
@@ -951,14 +2191,14 @@ capture_color_settings_s capture_hardware_s::metainfo_s::maximum_color_settings(
 {
     capture_color_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetBrightnessMaximum(CAPTURE_HANDLE, &p.overallBrightness)) ||
-        !apicall_succeeds(RGBGetContrastMaximum(CAPTURE_HANDLE, &p.overallContrast)) ||
-        !apicall_succeeds(RGBGetColourBalanceMaximum(CAPTURE_HANDLE, &p.redBrightness,
-                                                                     &p.greenBrightness,
-                                                                     &p.blueBrightness,
-                                                                     &p.redContrast,
-                                                                     &p.greenContrast,
-                                                                     &p.blueContrast)))
+    if (!apicall_succeeds(RGBGetBrightnessMaximum(ACTIVE_SOURCE->handle, &p.overallBrightness)) ||
+        !apicall_succeeds(RGBGetContrastMaximum(ACTIVE_SOURCE->handle, &p.overallContrast)) ||
+        !apicall_succeeds(RGBGetColourBalanceMaximum(ACTIVE_SOURCE->handle, &p.redBrightness,
+                                                                            &p.greenBrightness,
+                                                                            &p.blueBrightness,
+                                                                            &p.redContrast,
+                                                                            &p.greenContrast,
+                                                                            &p.blueContrast)))
     {
         return {0};
     }
@@ -970,11 +2210,11 @@ capture_video_settings_s capture_hardware_s::metainfo_s::default_video_settings(
 {
     capture_video_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetPhaseDefault(CAPTURE_HANDLE, &p.phase)) ||
-        !apicall_succeeds(RGBGetBlackLevelDefault(CAPTURE_HANDLE, &p.blackLevel)) ||
-        !apicall_succeeds(RGBGetHorPositionDefault(CAPTURE_HANDLE, &p.horizontalPosition)) ||
-        !apicall_succeeds(RGBGetVerPositionDefault(CAPTURE_HANDLE, &p.verticalPosition)) ||
-        !apicall_succeeds(RGBGetHorScaleDefault(CAPTURE_HANDLE, &p.horizontalScale)))
+    if (!apicall_succeeds(RGBGetPhaseDefault(ACTIVE_SOURCE->handle, &p.phase)) ||
+        !apicall_succeeds(RGBGetBlackLevelDefault(ACTIVE_SOURCE->handle, &p.blackLevel)) ||
+        !apicall_succeeds(RGBGetHorPositionDefault(ACTIVE_SOURCE->handle, &p.horizontalPosition)) ||
+        !apicall_succeeds(RGBGetVerPositionDefault(ACTIVE_SOURCE->handle, &p.verticalPosition)) ||
+        !apicall_succeeds(RGBGetHorScaleDefault(ACTIVE_SOURCE->handle, &p.horizontalScale)))
     {
         return {0};
     }
@@ -986,11 +2226,11 @@ capture_video_settings_s capture_hardware_s::metainfo_s::minimum_video_settings(
 {
     capture_video_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetPhaseMinimum(CAPTURE_HANDLE, &p.phase)) ||
-        !apicall_succeeds(RGBGetBlackLevelMinimum(CAPTURE_HANDLE, &p.blackLevel)) ||
-        !apicall_succeeds(RGBGetHorPositionMinimum(CAPTURE_HANDLE, &p.horizontalPosition)) ||
-        !apicall_succeeds(RGBGetVerPositionMinimum(CAPTURE_HANDLE, &p.verticalPosition)) ||
-        !apicall_succeeds(RGBGetHorScaleMinimum(CAPTURE_HANDLE, &p.horizontalScale)))
+    if (!apicall_succeeds(RGBGetPhaseMinimum(ACTIVE_SOURCE->handle, &p.phase)) ||
+        !apicall_succeeds(RGBGetBlackLevelMinimum(ACTIVE_SOURCE->handle, &p.blackLevel)) ||
+        !apicall_succeeds(RGBGetHorPositionMinimum(ACTIVE_SOURCE->handle, &p.horizontalPosition)) ||
+        !apicall_succeeds(RGBGetVerPositionMinimum(ACTIVE_SOURCE->handle, &p.verticalPosition)) ||
+        !apicall_succeeds(RGBGetHorScaleMinimum(ACTIVE_SOURCE->handle, &p.horizontalScale)))
     {
         return {0};
     }
@@ -1002,11 +2242,11 @@ capture_video_settings_s capture_hardware_s::metainfo_s::maximum_video_settings(
 {
     capture_video_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetPhaseMaximum(CAPTURE_HANDLE, &p.phase)) ||
-        !apicall_succeeds(RGBGetBlackLevelMaximum(CAPTURE_HANDLE, &p.blackLevel)) ||
-        !apicall_succeeds(RGBGetHorPositionMaximum(CAPTURE_HANDLE, &p.horizontalPosition)) ||
-        !apicall_succeeds(RGBGetVerPositionMaximum(CAPTURE_HANDLE, &p.verticalPosition)) ||
-        !apicall_succeeds(RGBGetHorScaleMaximum(CAPTURE_HANDLE, &p.horizontalScale)))
+    if (!apicall_succeeds(RGBGetPhaseMaximum(ACTIVE_SOURCE->handle, &p.phase)) ||
+        !apicall_succeeds(RGBGetBlackLevelMaximum(ACTIVE_SOURCE->handle, &p.blackLevel)) ||
+        !apicall_succeeds(RGBGetHorPositionMaximum(ACTIVE_SOURCE->handle, &p.horizontalPosition)) ||
+        !apicall_succeeds(RGBGetVerPositionMaximum(ACTIVE_SOURCE->handle, &p.verticalPosition)) ||
+        !apicall_succeeds(RGBGetHorScaleMaximum(ACTIVE_SOURCE->handle, &p.horizontalScale)))
     {
         return {0};
     }
@@ -1022,8 +2262,8 @@ resolution_s capture_hardware_s::metainfo_s::minimum_capture_resolution() const
     r.w = 1;
     r.h = 1;
 #else
-    if (!apicall_succeeds(RGBGetCaptureWidthMinimum(CAPTURE_HANDLE, &r.w)) ||
-        !apicall_succeeds(RGBGetCaptureHeightMinimum(CAPTURE_HANDLE, &r.h)))
+    if (!apicall_succeeds(RGBGetCaptureWidthMinimum(ACTIVE_SOURCE->handle, &r.w)) ||
+        !apicall_succeeds(RGBGetCaptureHeightMinimum(ACTIVE_SOURCE->handle, &r.h)))
     {
         return {0};
     }
@@ -1040,11 +2280,12 @@ resolution_s capture_hardware_s::metainfo_s::maximum_capture_resolution() const
     resolution_s r;
 
 #if !USE_RGBEASY_API
-    r.w = 1920;
-    r.h = 1260;
+    // Make room for test patterns larger than the nominal maximum.
+    r.w = std::max(1920ul, kcom_test_pattern().r.w);
+    r.h = std::max(1260ul, kcom_test_pattern().r.h);
 #else
-    if (!apicall_succeeds(RGBGetCaptureWidthMaximum(CAPTURE_HANDLE, &r.w)) ||
-        !apicall_succeeds(RGBGetCaptureHeightMaximum(CAPTURE_HANDLE, &r.h)))
+    if (!apicall_succeeds(RGBGetCaptureWidthMaximum(ACTIVE_SOURCE->handle, &r.w)) ||
+        !apicall_succeeds(RGBGetCaptureHeightMaximum(ACTIVE_SOURCE->handle, &r.h)))
     {
         return {0};
     }
@@ -1070,42 +2311,51 @@ int capture_hardware_s::metainfo_s::num_capture_inputs() const
 bool capture_hardware_s::metainfo_s::is_dma_enabled() const
 {
     long isEnabled = 0;
-    if (!apicall_succeeds(RGBGetDMADirect(CAPTURE_HANDLE, &isEnabled))) return false;
+    if (!apicall_succeeds(RGBGetDMADirect(ACTIVE_SOURCE->handle, &isEnabled))) return false;
     return isEnabled;
 }
 
-resolution_s capture_hardware_s::status_s::capture_resolution() const
+// Polls the capture hardware for its current input resolution. The number of API
+// calls made in doing so is returned in numApiCalls; likewise for the other
+// poll_*() functions.
+//
+static resolution_s poll_capture_resolution(uint *const numApiCalls)
 {
     resolution_s r;
 
+    *numApiCalls = 0;
+
 #if USE_RGBEASY_API
-    if (!apicall_succeeds(RGBGetCaptureWidth(CAPTURE_HANDLE, &r.w)) ||
-        !apicall_succeeds(RGBGetCaptureHeight(CAPTURE_HANDLE, &r.h)))
+    if (!counted_apicall_succeeds(RGBGetCaptureWidth(ACTIVE_SOURCE->handle, &r.w), numApiCalls) ||
+        !counted_apicall_succeeds(RGBGetCaptureHeight(ACTIVE_SOURCE->handle, &r.h), numApiCalls))
     {
         k_assert(0, "The capture hardware failed to report its input resolution.");
     }
 #else
-    r.w = 640;
-    r.h = 480;
+    r = ACTIVE_SOURCE->virtualCaptureResolution;
 #endif
 
-    r.bpp = CAPTURE_OUTPUT_COLOR_DEPTH;
+    r.bpp = ACTIVE_SOURCE->outputColorDepth;
 
     return r;
 }
 
-capture_color_settings_s capture_hardware_s::status_s::color_settings() const
+// Polls the capture hardware for its current color settings.
+//
+static capture_color_settings_s poll_color_settings(uint *const numApiCalls)
 {
     capture_color_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetBrightness(CAPTURE_HANDLE, &p.overallBrightness)) ||
-        !apicall_succeeds(RGBGetContrast(CAPTURE_HANDLE, &p.overallContrast)) ||
-        !apicall_succeeds(RGBGetColourBalance(CAPTURE_HANDLE, &p.redBrightness,
-                                                              &p.greenBrightness,
-                                                              &p.blueBrightness,
-                                                              &p.redContrast,
-                                                              &p.greenContrast,
-                                                              &p.blueContrast)))
+    *numApiCalls = 0;
+
+    if (!counted_apicall_succeeds(RGBGetBrightness(ACTIVE_SOURCE->handle, &p.overallBrightness), numApiCalls) ||
+        !counted_apicall_succeeds(RGBGetContrast(ACTIVE_SOURCE->handle, &p.overallContrast), numApiCalls) ||
+        !counted_apicall_succeeds(RGBGetColourBalance(ACTIVE_SOURCE->handle, &p.redBrightness,
+                                                                             &p.greenBrightness,
+                                                                             &p.blueBrightness,
+                                                                             &p.redContrast,
+                                                                             &p.greenContrast,
+                                                                             &p.blueContrast), numApiCalls))
     {
         return {0};
     }
@@ -1113,15 +2363,19 @@ capture_color_settings_s capture_hardware_s::status_s::color_settings() const
     return p;
 }
 
-capture_video_settings_s capture_hardware_s::status_s::video_settings() const
+// Polls the capture hardware for its current video settings.
+//
+static capture_video_settings_s poll_video_settings(uint *const numApiCalls)
 {
     capture_video_settings_s p = {0};
 
-    if (!apicall_succeeds(RGBGetPhase(CAPTURE_HANDLE, &p.phase)) ||
-        !apicall_succeeds(RGBGetBlackLevel(CAPTURE_HANDLE, &p.blackLevel)) ||
-        !apicall_succeeds(RGBGetHorPosition(CAPTURE_HANDLE, &p.horizontalPosition)) ||
-        !apicall_succeeds(RGBGetVerPosition(CAPTURE_HANDLE, &p.verticalPosition)) ||
-        !apicall_succeeds(RGBGetHorScale(CAPTURE_HANDLE, &p.horizontalScale)))
+    *numApiCalls = 0;
+
+    if (!counted_apicall_succeeds(RGBGetPhase(ACTIVE_SOURCE->handle, &p.phase), numApiCalls) ||
+        !counted_apicall_succeeds(RGBGetBlackLevel(ACTIVE_SOURCE->handle, &p.blackLevel), numApiCalls) ||
+        !counted_apicall_succeeds(RGBGetHorPosition(ACTIVE_SOURCE->handle, &p.horizontalPosition), numApiCalls) ||
+        !counted_apicall_succeeds(RGBGetVerPosition(ACTIVE_SOURCE->handle, &p.verticalPosition), numApiCalls) ||
+        !counted_apicall_succeeds(RGBGetHorScale(ACTIVE_SOURCE->handle, &p.horizontalScale), numApiCalls))
     {
         return {0};
     }
@@ -1129,27 +2383,29 @@ capture_video_settings_s capture_hardware_s::status_s::video_settings() const
     return p;
 }
 
-capture_signal_s capture_hardware_s::status_s::signal() const
+// Polls the capture hardware for the properties of its current input signal.
+//
+static capture_signal_s poll_signal(const resolution_s &captureResolution, uint *const numApiCalls)
 {
+    capture_signal_s s = {0};
+
+    *numApiCalls = 0;
+
     if (kc_no_signal())
     {
-        NBENE(("Tried to query the capture signal while no signal was being received."));
-        return {0};
+        return s;
     }
 
-    capture_signal_s s = {0};
-
 #if !USE_RGBEASY_API
-    s.r.w = 640;
-    s.r.h = 480;
+    s.r = captureResolution;
     s.refreshRate = 60;
 #else
     RGBMODEINFO mi = {0};
     mi.Size = sizeof(mi);
 
-    s.wokeUp = SIGNAL_WOKE_UP;
+    s.wokeUp = ACTIVE_SOURCE->signalWokeUp;
 
-    if (apicall_succeeds(RGBGetModeInfo(CAPTURE_HANDLE, &mi)))
+    if (counted_apicall_succeeds(RGBGetModeInfo(ACTIVE_SOURCE->handle, &mi), numApiCalls))
     {
         s.isInterlaced = mi.BInterlaced;
         s.isDigital = mi.BDVI;
@@ -1162,16 +2418,104 @@ capture_signal_s capture_hardware_s::status_s::signal() const
         s.refreshRate = 0;
     }
 
-    s.r = CAPTURE_HARDWARE.status.capture_resolution();
+    s.r = captureResolution;
 #endif
 
     return s;
 }
 
+// Re-polls the capture hardware for the status values held in the status
+// snapshot. To be called whenever the status may have changed.
+//
+static void refresh_status_snapshot(void)
+{
+    auto &snapshot = ACTIVE_SOURCE->statusSnapshot;
+    auto &cost = ACTIVE_SOURCE->statusPollCost;
+
+    snapshot.captureResolution = poll_capture_resolution(&cost.captureResolution);
+    snapshot.signal = poll_signal(snapshot.captureResolution, &cost.signal);
+    snapshot.colorSettings = poll_color_settings(&cost.colorSettings);
+    snapshot.videoSettings = poll_video_settings(&cost.videoSettings);
+    snapshot.version++;
+
+    // Polling the signal without the snapshot would also mean polling the
+    // capture resolution, which it includes.
+    cost.signal += cost.captureResolution;
+
+    return;
+}
+
+const capture_status_snapshot_s& kc_status_snapshot(void)
+{
+    return ACTIVE_SOURCE->statusSnapshot;
+}
+
+uint kc_num_saved_status_queries(void)
+{
+    return CNT_STATUS_QUERIES_SAVED;
+}
+
+// Returns how long, in milliseconds, it took from the capture hardware reporting
+// the most recent video mode until the first frame in that mode was output; or
+// -1 if no mode switch has completed yet.
+//
+int kc_mode_switch_latency(void)
+{
+    return MODE_SWITCH_LATENCY;
+}
+
+void kc_reset_saved_status_queries_count(void)
+{
+    CNT_STATUS_QUERIES_SAVED = 0;
+
+    return;
+}
+
+resolution_s capture_hardware_s::status_s::capture_resolution() const
+{
+    CNT_STATUS_QUERIES_SAVED += ACTIVE_SOURCE->statusPollCost.captureResolution;
+
+    // The color depth may change without the snapshot being refreshed.
+    resolution_s r = ACTIVE_SOURCE->statusSnapshot.captureResolution;
+    r.bpp = ACTIVE_SOURCE->outputColorDepth;
+
+    return r;
+}
+
+capture_color_settings_s capture_hardware_s::status_s::color_settings() const
+{
+    CNT_STATUS_QUERIES_SAVED += ACTIVE_SOURCE->statusPollCost.colorSettings;
+
+    return ACTIVE_SOURCE->statusSnapshot.colorSettings;
+}
+
+capture_video_settings_s capture_hardware_s::status_s::video_settings() const
+{
+    CNT_STATUS_QUERIES_SAVED += ACTIVE_SOURCE->statusPollCost.videoSettings;
+
+    return ACTIVE_SOURCE->statusSnapshot.videoSettings;
+}
+
+capture_signal_s capture_hardware_s::status_s::signal() const
+{
+    if (kc_no_signal())
+    {
+        NBENE(("Tried to query the capture signal while no signal was being received."));
+        return {0};
+    }
+
+    CNT_STATUS_QUERIES_SAVED += ACTIVE_SOURCE->statusPollCost.signal;
+
+    capture_signal_s s = ACTIVE_SOURCE->statusSnapshot.signal;
+    s.r.bpp = ACTIVE_SOURCE->outputColorDepth;
+
+    return s;
+}
+
 int capture_hardware_s::status_s::frame_rate() const
 {
     unsigned long rate = 0;
-    if (!apicall_succeeds(RGBGetFrameRate(CAPTURE_HANDLE, &rate))) return -1;
+    if (!apicall_succeeds(RGBGetFrameRate(ACTIVE_SOURCE->handle, &rate))) return -1;
     return rate;
 }
 
@@ -1179,11 +2523,13 @@ bool capture_interface_s::initialize_hardware()
 {
     INFO(("Initializing the capture hardware."));
 
-    if (INPUT_CHANNEL_IDX >= MAX_INPUT_CHANNELS)
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
     {
-        NBENE(("The requested input channel %u is out of bounds.", INPUT_CHANNEL_IDX));
-        INPUT_CHANNEL_IS_INVALID = true;
-        goto fail;
+        if (CAPTURE_SOURCES[i].inputChannelIdx >= MAX_INPUT_CHANNELS)
+        {
+            NBENE(("The requested input channel %u is out of bounds.", CAPTURE_SOURCES[i].inputChannelIdx));
+            goto fail;
+        }
     }
 
     if (!apicall_succeeds(RGBLoad(&RGBAPI_HANDLE)))
@@ -1192,19 +2538,26 @@ bool capture_interface_s::initialize_hardware()
     }
     else RGBEASY_IS_LOADED = true;
 
-    if (!apicall_succeeds(RGBOpenInput(INPUT_CHANNEL_IDX, &CAPTURE_HANDLE)) ||
-        !apicall_succeeds(RGBSetFrameDropping(CAPTURE_HANDLE, FRAME_SKIP)) ||
-        !apicall_succeeds(RGBSetDMADirect(CAPTURE_HANDLE, FALSE)) ||
-        !apicall_succeeds(RGBSetPixelFormat(CAPTURE_HANDLE, CAPTURE_PIXEL_FORMAT)) ||
-        !apicall_succeeds(RGBUseOutputBuffers(CAPTURE_HANDLE, FALSE)) ||
-        !apicall_succeeds(RGBSetFrameCapturedFn(CAPTURE_HANDLE, api_callbacks_n::frame_captured, 0)) ||
-        !apicall_succeeds(RGBSetModeChangedFn(CAPTURE_HANDLE, api_callbacks_n::video_mode_changed, 0)) ||
-        !apicall_succeeds(RGBSetInvalidSignalFn(CAPTURE_HANDLE, api_callbacks_n::invalid_signal, (ULONG_PTR)&CAPTURE_HANDLE)) ||
-        !apicall_succeeds(RGBSetErrorFn(CAPTURE_HANDLE, api_callbacks_n::error, (ULONG_PTR)&CAPTURE_HANDLE)) ||
-        !apicall_succeeds(RGBSetNoSignalFn(CAPTURE_HANDLE, api_callbacks_n::no_signal, (ULONG_PTR)&CAPTURE_HANDLE)))
-    {
-        NBENE(("Failed to initialize the capture hardware."));
-        goto fail;
+    // Open each source's input. The callbacks receive the source they're called
+    // for as their user data.
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+    {
+        capture_source_s *const source = &CAPTURE_SOURCES[i];
+
+        if (!apicall_succeeds(RGBOpenInput(source->inputChannelIdx, &source->handle)) ||
+            !apicall_succeeds(RGBSetFrameDropping(source->handle, FRAME_SKIP)) ||
+            !apicall_succeeds(RGBSetDMADirect(source->handle, FALSE)) ||
+            !apicall_succeeds(RGBSetPixelFormat(source->handle, source->pixelFormat)) ||
+            !apicall_succeeds(RGBUseOutputBuffers(source->handle, FALSE)) ||
+            !apicall_succeeds(RGBSetFrameCapturedFn(source->handle, api_callbacks_n::frame_captured, (ULONG_PTR)source)) ||
+            !apicall_succeeds(RGBSetModeChangedFn(source->handle, api_callbacks_n::video_mode_changed, (ULONG_PTR)source)) ||
+            !apicall_succeeds(RGBSetInvalidSignalFn(source->handle, api_callbacks_n::invalid_signal, (ULONG_PTR)source)) ||
+            !apicall_succeeds(RGBSetErrorFn(source->handle, api_callbacks_n::error, (ULONG_PTR)source)) ||
+            !apicall_succeeds(RGBSetNoSignalFn(source->handle, api_callbacks_n::no_signal, (ULONG_PTR)source)))
+        {
+            NBENE(("Failed to initialize the capture hardware on input channel %u.", (source->inputChannelIdx + 1)));
+            goto fail;
+        }
     }
 
     /// Temp hack. We've only allocated enough room in the input frame buffer to
@@ -1224,8 +2577,15 @@ fail:
 
 bool capture_interface_s::release_hardware()
 {
-    if (!apicall_succeeds(RGBCloseInput(CAPTURE_HANDLE)) ||
-        !apicall_succeeds(RGBFree(RGBAPI_HANDLE)))
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
+    {
+        if (!apicall_succeeds(RGBCloseInput(CAPTURE_SOURCES[i].handle)))
+        {
+            return false;
+        }
+    }
+
+    if (!apicall_succeeds(RGBFree(RGBAPI_HANDLE)))
     {
         return false;
     }
@@ -1236,16 +2596,21 @@ bool capture_interface_s::release_hardware()
 
 bool capture_interface_s::start_capture()
 {
-    INFO(("Starting capture on input channel %d.", (INPUT_CHANNEL_IDX + 1)));
-
-    if (RGBStartCapture(CAPTURE_HANDLE) != RGBERROR_NO_ERROR)
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
     {
-        NBENE(("Failed to start capture on input channel %u.", (INPUT_CHANNEL_IDX + 1)));
-        goto fail;
-    }
-    else
-    {
-        CAPTURE_IS_ACTIVE = true;
+        capture_source_s *const source = &CAPTURE_SOURCES[i];
+
+        INFO(("Starting capture on input channel %d.", (source->inputChannelIdx + 1)));
+
+        if (RGBStartCapture(source->handle) != RGBERROR_NO_ERROR)
+        {
+            NBENE(("Failed to start capture on input channel %u.", (source->inputChannelIdx + 1)));
+            goto fail;
+        }
+        else
+        {
+            source->isCapturing = true;
+        }
     }
 
     return true;
@@ -1256,30 +2621,35 @@ fail:
 
 bool capture_interface_s::stop_capture()
 {
-    INFO(("Stopping capture on input channel %d.", (INPUT_CHANNEL_IDX + 1)));
-
-    if (CAPTURE_IS_ACTIVE)
+    for (uint i = 0; i < NUM_CAPTURE_SOURCES; i++)
     {
-        if (!apicall_succeeds(RGBStopCapture(CAPTURE_HANDLE)))
+        capture_source_s *const source = &CAPTURE_SOURCES[i];
+
+        INFO(("Stopping capture on input channel %d.", (source->inputChannelIdx + 1)));
+
+        if (source->isCapturing)
+        {
+            if (!apicall_succeeds(RGBStopCapture(source->handle)))
+            {
+                NBENE(("Failed to stop capture on input channel %d.", (source->inputChannelIdx + 1)));
+                goto fail;
+            }
+        }
+        else
         {
-            NBENE(("Failed to stop capture on input channel %d.", (INPUT_CHANNEL_IDX + 1)));
+            NBENE(("Was asked to stop the capture even though it hadn't been started."));
             goto fail;
         }
-    }
-    else
-    {
-        NBENE(("Was asked to stop the capture even though it hadn't been started."));
-        goto fail;
-    }
 
-    CAPTURE_IS_ACTIVE = false;
+        source->isCapturing = false;
 
-    INFO(("Restoring default callback handlers."));
-    RGBSetFrameCapturedFn(CAPTURE_HANDLE, NULL, 0);
-    RGBSetModeChangedFn(CAPTURE_HANDLE, NULL, 0);
-    RGBSetInvalidSignalFn(CAPTURE_HANDLE, NULL, 0);
-    RGBSetNoSignalFn(CAPTURE_HANDLE, NULL, 0);
-    RGBSetErrorFn(CAPTURE_HANDLE, NULL, 0);
+        INFO(("Restoring default callback handlers."));
+        RGBSetFrameCapturedFn(source->handle, NULL, 0);
+        RGBSetModeChangedFn(source->handle, NULL, 0);
+        RGBSetInvalidSignalFn(source->handle, NULL, 0);
+        RGBSetNoSignalFn(source->handle, NULL, 0);
+        RGBSetErrorFn(source->handle, NULL, 0);
+    }
 
     return true;
 
@@ -1290,24 +2660,25 @@ bool capture_interface_s::stop_capture()
 bool capture_interface_s::pause_capture()
 {
     INFO(("Pausing the capture."));
-    return apicall_succeeds(RGBPauseCapture(CAPTURE_HANDLE));
+    return apicall_succeeds(RGBPauseCapture(ACTIVE_SOURCE->handle));
 }
 
 bool capture_interface_s::resume_capture()
 {
     INFO(("Resuming the capture."));
-    return apicall_succeeds(RGBResumeCapture(CAPTURE_HANDLE));
+    return apicall_succeeds(RGBResumeCapture(ACTIVE_SOURCE->handle));
 }
 
 bool capture_interface_s::set_capture_resolution(const resolution_s &r)
 {
-    if (!CAPTURE_IS_ACTIVE)
+    if (!ACTIVE_SOURCE->isCapturing)
     {
         INFO(("Was asked to set the capture resolution while capture was inactive. Ignoring this request."));
         return false;
     }
 
     unsigned long wd = 0, hd = 0;
+    const auto changeTimestamp = std::chrono::steady_clock::now();
 
     const auto currentInputRes = kc_hardware().status.capture_resolution();
     if (r.w == currentInputRes.w &&
@@ -1318,7 +2689,7 @@ bool capture_interface_s::set_capture_resolution(const resolution_s &r)
     }
 
     // Test whether the capture hardware can handle the given resolution.
-    if (!apicall_succeeds(RGBTestCaptureWidth(CAPTURE_HANDLE, r.w)))
+    if (!apicall_succeeds(RGBTestCaptureWidth(ACTIVE_SOURCE->handle, r.w)))
     {
         NBENE(("Failed to force the new input resolution (%u x %u). The capture hardware says the width "
                "is illegal.", r.w, r.h));
@@ -1326,9 +2697,9 @@ bool capture_interface_s::set_capture_resolution(const resolution_s &r)
     }
 
     // Set the new resolution.
-    if (!apicall_succeeds(RGBSetCaptureWidth(CAPTURE_HANDLE, (unsigned long)r.w)) ||
-        !apicall_succeeds(RGBSetCaptureHeight(CAPTURE_HANDLE, (unsigned long)r.h)) ||
-        !apicall_succeeds(RGBSetOutputSize(CAPTURE_HANDLE, (unsigned long)r.w, (unsigned long)r.h)))
+    if (!apicall_succeeds(RGBSetCaptureWidth(ACTIVE_SOURCE->handle, (unsigned long)r.w)) ||
+        !apicall_succeeds(RGBSetCaptureHeight(ACTIVE_SOURCE->handle, (unsigned long)r.h)) ||
+        !apicall_succeeds(RGBSetOutputSize(ACTIVE_SOURCE->handle, (unsigned long)r.w, (unsigned long)r.h)))
     {
         NBENE(("The capture hardware could not properly initialize the new input resolution (%u x %u).",
                 r.w, r.h));
@@ -1336,7 +2707,7 @@ bool capture_interface_s::set_capture_resolution(const resolution_s &r)
     }
 
     /// Temp hack.
-    RGBGetOutputSize(CAPTURE_HANDLE, &wd, &hd);
+    RGBGetOutputSize(ACTIVE_SOURCE->handle, &wd, &hd);
     if (wd != r.w ||
         hd != r.h)
     {
@@ -1344,7 +2715,12 @@ bool capture_interface_s::set_capture_resolution(const resolution_s &r)
         goto fail;
     }
 
-    SKIP_NEXT_NUM_FRAMES += 2;  // Avoid garbage on screen while the mode changes.
+    skip_frames_captured_since(changeTimestamp, 2);  // Avoid garbage on screen while the mode changes.
+
+    // The output size was reset to the new capture resolution above.
+    ACTIVE_SOURCE->requestedOutputSize = {0, 0, 0};
+
+    refresh_status_snapshot();
 
     return true;
 
@@ -8,6 +8,7 @@
 #define CAPTURE_H
 
 #include <vector>
+#include <chrono>
 #include "display/display.h"
 #include "common/globals.h"
 #include "scaler/scaler.h"
@@ -34,12 +35,37 @@ enum class capture_event_e
     unrecoverable_error
 };
 
+// Information about a captured frame that stays with it through processing, so
+// that e.g. recordings and latency statistics can be timed by when the frame
+// was captured rather than by when it got processed.
+struct captured_frame_meta_s
+{
+    // When the frame arrived from the capture hardware.
+    std::chrono::steady_clock::time_point timestamp;
+
+    // The running number of the frame among all of the frames sent in by its
+    // capture source, including those that had to be skipped. Wraps around
+    // harmlessly.
+    u32 sequenceNumber = 0;
+
+    // How many frames the capture source sent in between the previous frame
+    // and this one which had to be skipped.
+    u32 numSkippedBefore = 0;
+};
+
 struct captured_frame_s
 {
     resolution_s r;
 
+    // The arrangement of the color channels in the frame's pixels: 555 or 565
+    // RGB, or YUY2 (YUV 4:2:2), for 16-bit pixels; or 888 RGB for 24- and
+    // 32-bit pixels.
+    PIXELFORMAT pixelFormat = RGB_PIXELFORMAT_888;
+
     heap_bytes_s<u8> pixels;
 
+    captured_frame_meta_s meta;
+
     // Will be set to true after the frame has been processed (i.e. scaled, filtered, etc.).
     bool processed = false;
 };
@@ -89,7 +115,9 @@ struct video_mode_params_s
 // Functions that provide information about the capture hardware. These functions
 // generally poll the hardware directly, using the RGBEasy API (although whether
 // the API actually polls the hardware for each call is another matter, but you
-// get the point).
+// get the point). The exceptions are the status functions other than frame_rate(),
+// which are served from a snapshot of the hardware's status (see
+// kc_status_snapshot()) and are thus cheap to call e.g. once per frame.
 //
 // NOTE: These functions will be exposed to the entire program, so they should
 // not provide any means (e.g. calls to RGBSet*()) to alter the state of the
@@ -137,17 +165,39 @@ struct capture_hardware_s
     } status;
 };
 
+// A snapshot of the capture hardware's status, refreshed whenever the status may
+// have changed. The version number is incremented on each refresh, so callers
+// can cheaply test whether anything has changed since they last looked.
+struct capture_status_snapshot_s
+{
+    u32 version = 0;
+
+    resolution_s captureResolution = {0, 0, 0};
+    capture_signal_s signal = {};
+    capture_color_settings_s colorSettings = {};
+    capture_video_settings_s videoSettings = {};
+};
+
 // Initialize and release the unit.
 void kc_initialize_capture(void);
 void kc_release_capture(void);
 
 // Public getters.
 uint kc_num_missed_frames(void);
+uint kc_num_queued_frames(void);
+uint kc_num_saved_status_queries(void);
+int kc_mode_switch_latency(void);
+const capture_status_snapshot_s& kc_status_snapshot(void);
 uint kc_input_channel_idx(void);
+uint kc_num_capture_sources(void);
+uint kc_selected_source_idx(void);
+uint kc_active_source_idx(void);
+bool kc_is_selected_source_active(void);
 uint kc_output_color_depth(void);
 uint kc_input_color_depth(void);
 bool kc_are_frames_being_dropped(void);
 bool kc_is_capture_active(void);
+bool kc_is_replaying_capture_dump(void);
 bool kc_should_current_frame_be_skipped(void);
 bool kc_is_invalid_signal(void);
 bool kc_no_signal(void);
@@ -165,14 +215,21 @@ bool kc_set_mode_parameters_for_resolution(const resolution_s r);
 bool kc_set_frame_dropping(const u32 drop);
 bool kc_set_input_channel(const u32 channel);
 bool kc_set_input_color_depth(const u32 bpp);
+bool kc_set_capture_pixel_format(const PIXELFORMAT pixelFormat);
+void kc_set_pixel_format_negotiation_enabled(const bool enabled);
+void kc_negotiate_capture_pixel_format(void);
+void kc_set_hardware_output_size(const resolution_s &size);
 bool kc_adjust_video_vertical_offset(const int delta);
 bool kc_adjust_video_horizontal_offset(const int delta);
 void kc_set_color_settings(const capture_color_settings_s c);
 void kc_set_video_settings(const capture_video_settings_s v);
 void kc_set_mode_params(const std::vector<video_mode_params_s> &modeParams);
+void kc_prepare_mode_states(void);
 void kc_mark_current_frame_as_processed(void);
 void kc_reset_missed_frames_count(void);
+void kc_reset_saved_status_queries_count(void);
 void kc_apply_new_capture_resolution(void);
+void kc_activate_source(const uint sourceIdx);
 #if VALIDATION_RUN
     void kc_VALIDATION_set_capture_color_depth(const uint bpp);
     void kc_VALIDATION_set_capture_pixel_format(const PIXELFORMAT pf);
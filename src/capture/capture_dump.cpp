@@ -0,0 +1,267 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS capture dump
+ *
+ * Saves captured frames - as they came from the capture hardware, before any
+ * processing - into a file, and reads them back, so that a capture session can
+ * later be replayed into VCS without the capture hardware.
+ *
+ * The file consists of a file header followed by the frames. Each frame is a
+ * frame header followed by the frame's pixel data, padded so that the next frame
+ * begins at a multiple of DUMP_ALIGNMENT bytes. This keeps the pixel data aligned
+ * when the file is memory-mapped, so that replaying can read the frames directly
+ * out of the mapping.
+ *
+ */
+
+#include <QFile>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <chrono>
+#include "capture/capture_dump.h"
+#include "common/globals.h"
+
+static const char DUMP_MAGIC[8] = {'V', 'C', 'S', 'D', 'U', 'M', 'P', '\0'};
+static const u32 DUMP_VERSION = 1;
+static const uint DUMP_ALIGNMENT = 64;
+
+struct dump_file_header_s
+{
+    char magic[8];
+    u32 version;
+
+    // May be 0 if the file wasn't properly closed; the frames themselves can
+    // still be read.
+    u32 numFrames;
+
+    u8 reserved[48];
+};
+
+struct dump_frame_header_s
+{
+    // The size in bytes of this header, the frame's pixel data, and the padding
+    // that follows.
+    u32 recordSize;
+
+    u32 width;
+    u32 height;
+    u32 bpp;
+    u32 pixelFormat;
+    u32 dataSize;
+    u64 timestampNs;
+
+    u8 reserved[32];
+};
+
+static_assert((sizeof(dump_file_header_s) == DUMP_ALIGNMENT) &&
+              (sizeof(dump_frame_header_s) == DUMP_ALIGNMENT),
+              "Expected the capture dump headers to be of the dump alignment size.");
+
+// The file into which frames are being dumped.
+static QFile DUMP_FILE;
+static bool IS_DUMPING = false;
+static u32 NUM_FRAMES_DUMPED = 0;
+static std::chrono::steady_clock::time_point FIRST_DUMPED_FRAME_TIMESTAMP;
+
+// The file from which frames are being read, its memory mapping, and the byte
+// offsets in the mapping of each frame's header.
+static QFile REPLAY_FILE;
+static const u8 *REPLAY_DATA = nullptr;
+static std::vector<qint64> REPLAY_FRAME_OFFSETS;
+
+bool kdump_start_dumping(const std::string &filename)
+{
+    k_assert(!IS_DUMPING, "Was asked to start dumping frames while already doing so.");
+
+    dump_file_header_s header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DUMP_MAGIC, sizeof(DUMP_MAGIC));
+    header.version = DUMP_VERSION;
+
+    DUMP_FILE.setFileName(QString::fromStdString(filename));
+
+    if (!DUMP_FILE.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        (DUMP_FILE.write((const char*)&header, sizeof(header)) != sizeof(header)))
+    {
+        NBENE(("Failed to create the capture dump file \"%s\".", filename.c_str()));
+
+        DUMP_FILE.close();
+        return false;
+    }
+
+    INFO(("Dumping captured frames into \"%s\".", filename.c_str()));
+
+    NUM_FRAMES_DUMPED = 0;
+    IS_DUMPING = true;
+
+    return true;
+}
+
+// Appends the given frame into the dump file. Expected to be called before the
+// frame has been processed, since processing may modify the frame's pixels.
+//
+bool kdump_dump_frame(const captured_frame_s &frame)
+{
+    static const u8 padding[DUMP_ALIGNMENT] = {0};
+
+    if (!IS_DUMPING)
+    {
+        return false;
+    }
+
+    if (!NUM_FRAMES_DUMPED)
+    {
+        FIRST_DUMPED_FRAME_TIMESTAMP = frame.meta.timestamp;
+    }
+
+    const uint dataSize = (frame.r.w * frame.r.h * (frame.r.bpp / 8));
+    const uint paddingSize = ((DUMP_ALIGNMENT - (dataSize % DUMP_ALIGNMENT)) % DUMP_ALIGNMENT);
+
+    dump_frame_header_s header;
+    memset(&header, 0, sizeof(header));
+    header.recordSize = (sizeof(header) + dataSize + paddingSize);
+    header.width = frame.r.w;
+    header.height = frame.r.h;
+    header.bpp = frame.r.bpp;
+    header.pixelFormat = frame.pixelFormat;
+    header.dataSize = dataSize;
+    header.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.meta.timestamp - FIRST_DUMPED_FRAME_TIMESTAMP).count();
+
+    if ((DUMP_FILE.write((const char*)&header, sizeof(header)) != sizeof(header)) ||
+        (DUMP_FILE.write((const char*)frame.pixels.ptr(), dataSize) != dataSize) ||
+        (DUMP_FILE.write((const char*)padding, paddingSize) != paddingSize))
+    {
+        NBENE(("Failed to write a frame into the capture dump file. Stopping the dump."));
+
+        kdump_stop_dumping();
+        return false;
+    }
+
+    NUM_FRAMES_DUMPED++;
+
+    return true;
+}
+
+void kdump_stop_dumping(void)
+{
+    if (!IS_DUMPING)
+    {
+        return;
+    }
+
+    // Record the final frame count in the file header.
+    if (!DUMP_FILE.seek(offsetof(dump_file_header_s, numFrames)) ||
+        (DUMP_FILE.write((const char*)&NUM_FRAMES_DUMPED, sizeof(NUM_FRAMES_DUMPED)) != sizeof(NUM_FRAMES_DUMPED)))
+    {
+        NBENE(("Failed to finalize the capture dump file."));
+    }
+
+    DUMP_FILE.close();
+    IS_DUMPING = false;
+
+    INFO(("Dumped %u captured frame(s).", NUM_FRAMES_DUMPED));
+
+    return;
+}
+
+bool kdump_is_dumping(void)
+{
+    return IS_DUMPING;
+}
+
+// Memory-maps the given dump file for reading, and indexes its frames. Returns
+// false if the file couldn't be opened or isn't a valid dump file.
+//
+bool kdump_open_dump(const std::string &filename)
+{
+    kdump_close_dump();
+
+    qint64 offset = sizeof(dump_file_header_s);
+    qint64 fileSize = 0;
+
+    REPLAY_FILE.setFileName(QString::fromStdString(filename));
+
+    if (!REPLAY_FILE.open(QIODevice::ReadOnly) ||
+        ((fileSize = REPLAY_FILE.size()) < qint64(sizeof(dump_file_header_s))) ||
+        !(REPLAY_DATA = REPLAY_FILE.map(0, fileSize)))
+    {
+        NBENE(("Failed to open the capture dump file \"%s\".", filename.c_str()));
+        goto fail;
+    }
+
+    {
+        const dump_file_header_s *const header = (const dump_file_header_s*)REPLAY_DATA;
+
+        if (memcmp(header->magic, DUMP_MAGIC, sizeof(DUMP_MAGIC)) ||
+            (header->version != DUMP_VERSION))
+        {
+            NBENE(("The file \"%s\" isn't a capture dump file of a supported version.", filename.c_str()));
+            goto fail;
+        }
+    }
+
+    // Index the frames, ignoring a possible truncated frame at the end.
+    while ((offset + qint64(sizeof(dump_frame_header_s))) <= fileSize)
+    {
+        const dump_frame_header_s *const header = (const dump_frame_header_s*)(REPLAY_DATA + offset);
+
+        if ((header->recordSize < (sizeof(dump_frame_header_s) + header->dataSize)) ||
+            (header->dataSize != (header->width * header->height * (header->bpp / 8))) ||
+            ((offset + qint64(sizeof(dump_frame_header_s) + header->dataSize)) > fileSize))
+        {
+            break;
+        }
+
+        REPLAY_FRAME_OFFSETS.push_back(offset);
+        offset += header->recordSize;
+    }
+
+    if (REPLAY_FRAME_OFFSETS.empty())
+    {
+        NBENE(("The capture dump file \"%s\" contains no frames.", filename.c_str()));
+        goto fail;
+    }
+
+    INFO(("Opened capture dump file \"%s\" with %u frame(s).", filename.c_str(), REPLAY_FRAME_OFFSETS.size()));
+
+    return true;
+
+    fail:
+    kdump_close_dump();
+    return false;
+}
+
+void kdump_close_dump(void)
+{
+    if (REPLAY_DATA)
+    {
+        REPLAY_FILE.unmap((uchar*)REPLAY_DATA);
+        REPLAY_DATA = nullptr;
+    }
+
+    REPLAY_FILE.close();
+    REPLAY_FRAME_OFFSETS.clear();
+
+    return;
+}
+
+uint kdump_num_frames(void)
+{
+    return REPLAY_FRAME_OFFSETS.size();
+}
+
+dump_frame_s kdump_frame(const uint idx)
+{
+    k_assert((idx < REPLAY_FRAME_OFFSETS.size()), "Accessing the capture dump out of bounds.");
+
+    const dump_frame_header_s *const header = (const dump_frame_header_s*)(REPLAY_DATA + REPLAY_FRAME_OFFSETS[idx]);
+
+    dump_frame_s frame;
+    frame.r = {header->width, header->height, header->bpp};
+    frame.pixelFormat = (PIXELFORMAT)header->pixelFormat;
+    frame.timestampNs = header->timestampNs;
+    frame.pixels = ((const u8*)header + sizeof(dump_frame_header_s));
+
+    return frame;
+}
@@ -0,0 +1,41 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef CAPTURE_DUMP_H
+#define CAPTURE_DUMP_H
+
+#include <string>
+#include "capture/capture.h"
+
+// A frame as stored in a capture dump file.
+struct dump_frame_s
+{
+    resolution_s r;
+
+    PIXELFORMAT pixelFormat;
+
+    // When the frame was captured, in nanoseconds since the first frame in the
+    // dump was captured.
+    u64 timestampNs;
+
+    // Points into the dump file's memory mapping; so is valid only while the
+    // file remains open for reading.
+    const u8 *pixels;
+};
+
+// Writing captured frames into a dump file.
+bool kdump_start_dumping(const std::string &filename);
+bool kdump_dump_frame(const captured_frame_s &frame);
+void kdump_stop_dumping(void);
+bool kdump_is_dumping(void);
+
+// Reading frames back from a dump file.
+bool kdump_open_dump(const std::string &filename);
+void kdump_close_dump(void);
+uint kdump_num_frames(void);
+dump_frame_s kdump_frame(const uint idx);
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS duplicate frame detection
+ *
+ * Tells whether a captured frame repeats the one most recently let through for
+ * processing, so that VCS can skip processing it and reuse the earlier output
+ * instead. Retro sources often repeat frames; e.g. a game running at 15 FPS on
+ * a 70 Hz signal sends in each of its images about five times over.
+ *
+ * Frames are compared in one of two ways. In exact mode, meant for digital
+ * inputs, where a repeated frame is identical to the original, each row of the
+ * frame is hashed, and the hashes compared with those of the original. In
+ * threshold mode, meant for analog inputs, whose repeated frames differ from
+ * the original by noise, every other row is compared against the original's
+ * pixel by pixel, allowing each color channel to differ by up to the threshold.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#if __SSE2__
+    #include <emmintrin.h>
+#endif
+#include "common/command_line.h"
+#include "capture/frame_dedup.h"
+#include "common/globals.h"
+
+// How much each color channel of a frame's pixels may differ from those of the
+// original for the frame to count as a repeat of it; or 0 for the frames having
+// to be identical (exact mode), or -1 if repeats aren't to be detected at all.
+static int THRESHOLD = -1;
+
+// In threshold mode, which rows of the frame are compared: every nth.
+static const uint SAMPLED_ROW_STRIDE = 2;
+
+// A frame arriving this long after the original isn't counted as a repeat of
+// it even if it is one. Changes to the processing settings (e.g. to filter
+// parameters) don't go through this unit, so this bounds how long they could
+// remain unapplied to a static image.
+static const std::chrono::milliseconds MAX_REPEAT_INTERVAL(250);
+
+// The frame most recently let through for processing: whether there is one,
+// its resolution and pixel format, and when it was captured.
+static bool HAS_ORIGINAL = false;
+static resolution_s ORIGINAL_RES = {0, 0, 0};
+static PIXELFORMAT ORIGINAL_PIXEL_FORMAT = RGB_PIXELFORMAT_888;
+static std::chrono::steady_clock::time_point ORIGINAL_TIMESTAMP;
+
+// In exact mode, the hashes of each of the original frame's rows.
+static std::vector<u32> ORIGINAL_ROW_HASHES;
+
+// In threshold mode, the original frame's compared rows, back to back.
+static heap_bytes_s<u8> ORIGINAL_SAMPLED_ROWS;
+
+void kdedup_initialize(void)
+{
+    THRESHOLD = kcom_duplicate_frame_threshold();
+
+    if (THRESHOLD == 0)
+    {
+        INFO(("Eliding repeated frames that are identical to the original."));
+
+        ORIGINAL_ROW_HASHES.resize(MAX_OUTPUT_HEIGHT);
+    }
+    else if (THRESHOLD > 0)
+    {
+        INFO(("Eliding repeated frames whose color channels differ by at most %d from the original.", THRESHOLD));
+
+        ORIGINAL_SAMPLED_ROWS.alloc((MAX_FRAME_SIZE / SAMPLED_ROW_STRIDE), "Duplicate frame detection buffer");
+    }
+
+    kdedup_reset();
+
+    return;
+}
+
+void kdedup_release(void)
+{
+    ORIGINAL_SAMPLED_ROWS.release_memory();
+    ORIGINAL_ROW_HASHES.clear();
+
+    return;
+}
+
+bool kdedup_is_enabled(void)
+{
+    return (THRESHOLD >= 0);
+}
+
+// Forget the original frame, e.g. because the output it produced has since
+// been replaced, so that the next frame won't count as a repeat.
+//
+void kdedup_reset(void)
+{
+    HAS_ORIGINAL = false;
+
+    return;
+}
+
+// Returns a hash of the given row of pixels. Any change to a single 32-bit word
+// of the row is guaranteed to change the hash. The row is hashed in four
+// interleaved lanes, so that the multiplications needn't wait on each other.
+//
+static u32 row_hash(const u8 *const row, const uint numBytes)
+{
+    static const u32 prime = 16777619;
+    u32 lanes[4] = {2166136261u, 2166136261u, 2166136261u, 2166136261u};
+    u32 words[4];
+    uint i = 0;
+
+    for (; (i + sizeof(words)) <= numBytes; i += sizeof(words))
+    {
+        memcpy(words, (row + i), sizeof(words));
+
+        lanes[0] = ((lanes[0] ^ words[0]) * prime);
+        lanes[1] = ((lanes[1] ^ words[1]) * prime);
+        lanes[2] = ((lanes[2] ^ words[2]) * prime);
+        lanes[3] = ((lanes[3] ^ words[3]) * prime);
+    }
+
+    for (; i < numBytes; i++)
+    {
+        lanes[0] = ((lanes[0] ^ row[i]) * prime);
+    }
+
+    return (((((lanes[0] * prime) ^ lanes[1]) * prime) ^ lanes[2]) * prime) ^ lanes[3];
+}
+
+// Returns true if any byte of the given rows differs between them by more than
+// the given threshold.
+//
+static bool rows_differ(const u8 *const a, const u8 *const b, const uint numBytes, const u8 threshold)
+{
+    uint i = 0;
+
+#if __SSE2__
+    {
+        const __m128i thresholds = _mm_set1_epi8(char(threshold));
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; (i + 16) <= numBytes; i += 16)
+        {
+            const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+            const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+            const __m128i difference = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            const __m128i excess = _mm_subs_epu8(difference, thresholds);
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(excess, zero)) != 0xffff)
+            {
+                return true;
+            }
+        }
+    }
+#endif
+
+    for (; i < numBytes; i++)
+    {
+        if (std::abs(int(a[i]) - int(b[i])) > threshold)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns true if the given frame is a repeat of the original frame, i.e. of
+// the one most recently let through for processing. Otherwise, the frame is
+// expected to be processed, and becomes the new original.
+//
+bool kdedup_is_repeat_of_processed_frame(const captured_frame_s &frame)
+{
+    const uint rowSize = (frame.r.w * (frame.r.bpp / 8));
+    const u8 *const pixels = frame.pixels.ptr();
+    bool isRepeat = false;
+
+    if (THRESHOLD < 0)
+    {
+        return false;
+    }
+
+    isRepeat = (HAS_ORIGINAL &&
+                (frame.r.w == ORIGINAL_RES.w) &&
+                (frame.r.h == ORIGINAL_RES.h) &&
+                (frame.r.bpp == ORIGINAL_RES.bpp) &&
+                (frame.pixelFormat == ORIGINAL_PIXEL_FORMAT) &&
+                ((frame.meta.timestamp - ORIGINAL_TIMESTAMP) < MAX_REPEAT_INTERVAL));
+
+    if (THRESHOLD == 0)
+    {
+        if (frame.r.h > ORIGINAL_ROW_HASHES.size())
+        {
+            goto not_a_repeat;
+        }
+
+        // Every row's hash is needed either way: for the comparison if the
+        // frame is a repeat, and as the new original's if it isn't.
+        for (uint y = 0; y < frame.r.h; y++)
+        {
+            const u32 hash = row_hash((pixels + (y * rowSize)), rowSize);
+
+            if (hash != ORIGINAL_ROW_HASHES[y])
+            {
+                ORIGINAL_ROW_HASHES[y] = hash;
+                isRepeat = false;
+            }
+        }
+    }
+    else
+    {
+        // The channels of 555 and 565 pixels don't fall on byte boundaries,
+        // so such pixels are compared exactly.
+        const u8 threshold = (((frame.r.bpp == 16) && (frame.pixelFormat != RGB_PIXELFORMAT_YUY2))? 0 : std::min(255, THRESHOLD));
+        const uint numSampledRows = ((frame.r.h + SAMPLED_ROW_STRIDE - 1) / SAMPLED_ROW_STRIDE);
+
+        if ((numSampledRows * rowSize) > ORIGINAL_SAMPLED_ROWS.size())
+        {
+            goto not_a_repeat;
+        }
+
+        for (uint i = 0; (i < numSampledRows) && isRepeat; i++)
+        {
+            isRepeat = !rows_differ((pixels + (i * SAMPLED_ROW_STRIDE * rowSize)),
+                                    (ORIGINAL_SAMPLED_ROWS.ptr() + (i * rowSize)),
+                                    rowSize, threshold);
+        }
+
+        // A repeat keeps being compared against the original, rather than
+        // becoming the original itself, so that gradual changes, each within
+        // the threshold, don't go unnoticed.
+        if (!isRepeat)
+        {
+            for (uint i = 0; i < numSampledRows; i++)
+            {
+                memcpy((ORIGINAL_SAMPLED_ROWS.ptr() + (i * rowSize)),
+                       (pixels + (i * SAMPLED_ROW_STRIDE * rowSize)),
+                       rowSize);
+            }
+        }
+    }
+
+    if (isRepeat)
+    {
+        return true;
+    }
+
+    HAS_ORIGINAL = true;
+    ORIGINAL_RES = frame.r;
+    ORIGINAL_PIXEL_FORMAT = frame.pixelFormat;
+    ORIGINAL_TIMESTAMP = frame.meta.timestamp;
+
+    return false;
+
+    not_a_repeat:
+    HAS_ORIGINAL = false;
+    return false;
+}
@@ -0,0 +1,22 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef FRAME_DEDUP_H
+#define FRAME_DEDUP_H
+
+#include "capture/capture.h"
+
+void kdedup_initialize(void);
+
+void kdedup_release(void);
+
+bool kdedup_is_enabled(void);
+
+bool kdedup_is_repeat_of_processed_frame(const captured_frame_s &frame);
+
+void kdedup_reset(void);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS capture frame ring
+ *
+ * A single-producer, single-consumer ring of preallocated capture frames.
+ *
+ */
+
+#include "capture/frame_ring.h"
+#include "common/globals.h"
+
+void frame_ring_s::allocate(const uint numSlots, const uint slotSize)
+{
+    k_assert((numSlots > 0 && numSlots <= MAX_FRAME_RING_SLOTS),
+             "Was asked to allocate a frame ring with an unsupported number of slots.");
+
+    this->numSlots = numSlots;
+
+    for (uint i = 0; i < this->numSlots; i++)
+    {
+        frame_slot_s &slot = this->slots[i];
+
+        slot.storage.alloc((slotSize + FRAME_RING_SLOT_ALIGNMENT), "Capture frame ring slot");
+
+        const uint misalignment = (uintptr_t(slot.storage.ptr()) % FRAME_RING_SLOT_ALIGNMENT);
+        const uint alignOffset = (misalignment? (FRAME_RING_SLOT_ALIGNMENT - misalignment) : 0);
+        slot.frame.pixels.point_to((slot.storage.ptr() + alignOffset), slotSize);
+
+        this->slots[i].frame.r = {0, 0, 0};
+        this->slots[i].state = frame_slot_state_e::empty;
+    }
+
+    this->writePos = 0;
+    this->readPos = 0;
+
+    return;
+}
+
+void frame_ring_s::release(void)
+{
+    for (uint i = 0; i < this->numSlots; i++)
+    {
+        this->slots[i].frame.pixels.release_memory();
+        this->slots[i].storage.release_memory();
+    }
+
+    this->numSlots = 0;
+    this->writePos = 0;
+    this->readPos = 0;
+
+    return;
+}
+
+uint frame_ring_s::next_position(const uint pos) const
+{
+    return ((pos + 1) % (this->numSlots * 2));
+}
+
+frame_slot_s& frame_ring_s::slot_at(const uint pos)
+{
+    return this->slots[pos % this->numSlots];
+}
+
+captured_frame_s& frame_ring_s::frame_in_slot(const uint slotIdx)
+{
+    k_assert((slotIdx < this->numSlots), "Accessing the frame ring out of bounds.");
+
+    return this->slots[slotIdx].frame;
+}
+
+const captured_frame_s* frame_ring_s::next_write_frame(void)
+{
+    if (!this->numSlots ||
+        this->is_full())
+    {
+        return nullptr;
+    }
+
+    return &this->slot_at(this->writePos.load(std::memory_order_relaxed)).frame;
+}
+
+uint frame_ring_s::num_slots(void) const
+{
+    return this->numSlots;
+}
+
+uint frame_ring_s::num_occupied(void) const
+{
+    if (!this->numSlots)
+    {
+        return 0;
+    }
+
+    const uint w = this->writePos.load(std::memory_order_acquire);
+    const uint r = this->readPos.load(std::memory_order_acquire);
+
+    return (((w + (this->numSlots * 2)) - r) % (this->numSlots * 2));
+}
+
+bool frame_ring_s::is_empty(void) const
+{
+    return (this->num_occupied() == 0);
+}
+
+bool frame_ring_s::is_full(void) const
+{
+    return (this->numSlots && (this->num_occupied() >= this->numSlots));
+}
+
+captured_frame_s* frame_ring_s::begin_write(void)
+{
+    if (!this->numSlots ||
+        this->is_full())
+    {
+        return nullptr;
+    }
+
+    frame_slot_s &slot = this->slot_at(this->writePos.load(std::memory_order_relaxed));
+
+    k_assert_optional((slot.state == frame_slot_state_e::empty),
+                      "Expected the next free frame ring slot to be empty.");
+
+    slot.state = frame_slot_state_e::writing;
+
+    return &slot.frame;
+}
+
+void frame_ring_s::end_write(void)
+{
+    const uint pos = this->writePos.load(std::memory_order_relaxed);
+    frame_slot_s &slot = this->slot_at(pos);
+
+    k_assert_optional((slot.state == frame_slot_state_e::writing),
+                      "Was asked to commit a frame ring slot that wasn't being written to.");
+
+    slot.frame.processed = false;
+    slot.state = frame_slot_state_e::ready;
+
+    // Publish the slot to the consumer only after its contents are in place.
+    this->writePos.store(this->next_position(pos), std::memory_order_release);
+
+    return;
+}
+
+void frame_ring_s::cancel_write(void)
+{
+    frame_slot_s &slot = this->slot_at(this->writePos.load(std::memory_order_relaxed));
+
+    slot.state = frame_slot_state_e::empty;
+
+    return;
+}
+
+captured_frame_s* frame_ring_s::begin_read(void)
+{
+    if (!this->numSlots ||
+        this->is_empty())
+    {
+        return nullptr;
+    }
+
+    frame_slot_s &slot = this->slot_at(this->readPos.load(std::memory_order_relaxed));
+
+    k_assert_optional((slot.state == frame_slot_state_e::ready ||
+                       slot.state == frame_slot_state_e::reading),
+                      "Expected the oldest occupied frame ring slot to hold a frame.");
+
+    slot.state = frame_slot_state_e::reading;
+
+    return &slot.frame;
+}
+
+captured_frame_s* frame_ring_s::end_read(void)
+{
+    if (this->is_empty())
+    {
+        return nullptr;
+    }
+
+    const uint pos = this->readPos.load(std::memory_order_relaxed);
+    frame_slot_s &slot = this->slot_at(pos);
+
+    slot.frame.processed = true;
+    slot.state = frame_slot_state_e::empty;
+
+    // Hand the slot back to the producer only once we're done with its contents.
+    this->readPos.store(this->next_position(pos), std::memory_order_release);
+
+    return &slot.frame;
+}
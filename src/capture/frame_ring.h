@@ -0,0 +1,102 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+#include "capture/capture.h"
+
+// The largest number of slots a frame ring can be asked to hold.
+const uint MAX_FRAME_RING_SLOTS = 16;
+
+// The number of slots a frame ring holds unless otherwise requested.
+const uint DEFAULT_FRAME_RING_SLOTS = 4;
+
+// The byte alignment of each slot's pixel buffer. The capture hardware can be
+// handed these buffers to write into directly, and the alignment also keeps
+// the buffers friendly to vectorized code.
+const uint FRAME_RING_SLOT_ALIGNMENT = 64;
+
+enum class frame_slot_state_e
+{
+    empty,      // Free for the capture hardware to write a new frame into.
+    writing,    // Being filled by the capture hardware.
+    ready,      // Holds a captured frame that's waiting to be processed.
+    reading     // Being processed (scaled, filtered, etc.) by VCS.
+};
+
+struct frame_slot_s
+{
+    // The frame's pixel buffer points into this storage, at an aligned offset.
+    heap_bytes_s<u8> storage;
+
+    captured_frame_s frame;
+
+    std::atomic<frame_slot_state_e> state;
+};
+
+// A ring of preallocated frame slots, written into by a single producer (the
+// capture hardware's callback thread) and drained by a single consumer (VCS's
+// processing thread). Lets the capture hardware keep queuing frames while an
+// earlier one is still being processed, so that a brief spike in processing
+// time doesn't immediately lead to frames being dropped.
+//
+// Neither side takes a lock; the only shared state are the read and write
+// positions, each of which is modified by only one of the two sides.
+struct frame_ring_s
+{
+    void allocate(const uint numSlots, const uint slotSize);
+
+    void release(void);
+
+    // Producer. Returns the frame of the next free slot, or nullptr if all of
+    // the ring's slots are occupied. A frame obtained this way must be handed
+    // back with either end_write() or cancel_write() before the next call.
+    captured_frame_s* begin_write(void);
+    void end_write(void);
+    void cancel_write(void);
+
+    // Consumer. Returns the oldest frame waiting to be processed, or nullptr
+    // if there are none. Repeated calls return the same frame until it's been
+    // handed back with end_read(), which returns the frame whose slot it freed
+    // (or nullptr if there was none).
+    captured_frame_s* begin_read(void);
+    captured_frame_s* end_read(void);
+
+    // Returns the frame of the slot at the given index (0...num_slots()-1),
+    // regardless of the slot's state. Slot indices are in the order in which
+    // the producer fills the slots.
+    captured_frame_s& frame_in_slot(const uint slotIdx);
+
+    // Returns the frame that the next call to begin_write() would return,
+    // or nullptr if the ring is full.
+    const captured_frame_s* next_write_frame(void);
+
+    // Returns the number of slots that hold frames not yet handed back by the
+    // consumer.
+    uint num_occupied(void) const;
+
+    uint num_slots(void) const;
+
+    bool is_empty(void) const;
+
+    bool is_full(void) const;
+
+private:
+    uint next_position(const uint pos) const;
+    frame_slot_s& slot_at(const uint pos);
+
+    frame_slot_s slots[MAX_FRAME_RING_SLOTS];
+    uint numSlots = 0;
+
+    // Positions run from 0 to (2 * numSlots - 1), so that a full ring can be
+    // told apart from an empty one without giving up one of the slots.
+    std::atomic<uint> writePos{0};
+    std::atomic<uint> readPos{0};
+};
+
+#endif
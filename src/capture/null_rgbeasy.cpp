@@ -0,0 +1,164 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ * Mock implementations of the parts of the RGBEASY API that the null wrappers
+ * can't represent as no-ops.
+ *
+ */
+
+#if !USE_RGBEASY_API
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <map>
+#include "capture/null_rgbeasy.h"
+
+struct output_buffers_s
+{
+    // Set to true while the mock driver is expected to capture into the buffers
+    // chained to it, rather than into its own.
+    bool isEnabled = false;
+
+    // The buffers that have been chained to the mock driver and not yet handed
+    // back, oldest first.
+    std::deque<void*> chained;
+};
+
+// The output buffers of each capture handle.
+static std::map<HRGB, output_buffers_s> OUTPUT_BUFFERS;
+
+// Buffers may be chained from one thread and handed back on another, as with
+// the real driver.
+static std::mutex OUTPUT_BUFFERS_MUTEX;
+
+// The output size of each capture handle; or 0 x 0 if none has been set. The
+// size is set on VCS's main thread and read on the capture thread.
+static std::map<HRGB, resolution_s> OUTPUT_SIZES;
+static std::mutex OUTPUT_SIZES_MUTEX;
+
+long RGBUseOutputBuffers(HRGB handle, long useOutputBuffers)
+{
+    NULL_RGBEASY_FUNCTION("RGBUseOutputBuffers");
+
+    std::lock_guard<std::mutex> lock(OUTPUT_BUFFERS_MUTEX);
+    output_buffers_s &buffers = OUTPUT_BUFFERS[handle];
+
+    buffers.isEnabled = useOutputBuffers;
+
+    // Disabling output buffers releases the driver's hold on them.
+    if (!buffers.isEnabled)
+    {
+        buffers.chained.clear();
+    }
+
+    return RGBERROR_NO_ERROR;
+}
+
+long RGBChainOutputBuffer(HRGB handle, void*, void *buffer)
+{
+    std::lock_guard<std::mutex> lock(OUTPUT_BUFFERS_MUTEX);
+    output_buffers_s &buffers = OUTPUT_BUFFERS[handle];
+
+    if (!buffers.isEnabled ||
+        (buffer == nullptr))
+    {
+        return RGBERROR_BUFFER_NOT_VALID;
+    }
+
+    buffers.chained.push_back(buffer);
+
+    return RGBERROR_NO_ERROR;
+}
+
+void* NULL_RGBEASY_next_output_buffer(HRGB handle)
+{
+    std::lock_guard<std::mutex> lock(OUTPUT_BUFFERS_MUTEX);
+    output_buffers_s &buffers = OUTPUT_BUFFERS[handle];
+
+    if (!buffers.isEnabled ||
+        buffers.chained.empty())
+    {
+        return nullptr;
+    }
+
+    void *const buffer = buffers.chained.front();
+    buffers.chained.pop_front();
+
+    return buffer;
+}
+
+long RGBSetOutputSize(HRGB handle, unsigned long width, unsigned long height)
+{
+    NULL_RGBEASY_FUNCTION("RGBSetOutputSize");
+
+    std::lock_guard<std::mutex> lock(OUTPUT_SIZES_MUTEX);
+
+    OUTPUT_SIZES[handle] = {(((width + 3) / 4) * 4), height, 0};
+
+    return RGBERROR_NO_ERROR;
+}
+
+long RGBGetOutputSize(HRGB handle, unsigned long *width, unsigned long *height)
+{
+    std::lock_guard<std::mutex> lock(OUTPUT_SIZES_MUTEX);
+    const resolution_s &size = OUTPUT_SIZES[handle];
+
+    *width = size.w;
+    *height = size.h;
+
+    return RGBERROR_NO_ERROR;
+}
+
+void NULL_RGBEASY_scale_to_output_size(HRGB handle, u8 *const pixels, resolution_s *const r,
+                                       const PIXELFORMAT pixelFormat)
+{
+    resolution_s size;
+    {
+        std::lock_guard<std::mutex> lock(OUTPUT_SIZES_MUTEX);
+        size = OUTPUT_SIZES[handle];
+    }
+
+    // The mock scaler only downscales.
+    size.w = std::min(size.w, r->w);
+    size.h = std::min(size.h, r->h);
+
+    if (!size.w ||
+        !size.h ||
+        ((size.w == r->w) && (size.h == r->h)))
+    {
+        return;
+    }
+
+    // In YUY2, horizontally adjacent pairs of pixels share their chroma, so
+    // are sampled as one.
+    const uint pixelsPerSample = ((pixelFormat == RGB_PIXELFORMAT_YUY2)? 2 : 1);
+    const uint sampleSize = (pixelsPerSample * (r->bpp / 8));
+    const uint srcSamplesPerRow = (r->w / pixelsPerSample);
+    const uint dstSamplesPerRow = (size.w / pixelsPerSample);
+
+    // Each destination sample lies at or before its source sample, so the
+    // frame can be scaled in place front to back.
+    for (uint y = 0; y < size.h; y++)
+    {
+        const uint srcY = ((y * r->h) / size.h);
+
+        for (uint x = 0; x < dstSamplesPerRow; x++)
+        {
+            const uint srcX = ((x * srcSamplesPerRow) / dstSamplesPerRow);
+
+            memmove((pixels + (((y * dstSamplesPerRow) + x) * sampleSize)),
+                    (pixels + (((srcY * srcSamplesPerRow) + srcX) * sampleSize)),
+                    sampleSize);
+        }
+    }
+
+    r->w = (dstSamplesPerRow * pixelsPerSample);
+    r->h = size.h;
+
+    return;
+}
+
+#endif
@@ -24,7 +24,6 @@
 
 // Functions.
 #define RGBSetErrorFn(...)                  NULL_RGBEASY_FUNCTION("RGBSetErrorFn")
-#define RGBGetOutputSize(...)               NULL_RGBEASY_FUNCTION("RGBGetOutputSize")
 #define RGBSetFrameCapturedFn(...)          NULL_RGBEASY_FUNCTION("RGBSetFrameCapturedFn")
 #define RGBSetInvalidSignalFn(...)          NULL_RGBEASY_FUNCTION("RGBSetInvalidSignalFn")
 #define RGBSetModeChangedFn(...)            NULL_RGBEASY_FUNCTION("RGBSetModeChangedFn")
@@ -45,7 +44,6 @@
 #define RGBTestCaptureWidth(...)            NULL_RGBEASY_FUNCTION("RGBTestCaptureWidth")
 #define RGBSetCaptureWidth(...)             NULL_RGBEASY_FUNCTION("RGBSetCaptureWidth")
 #define RGBSetCaptureHeight(...)            NULL_RGBEASY_FUNCTION("RGBSetCaptureHeight")
-#define RGBSetOutputSize(...)               NULL_RGBEASY_FUNCTION("RGBSetOutputSize")
 #define RGBSetPhase(...)                    NULL_RGBEASY_FUNCTION("RGBSetPhase")
 #define RGBSetBlackLevel(...)               NULL_RGBEASY_FUNCTION("RGBSetBlackLevel")
 #define RGBSetHorScale(...)                 NULL_RGBEASY_FUNCTION("RGBSetHorScale")
@@ -65,7 +63,6 @@
 #define RGBOpenInput(...)                   NULL_RGBEASY_FUNCTION("RGBOpenInput")
 #define RGBSetDMADirect(...)                NULL_RGBEASY_FUNCTION("RGBSetDMADirect")
 #define RGBSetPixelFormat(...)              NULL_RGBEASY_FUNCTION("RGBSetPixelFormat")
-#define RGBUseOutputBuffers(...)            NULL_RGBEASY_FUNCTION("RGBUseOutputBuffers")
 #define RGBGetBrightness(...)               NULL_RGBEASY_FUNCTION("RGBGetBrightness")
 #define RGBGetContrast(...)                 NULL_RGBEASY_FUNCTION("RGBGetContrast")
 #define RGBGetColourBalance(...)            NULL_RGBEASY_FUNCTION("RGBGetColourBalance")
@@ -112,6 +109,7 @@
 
 // Constants.
 #define RGBERROR_NO_ERROR                   0
+#define RGBERROR_BUFFER_NOT_VALID           1
 #define CAPTURECARD_DGC103                  0
 #define CAPTURECARD_DGC133                  1
 
@@ -218,5 +216,37 @@ typedef struct tagRGBDevInfo
 #define RGBNOSIGNALFN                       NULL_RGBEASY_POINTER
 #define HRGBDLL                             NULL_RGBEASY_POINTER
 #define HRGB                                NULL_RGBEASY_POINTER
+#ifndef FALSE
+    #define FALSE                           0
+#endif
+#ifndef TRUE
+    #define TRUE                            1
+#endif
+
+// A mock of the API's output buffer handoff, so that capturing directly into
+// VCS's own buffers can be exercised without capture hardware. Buffers given
+// to the mock driver with RGBChainOutputBuffer() are queued in the order they
+// were given, and NULL_RGBEASY_next_output_buffer() hands back the oldest of
+// them - as the real driver would when it's filled a buffer with a frame and
+// passes it to the frame-captured callback. The bitmap info is ignored. Each
+// capture handle has buffers of its own; any distinct non-null value will do as
+// a handle.
+long RGBUseOutputBuffers(HRGB handle, long useOutputBuffers);
+long RGBChainOutputBuffer(HRGB handle, void *bitmapInfo, void *buffer);
+void* NULL_RGBEASY_next_output_buffer(HRGB handle);
+
+// A mock of the capture hardware's scaler, so that having the hardware scale
+// frames can be exercised without capture hardware. The mock driver keeps the
+// output size set for each capture handle with RGBSetOutputSize(), rounding its
+// width up to a multiple of 4 - as real hardware may only scale to sizes near
+// the one asked for. NULL_RGBEASY_scale_to_output_size() then scales, in place,
+// a frame of the given resolution down to the handle's output size (nearest-
+// neighbor), as the real driver would before passing the frame to the frame-
+// captured callback. Until an output size has been set, frames are left as
+// they are.
+long RGBSetOutputSize(HRGB handle, unsigned long width, unsigned long height);
+long RGBGetOutputSize(HRGB handle, unsigned long *width, unsigned long *height);
+void NULL_RGBEASY_scale_to_output_size(HRGB handle, u8 *const pixels, resolution_s *const r,
+                                       const PIXELFORMAT pixelFormat);
 
 #endif
@@ -0,0 +1,480 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS test pattern generator
+ *
+ * Draws synthetic frames in any of the pixel formats the capture hardware can
+ * send, for feeding through VCS in place of captured frames.
+ *
+ * Since the patterns are meant for load-testing the rest of VCS at high
+ * resolutions and frame rates, they're drawn so as to touch each pixel
+ * individually as little as possible: a pattern's scanline is assembled from
+ * a short stretch of pixels that repeats across it, and scanlines that repeat
+ * down the frame are copied rather than redrawn. The copying is done with
+ * memcpy(), which the C library vectorizes. The noise pattern, which has
+ * nothing to repeat, is generated four 32-bit words at a time, using SSE2
+ * where available.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#if __SSE2__
+    #include <emmintrin.h>
+#endif
+#include "capture/test_pattern.h"
+#include "common/globals.h"
+
+// The number of character cells on the text-mode screen, and the number of
+// pixels in each cell's glyph.
+static const uint TEXT_MODE_COLUMNS = 80;
+static const uint TEXT_MODE_ROWS = 25;
+static const uint GLYPH_WIDTH = 8;
+static const uint GLYPH_HEIGHT = 16;
+
+// For the torn frame and duplicate frames patterns, how much the gradient
+// moves between successive images. Large enough that anti-tearing can tell the
+// images apart.
+static const uint IMAGE_OFFSET_STEP = 16;
+
+bool ktp_pattern_type_for_name(const std::string &name, test_pattern_e *const type)
+{
+    if      (name == "gradient")  *type = test_pattern_e::gradient;
+    else if (name == "bars")      *type = test_pattern_e::smpte_bars;
+    else if (name == "text")      *type = test_pattern_e::text_mode;
+    else if (name == "tear")      *type = test_pattern_e::torn_frame;
+    else if (name == "duplicate") *type = test_pattern_e::duplicate_frames;
+    else if (name == "noise")     *type = test_pattern_e::noise;
+    else return false;
+
+    return true;
+}
+
+bool ktp_is_valid_pattern(const test_pattern_s &pattern)
+{
+    if (pattern.r.w < 1 || pattern.r.w > MAX_OUTPUT_WIDTH ||
+        pattern.r.h < 1 || pattern.r.h > MAX_OUTPUT_HEIGHT)
+    {
+        return false;
+    }
+
+    switch (pattern.r.bpp)
+    {
+        case 16:
+        {
+            if (pattern.pixelFormat != RGB_PIXELFORMAT_555 &&
+                pattern.pixelFormat != RGB_PIXELFORMAT_565 &&
+                pattern.pixelFormat != RGB_PIXELFORMAT_YUY2)
+            {
+                return false;
+            }
+
+            // YUY2 pixels come in pairs that share their chroma.
+            if ((pattern.pixelFormat == RGB_PIXELFORMAT_YUY2) &&
+                (pattern.r.w % 2))
+            {
+                return false;
+            }
+
+            break;
+        }
+        case 24:
+        case 32:
+        {
+            if (pattern.pixelFormat != RGB_PIXELFORMAT_888)
+            {
+                return false;
+            }
+
+            break;
+        }
+        default: return false;
+    }
+
+    if ((pattern.type == test_pattern_e::torn_frame) &&
+        (pattern.tearRow >= pattern.r.h))
+    {
+        return false;
+    }
+
+    if ((pattern.type == test_pattern_e::duplicate_frames) &&
+        (pattern.numRepeats < 1))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// Writes the given color into the given row as the xth pixel, in the pattern's
+// format. In YUY2, each pixel stores its luma and half of the chroma that it
+// shares with its pair: U for even-numbered pixels and V for odd-numbered ones.
+//
+static void pack_pixel(u8 *const row, const uint x, const u8 red, const u8 green, const u8 blue,
+                       const test_pattern_s &pattern)
+{
+    u8 *const dst = (row + (x * (pattern.r.bpp / 8)));
+
+    switch (pattern.r.bpp)
+    {
+        case 16:
+        {
+            if (pattern.pixelFormat == RGB_PIXELFORMAT_YUY2)
+            {
+                // BT.601, with studio-range levels.
+                dst[0] = (((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16);
+                dst[1] = ((x % 2)? (((112 * red - 94 * green - 18 * blue + 128) >> 8) + 128)
+                                 : (((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128));
+                break;
+            }
+
+            const u16 pixel = (pattern.pixelFormat == RGB_PIXELFORMAT_565)? (((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3))
+                                                                          : (((red >> 3) << 10) | ((green >> 3) << 5) | (blue >> 3));
+            memcpy(dst, &pixel, sizeof(pixel));
+            break;
+        }
+        case 24:
+        {
+            dst[0] = blue;
+            dst[1] = green;
+            dst[2] = red;
+            break;
+        }
+        case 32:
+        {
+            dst[0] = blue;
+            dst[1] = green;
+            dst[2] = red;
+            dst[3] = 255;
+            break;
+        }
+        default: k_assert(0, "Was asked to draw a test pattern pixel of an unknown bit depth."); break;
+    }
+
+    return;
+}
+
+// Fills the first numBytes of dst by repeating its first periodSize bytes.
+// Each copy doubles the length of the filled portion.
+//
+static void replicate(u8 *const dst, const uint periodSize, const uint numBytes)
+{
+    uint numFilled = std::min(periodSize, numBytes);
+
+    while (numFilled < numBytes)
+    {
+        const uint copySize = std::min(numFilled, (numBytes - numFilled));
+
+        memcpy((dst + numFilled), dst, copySize);
+        numFilled += copySize;
+    }
+
+    return;
+}
+
+// Fills a horizontal span of the given number of pixels, starting from the given
+// pixel of the given row, with the given color.
+//
+static void fill_span(u8 *const row, const uint firstPixel, const uint numPixels,
+                      const u8 red, const u8 green, const u8 blue, const test_pattern_s &pattern)
+{
+    const uint bytesPerPixel = (pattern.r.bpp / 8);
+
+    // In YUY2, the pixels' bytes repeat only every second pixel.
+    const uint periodLength = std::min(numPixels, ((pattern.pixelFormat == RGB_PIXELFORMAT_YUY2)? 2u : 1u));
+
+    if (!numPixels)
+    {
+        return;
+    }
+
+    for (uint x = 0; x < periodLength; x++)
+    {
+        pack_pixel(row, (firstPixel + x), red, green, blue, pattern);
+    }
+
+    replicate((row + (firstPixel * bytesPerPixel)), (periodLength * bytesPerPixel), (numPixels * bytesPerPixel));
+
+    return;
+}
+
+// Draws the given rows of a gradient that moves with the offset. Since the
+// gradient's blue channel wraps around every 256 pixels, only that many pixels
+// of each row need to be drawn; the rest are copies.
+//
+static void draw_gradient(u8 *const pixels, const test_pattern_s &pattern, const uint offset,
+                          const uint firstRow, const uint endRow)
+{
+    const uint bytesPerPixel = (pattern.r.bpp / 8);
+    const uint rowSize = (pattern.r.w * bytesPerPixel);
+    const uint periodLength = std::min(256u, uint(pattern.r.w));
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        u8 *const row = (pixels + (y * rowSize));
+
+        for (uint x = 0; x < periodLength; x++)
+        {
+            pack_pixel(row, x, 150, (offset + y), (offset + x), pattern);
+        }
+
+        replicate(row, (periodLength * bytesPerPixel), rowSize);
+    }
+
+    return;
+}
+
+// Draws SMPTE color bars, as RGB approximations of the standard's colors. The
+// frame is divided into three bands, each of which consists of identical rows;
+// so only a band's first row is drawn, and the rest are copies of it.
+//
+static void draw_smpte_bars(u8 *const pixels, const test_pattern_s &pattern)
+{
+    struct bar_s
+    {
+        // The bar's width, in 84ths of the frame's width (twelfths of a top bar).
+        uint width;
+
+        u8 red, green, blue;
+    };
+
+    static const bar_s topBars[] = {{12, 191, 191, 191}, {12, 191, 191, 0}, {12, 0, 191, 191}, {12, 0, 191, 0},
+                                    {12, 191, 0, 191}, {12, 191, 0, 0}, {12, 0, 0, 191}};
+
+    static const bar_s middleBars[] = {{12, 0, 0, 191}, {12, 0, 0, 0}, {12, 191, 0, 191}, {12, 0, 0, 0},
+                                       {12, 0, 191, 191}, {12, 0, 0, 0}, {12, 191, 191, 191}};
+
+    // -I, white, +Q, black, and the PLUGE (below black, black, and above black).
+    static const bar_s bottomBars[] = {{15, 0, 33, 76}, {15, 255, 255, 255}, {15, 50, 0, 106}, {15, 0, 0, 0},
+                                       {4, 0, 0, 0}, {4, 0, 0, 0}, {4, 10, 10, 10}, {12, 0, 0, 0}};
+
+    const uint h = pattern.r.h;
+
+    const struct
+    {
+        const bar_s *bars;
+        uint numBars;
+        uint firstRow;
+        uint endRow;
+    } bands[] = {{topBars,    (sizeof(topBars) / sizeof(topBars[0])),       0,             ((h * 2) / 3)},
+                 {middleBars, (sizeof(middleBars) / sizeof(middleBars[0])), ((h * 2) / 3), ((h * 3) / 4)},
+                 {bottomBars, (sizeof(bottomBars) / sizeof(bottomBars[0])), ((h * 3) / 4), h}};
+
+    const uint bytesPerPixel = (pattern.r.bpp / 8);
+    const uint rowSize = (pattern.r.w * bytesPerPixel);
+
+    for (const auto &band: bands)
+    {
+        u8 *const bandStart = (pixels + (band.firstRow * rowSize));
+        uint barStart = 0;
+
+        if (band.firstRow >= band.endRow)
+        {
+            continue;
+        }
+
+        for (uint i = 0; i < band.numBars; i++)
+        {
+            const bar_s &bar = band.bars[i];
+            const uint barEnd = ((i == (band.numBars - 1))? pattern.r.w : (barStart + ((bar.width * pattern.r.w) / 84)));
+
+            fill_span(bandStart, barStart, (barEnd - barStart), bar.red, bar.green, bar.blue, pattern);
+
+            barStart = barEnd;
+        }
+
+        replicate(bandStart, rowSize, ((band.endRow - band.firstRow) * rowSize));
+    }
+
+    return;
+}
+
+// Returns the character in the given cell of the text-mode screen: lines of
+// pseudo-words of varying length, with the bottom few lines left empty.
+//
+static u8 text_mode_character(const uint row, const uint column)
+{
+    const uint lineLength = (20 + ((row * 37) % 55));
+    const u32 hash = (((row * TEXT_MODE_COLUMNS) + column + 1) * 2654435761u);
+
+    if ((row >= (TEXT_MODE_ROWS - 3)) ||
+        (column >= lineLength) ||
+        ((hash >> 29) == 0))
+    {
+        return ' ';
+    }
+
+    return ('A' + ((hash >> 16) % 26));
+}
+
+// Returns the set pixels (as bits, leftmost pixel in the highest bit) of the
+// given row of the given character's glyph. The glyphs aren't legible, but are
+// shaped and spaced like those of a text-mode font.
+//
+static u8 glyph_row_bits(const u8 character, const uint glyphRow)
+{
+    if ((character == ' ') ||
+        (glyphRow < 3) ||
+        (glyphRow > 12))
+    {
+        return 0;
+    }
+
+    return ((((character * 2654435761u) ^ (glyphRow * 0x9e3779b9u)) >> 24) & 0x7e);
+}
+
+// Draws a screen of text-mode characters, scaled to fill the frame. Consecutive
+// rows that map to the same row of glyph pixels are identical, so each of them
+// is drawn only once and then copied.
+//
+static void draw_text_mode(u8 *const pixels, const test_pattern_s &pattern)
+{
+    const uint bytesPerPixel = (pattern.r.bpp / 8);
+    const uint rowSize = (pattern.r.w * bytesPerPixel);
+    const uint numGlyphColumns = (TEXT_MODE_COLUMNS * GLYPH_WIDTH);
+    const uint numGlyphRows = (TEXT_MODE_ROWS * GLYPH_HEIGHT);
+
+    uint y = 0;
+
+    while (y < pattern.r.h)
+    {
+        const uint glyphLine = ((y * numGlyphRows) / pattern.r.h);
+        u8 *const row = (pixels + (y * rowSize));
+
+        // Draw the row as spans of pixels, one per glyph pixel.
+        for (uint gx = 0; gx < numGlyphColumns; gx++)
+        {
+            const uint spanStart = ((gx * pattern.r.w) / numGlyphColumns);
+            const uint spanEnd = (((gx + 1) * pattern.r.w) / numGlyphColumns);
+            const u8 character = text_mode_character((glyphLine / GLYPH_HEIGHT), (gx / GLYPH_WIDTH));
+            const bool isSet = ((glyph_row_bits(character, (glyphLine % GLYPH_HEIGHT)) >> (7 - (gx % GLYPH_WIDTH))) & 1);
+
+            if (isSet) fill_span(row, spanStart, (spanEnd - spanStart), 170, 170, 170, pattern);
+            else       fill_span(row, spanStart, (spanEnd - spanStart), 0, 0, 0, pattern);
+        }
+
+        // Copy the row into the rest of the rows that share its glyph line.
+        uint endRow = (y + 1);
+        while ((endRow < pattern.r.h) &&
+               (((endRow * numGlyphRows) / pattern.r.h) == glyphLine))
+        {
+            endRow++;
+        }
+
+        replicate(row, rowSize, ((endRow - y) * rowSize));
+
+        y = endRow;
+    }
+
+    return;
+}
+
+// Draws the frame as if the source had swapped to a new image while the frame
+// was being scanned out: in every odd-numbered frame, the rows from the tear row
+// down show a new image, while the rows above it still show the previous one.
+// The frame that follows shows the new image in full.
+//
+static void draw_torn_frame(u8 *const pixels, const test_pattern_s &pattern, const uint frameNumber)
+{
+    const uint imageNumber = ((frameNumber + 1) / 2);
+    const bool isTorn = (frameNumber % 2);
+
+    draw_gradient(pixels, pattern, ((isTorn? (imageNumber - 1) : imageNumber) * IMAGE_OFFSET_STEP), 0, pattern.tearRow);
+    draw_gradient(pixels, pattern, (imageNumber * IMAGE_OFFSET_STEP), pattern.tearRow, pattern.r.h);
+
+    return;
+}
+
+// Draws the moving gradient such that each image lasts for the pattern's number
+// of repeats.
+//
+static void draw_duplicate_frames(u8 *const pixels, const test_pattern_s &pattern, const uint frameNumber)
+{
+    const uint imageNumber = (frameNumber / pattern.numRepeats);
+
+    draw_gradient(pixels, pattern, (imageNumber * IMAGE_OFFSET_STEP), 0, pattern.r.h);
+
+    return;
+}
+
+// Fills the frame with pseudo-random bytes. The bytes come from four xorshift
+// generators run side by side, each producing every fourth 32-bit word; so the
+// SSE2 and plain versions produce identical frames.
+//
+static void draw_noise(u8 *const pixels, const test_pattern_s &pattern, const uint frameNumber)
+{
+    const uint numBytes = (pattern.r.w * pattern.r.h * (pattern.r.bpp / 8));
+    u32 state[4];
+    uint i = 0;
+
+    for (uint lane = 0; lane < 4; lane++)
+    {
+        // Xorshift state must never be 0.
+        state[lane] = ((((frameNumber + 1) * 0x9e3779b9u) ^ ((lane + 1) * 0x85ebca6bu)) | 1);
+    }
+
+#if __SSE2__
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)state);
+
+        for (; (i + 16) <= numBytes; i += 16)
+        {
+            s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+            s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+            s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+
+            _mm_storeu_si128((__m128i*)(pixels + i), s);
+        }
+
+        _mm_storeu_si128((__m128i*)state, s);
+    }
+#else
+    for (; (i + 16) <= numBytes; i += 16)
+    {
+        for (uint lane = 0; lane < 4; lane++)
+        {
+            state[lane] ^= (state[lane] << 13);
+            state[lane] ^= (state[lane] >> 17);
+            state[lane] ^= (state[lane] << 5);
+        }
+
+        memcpy((pixels + i), state, 16);
+    }
+#endif
+
+    // The frame's size needn't be a multiple of 16 bytes.
+    if (i < numBytes)
+    {
+        for (uint lane = 0; lane < 4; lane++)
+        {
+            state[lane] ^= (state[lane] << 13);
+            state[lane] ^= (state[lane] >> 17);
+            state[lane] ^= (state[lane] << 5);
+        }
+
+        memcpy((pixels + i), state, (numBytes - i));
+    }
+
+    return;
+}
+
+// Draws the given frame of the given test pattern into the pixel buffer, which
+// must have room for a frame of the pattern's resolution. Patterns that move do
+// so as a function of the frame number.
+//
+void ktp_draw_test_pattern(u8 *const pixels, const test_pattern_s &pattern, const uint frameNumber)
+{
+    k_assert(ktp_is_valid_pattern(pattern), "Was asked to draw an invalid test pattern.");
+
+    switch (pattern.type)
+    {
+        case test_pattern_e::gradient:         draw_gradient(pixels, pattern, frameNumber, 0, pattern.r.h); break;
+        case test_pattern_e::smpte_bars:       draw_smpte_bars(pixels, pattern); break;
+        case test_pattern_e::text_mode:        draw_text_mode(pixels, pattern); break;
+        case test_pattern_e::torn_frame:       draw_torn_frame(pixels, pattern, frameNumber); break;
+        case test_pattern_e::duplicate_frames: draw_duplicate_frames(pixels, pattern, frameNumber); break;
+        case test_pattern_e::noise:            draw_noise(pixels, pattern, frameNumber); break;
+        default: k_assert(0, "Was asked to draw an unknown test pattern."); break;
+    }
+
+    return;
+}
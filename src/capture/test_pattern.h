@@ -0,0 +1,63 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef TEST_PATTERN_H
+#define TEST_PATTERN_H
+
+#include <string>
+#include "capture/capture.h"
+
+enum class test_pattern_e
+{
+    // A gradient that moves with each frame.
+    gradient,
+
+    // SMPTE color bars. Static.
+    smpte_bars,
+
+    // A screen of 80 x 25 text-mode characters. Static.
+    text_mode,
+
+    // The moving gradient, such that each new image replaces the previous one
+    // partway down the frame - as if the source had swapped its image while
+    // the frame was being scanned out.
+    torn_frame,
+
+    // The moving gradient, such that each image is repeated for several frames.
+    duplicate_frames,
+
+    // Random pixels, different in each frame.
+    noise
+};
+
+struct test_pattern_s
+{
+    test_pattern_e type;
+
+    // The resolution of the pattern's frames. The bit depth is that in which
+    // the pixels are stored (16, 24, or 32).
+    resolution_s r;
+
+    // The arrangement of the pixels' color channels: RGB_PIXELFORMAT_555,
+    // RGB_PIXELFORMAT_565, or RGB_PIXELFORMAT_YUY2 for 16-bit pixels, and
+    // RGB_PIXELFORMAT_888 for 24- and 32-bit pixels.
+    PIXELFORMAT pixelFormat;
+
+    // For test_pattern_e::torn_frame, the row at which the new image begins.
+    uint tearRow;
+
+    // For test_pattern_e::duplicate_frames, how many frames each image is
+    // repeated for.
+    uint numRepeats;
+};
+
+bool ktp_pattern_type_for_name(const std::string &name, test_pattern_e *const type);
+
+bool ktp_is_valid_pattern(const test_pattern_s &pattern);
+
+void ktp_draw_test_pattern(u8 *const pixels, const test_pattern_s &pattern, const uint frameNumber);
+
+#endif
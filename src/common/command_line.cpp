@@ -5,6 +5,11 @@
  */
 
 #include <unistd.h>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include "capture/test_pattern.h"
+#include "capture/frame_ring.h"
 #include "common/globals.h"
 
 /*
@@ -17,6 +22,10 @@
 // Which input channel on the capture hardware we want to receive frames from.
 uint INPUT_CHANNEL_IDX = 1;
 
+// The input channels on the capture hardware to capture from concurrently, as
+// given on the command line; the first of them being INPUT_CHANNEL_IDX.
+static std::vector<uint> INPUT_CHANNELS;
+
 // How many frames the capture card should drop between captures.
 uint FRAME_SKIP = 0;
 
@@ -29,16 +38,80 @@ static std::string ALIAS_FILE_NAME = "";
 // Name of (and path to) the filter set file on disk.
 static std::string FILTERS_FILE_NAME = "";
 
+// How many frames the capturer can queue up while VCS is busy processing earlier
+// ones.
+static uint NUM_CAPTURE_BUFFERS = DEFAULT_FRAME_RING_SLOTS;
+
+// Whether the capture hardware should be asked to write its frames directly into
+// VCS's capture buffers, rather than VCS copying each frame over from the
+// hardware's own buffers.
+static bool ZERO_COPY_CAPTURE = false;
+
+// Whether the capture hardware should be asked to downscale the frames it sends
+// to the size they'll be output at, whenever processing doesn't need them at
+// their full size.
+static bool HARDWARE_DOWNSCALING = false;
+
+// Name of (and path to) the file into which to dump the captured frames.
+static std::string CAPTURE_DUMP_FILE_NAME = "";
+
+// Name of (and path to) the capture dump file to replay in place of capturing.
+static std::string CAPTURE_REPLAY_FILE_NAME = "";
+
+// The rate, in frames per second, at which virtual capture - replaying a capture
+// dump, or generating test patterns - feeds in frames. A negative value replays
+// a dump at the timing at which its frames were originally captured, and
+// generates test patterns at 60 frames per second; and 0 feeds in frames as fast
+// as VCS can process them.
+static int VIRTUAL_CAPTURE_RATE = -1;
+
+// The test pattern that virtual capture generates when not replaying a capture
+// dump.
+static test_pattern_s TEST_PATTERN = {test_pattern_e::gradient, {640, 480, 32}, RGB_PIXELFORMAT_888, 0, 2};
+
+// How much the pixels of a captured frame may differ from those of the previous
+// processed frame for the frame to count as a repeat of it, whose processing
+// can be skipped; or 0 for having to be identical. If -1, repeated frames are
+// processed like any others.
+static int DUPLICATE_FRAME_THRESHOLD = -1;
+
+// Every how many frames the capture's alignment is measured and, if it's drifted,
+// corrected; or 0 if the alignment is left as is.
+static uint AUTO_ALIGN_INTERVAL = 0;
+
+// Every how many frames the active area of frames - the part inside any black
+// borders - is measured, so that only it gets processed; or 0 if frames are
+// processed in full.
+static uint ACTIVE_AREA_INTERVAL = 0;
+
+// How many threads frames are scaled on; or 0 for one per CPU core.
+static uint NUM_SCALER_THREADS = 0;
+
+// Set to true if the test pattern's tear row was given on the command line.
+// Otherwise, the tear is placed halfway down the frame.
+static bool TEST_PATTERN_TEAR_ROW_GIVEN = false;
+
 bool kcom_parse_command_line(const int argc, char *const argv[])
 {
     int c = 0;
-    while ((c = getopt(argc, argv, "i:m:a:f:")) != -1)
+    while ((c = getopt(argc, argv, "i:m:a:f:b:zsd:r:p:t:g:e:l:c:j:")) != -1)
     {
         switch (c)
         {
-            case 'i':   // Capture input channel (>0).
+            case 'i':   // Capture input channel(s) (>0), as "1" or "1,2".
             {
-                INPUT_CHANNEL_IDX = strtol(optarg, NULL, 10);
+                const std::string arg = optarg;
+                size_t startPos = 0;
+
+                INPUT_CHANNELS.clear();
+
+                while (startPos <= arg.length())
+                {
+                    const size_t separatorPos = std::min(arg.find(',', startPos), arg.length());
+
+                    INPUT_CHANNELS.push_back(strtoul(arg.substr(startPos, (separatorPos - startPos)).c_str(), NULL, 10));
+                    startPos = (separatorPos + 1);
+                }
 
                 break;
             }
@@ -58,31 +131,221 @@ bool kcom_parse_command_line(const int argc, char *const argv[])
             {
                 FILTERS_FILE_NAME = optarg;
 
+                break;
+            }
+            case 'b':   // Number of capture buffers (1...MAX_FRAME_RING_SLOTS).
+            {
+                NUM_CAPTURE_BUFFERS = strtol(optarg, NULL, 10);
+
+                break;
+            }
+            case 'z':   // Capture directly into VCS's capture buffers.
+            {
+                ZERO_COPY_CAPTURE = true;
+
+                break;
+            }
+            case 's':   // Have the capture hardware downscale the frames.
+            {
+                HARDWARE_DOWNSCALING = true;
+
+                break;
+            }
+            case 'd':   // Location of the file into which to dump captured frames.
+            {
+                CAPTURE_DUMP_FILE_NAME = optarg;
+
+                break;
+            }
+            case 'r':   // Location of the capture dump file to replay.
+            {
+                CAPTURE_REPLAY_FILE_NAME = optarg;
+
+                break;
+            }
+            case 'p':   // Virtual capture rate (frames per second, or 0 for unlimited).
+            {
+                VIRTUAL_CAPTURE_RATE = strtol(optarg, NULL, 10);
+
+                break;
+            }
+            case 't':   // Test pattern, as "name" or "name:parameter".
+            {
+                const std::string arg = optarg;
+                const size_t separatorPos = arg.find(':');
+
+                if (!ktp_pattern_type_for_name(arg.substr(0, separatorPos), &TEST_PATTERN.type))
+                {
+                    NBENE(("Detected an unknown test pattern (\"%s\").", optarg));
+                    goto fail;
+                }
+
+                if (separatorPos != std::string::npos)
+                {
+                    const uint parameter = strtoul(arg.substr(separatorPos + 1).c_str(), NULL, 10);
+
+                    switch (TEST_PATTERN.type)
+                    {
+                        case test_pattern_e::torn_frame: TEST_PATTERN.tearRow = parameter; TEST_PATTERN_TEAR_ROW_GIVEN = true; break;
+                        case test_pattern_e::duplicate_frames: TEST_PATTERN.numRepeats = parameter; break;
+                        default: break;
+                    }
+                }
+
+                break;
+            }
+            case 'g':   // Test pattern resolution and color depth, as "WxHxB".
+            {
+                uint w = 0, h = 0, bpp = 0;
+                char depth[8] = {0};
+
+                if (sscanf(optarg, "%ux%ux%7s", &w, &h, depth) != 3)
+                {
+                    NBENE(("Detected a malformed test pattern resolution (\"%s\"). Expected "
+                           "it as <width>x<height>x<color depth>.", optarg));
+                    goto fail;
+                }
+
+                // Color depths 24 and 32 both carry 888 pixels; 15 and 16 are
+                // 555 and 565 carried in 16 bits, as is "yuy2" (YUV 4:2:2).
+                bpp = ((std::string(depth) == "yuy2")? 16 : strtoul(depth, NULL, 10));
+
+                TEST_PATTERN.r = {w, h, ((bpp == 15)? 16 : bpp)};
+                TEST_PATTERN.pixelFormat = (std::string(depth) == "yuy2")? RGB_PIXELFORMAT_YUY2
+                                         : (bpp == 15)? RGB_PIXELFORMAT_555
+                                         : (bpp == 16)? RGB_PIXELFORMAT_565
+                                         : RGB_PIXELFORMAT_888;
+
+                break;
+            }
+            case 'e':   // Elide repeated frames, as "exact" or a threshold (1...255).
+            {
+                DUPLICATE_FRAME_THRESHOLD = ((std::string(optarg) == "exact")? 0 : strtol(optarg, NULL, 10));
+
+                if (DUPLICATE_FRAME_THRESHOLD < 0 ||
+                    DUPLICATE_FRAME_THRESHOLD > 255 ||
+                    (DUPLICATE_FRAME_THRESHOLD == 0 && (std::string(optarg) != "exact")))
+                {
+                    NBENE(("Detected an invalid duplicate frame threshold (\"%s\"). Expected "
+                           "either \"exact\" or a number in the range 1-255.", optarg));
+                    goto fail;
+                }
+
+                break;
+            }
+            case 'l':   // Keep the capture aligned, measuring every nth frame (>0).
+            {
+                const long interval = strtol(optarg, NULL, 10);
+
+                if (interval <= 0)
+                {
+                    NBENE(("Detected an invalid auto-alignment interval (\"%s\"). Expected "
+                           "a number of frames greater than 0.", optarg));
+                    goto fail;
+                }
+
+                AUTO_ALIGN_INTERVAL = interval;
+
+                break;
+            }
+            case 'c':   // Process only the active area, measuring it every nth frame (>0).
+            {
+                const long interval = strtol(optarg, NULL, 10);
+
+                if (interval <= 0)
+                {
+                    NBENE(("Detected an invalid active area interval (\"%s\"). Expected "
+                           "a number of frames greater than 0.", optarg));
+                    goto fail;
+                }
+
+                ACTIVE_AREA_INTERVAL = interval;
+
+                break;
+            }
+            case 'j':   // Number of threads to scale frames on (1...16), or 0 for one per core.
+            {
+                const long numThreads = strtol(optarg, NULL, 10);
+
+                if ((numThreads < 0) ||
+                    (numThreads > 16))
+                {
+                    NBENE(("Detected an invalid number of scaler threads (\"%s\"). Expected "
+                           "a number in the range 0-16.", optarg));
+                    goto fail;
+                }
+
+                NUM_SCALER_THREADS = numThreads;
+
                 break;
             }
         }
     }
 
-    // Expect to get the input channel as 1-indexed on the command line.
-    if (INPUT_CHANNEL_IDX == 0)
+    if (INPUT_CHANNELS.empty())
     {
-        NBENE(("Detected an invalid input channel (0). The first capture channel "
-               "is expected to be given as 1."));
+        INPUT_CHANNELS.push_back(INPUT_CHANNEL_IDX);
+    }
 
-        kd_show_headless_error_message("",
-                                       "VCS has to exit because it found unexpected data while "
-                                       "parsing the command line.\n\nMore information "
-                                       "will have been printed into the console. If a "
-                                       "console window was not already open, run VCS "
-                                       "again from the command line.");
+    // Expect to get the input channels as 1-indexed on the command line.
+    for (uint i = 0; i < INPUT_CHANNELS.size(); i++)
+    {
+        if (INPUT_CHANNELS[i] == 0 ||
+            INPUT_CHANNELS[i] > MAX_INPUT_CHANNELS)
+        {
+            NBENE(("Detected an invalid input channel (%u). The capture channels are "
+                   "expected to be given in the range 1-%u.", INPUT_CHANNELS[i], MAX_INPUT_CHANNELS));
+            goto fail;
+        }
 
-        return false;
+        if (std::count(INPUT_CHANNELS.begin(), INPUT_CHANNELS.end(), INPUT_CHANNELS[i]) > 1)
+        {
+            NBENE(("Detected input channel %u given more than once.", INPUT_CHANNELS[i]));
+            goto fail;
+        }
+    }
+
+    if (NUM_CAPTURE_BUFFERS < 1 ||
+        NUM_CAPTURE_BUFFERS > MAX_FRAME_RING_SLOTS)
+    {
+        NBENE(("Detected an invalid number of capture buffers (%u). The number "
+               "is expected to be in the range 1-%u.", NUM_CAPTURE_BUFFERS, MAX_FRAME_RING_SLOTS));
+        goto fail;
+    }
+
+    if (!TEST_PATTERN_TEAR_ROW_GIVEN)
+    {
+        TEST_PATTERN.tearRow = (TEST_PATTERN.r.h / 2);
+    }
+
+    if (!ktp_is_valid_pattern(TEST_PATTERN))
+    {
+        NBENE(("Detected invalid test pattern settings. The resolution is expected to be "
+               "at most %u x %u, the color depth 15, 16, 24, 32, or yuy2 (with an even width), "
+               "the tear row within the frame, and the number of repeats at least 1.",
+               MAX_OUTPUT_WIDTH, MAX_OUTPUT_HEIGHT));
+        goto fail;
     }
 
     // Convert to 0-indexed.
-    INPUT_CHANNEL_IDX--;
+    for (uint &channel: INPUT_CHANNELS)
+    {
+        channel--;
+    }
+
+    INPUT_CHANNEL_IDX = INPUT_CHANNELS.front();
 
     return true;
+
+    fail:
+    kd_show_headless_error_message("",
+                                   "VCS has to exit because it found unexpected data while "
+                                   "parsing the command line.\n\nMore information "
+                                   "will have been printed into the console. If a "
+                                   "console window was not already open, run VCS "
+                                   "again from the command line.");
+
+    return false;
 }
 
 const std::string& kcom_alias_file_name(void)
@@ -99,3 +362,63 @@ const std::string& kcom_params_file_name(void)
 {
     return PARAMS_FILE_NAME;
 }
+
+uint kcom_num_capture_buffers(void)
+{
+    return NUM_CAPTURE_BUFFERS;
+}
+
+bool kcom_zero_copy_capture(void)
+{
+    return ZERO_COPY_CAPTURE;
+}
+
+bool kcom_hardware_downscaling(void)
+{
+    return HARDWARE_DOWNSCALING;
+}
+
+const std::string& kcom_capture_dump_file_name(void)
+{
+    return CAPTURE_DUMP_FILE_NAME;
+}
+
+const std::string& kcom_capture_replay_file_name(void)
+{
+    return CAPTURE_REPLAY_FILE_NAME;
+}
+
+int kcom_virtual_capture_rate(void)
+{
+    return VIRTUAL_CAPTURE_RATE;
+}
+
+const test_pattern_s& kcom_test_pattern(void)
+{
+    return TEST_PATTERN;
+}
+
+const std::vector<uint>& kcom_input_channels(void)
+{
+    return INPUT_CHANNELS;
+}
+
+int kcom_duplicate_frame_threshold(void)
+{
+    return DUPLICATE_FRAME_THRESHOLD;
+}
+
+uint kcom_auto_align_interval(void)
+{
+    return AUTO_ALIGN_INTERVAL;
+}
+
+uint kcom_active_area_interval(void)
+{
+    return ACTIVE_AREA_INTERVAL;
+}
+
+uint kcom_num_scaler_threads(void)
+{
+    return NUM_SCALER_THREADS;
+}
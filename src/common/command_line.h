@@ -8,6 +8,10 @@
 #define COMMAND_LINE_H
 
 #include <string>
+#include <vector>
+#include "common/types.h"
+
+struct test_pattern_s;
 
 bool kcom_parse_command_line(const int argc, char *const argv[]);
 
@@ -17,4 +21,28 @@ const std::string& kcom_filters_file_name(void);
 
 const std::string& kcom_params_file_name(void);
 
+uint kcom_num_capture_buffers(void);
+
+bool kcom_zero_copy_capture(void);
+
+bool kcom_hardware_downscaling(void);
+
+const std::string& kcom_capture_dump_file_name(void);
+
+const std::string& kcom_capture_replay_file_name(void);
+
+int kcom_virtual_capture_rate(void);
+
+const test_pattern_s& kcom_test_pattern(void);
+
+const std::vector<uint>& kcom_input_channels(void);
+
+int kcom_duplicate_frame_threshold(void);
+
+uint kcom_auto_align_interval(void);
+
+uint kcom_active_area_interval(void);
+
+uint kcom_num_scaler_threads(void);
+
 #endif
@@ -0,0 +1,181 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS parallel processing
+ *
+ * Splits the processing of an image into horizontal bands of rows, and runs the
+ * bands concurrently on a pool of worker threads; e.g. for scaling a frame on
+ * several cores at once.
+ *
+ * The calling thread processes the first band itself, and returns once all of
+ * the bands have been processed. A band job may read anything of the image it's
+ * given, but should only write the rows of its own band; so that the result is
+ * the same regardless of how many bands the image is split into.
+ *
+ */
+
+#include <condition_variable>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include "common/parallel.h"
+#include "common/globals.h"
+
+// The largest number of threads that processing can be split across.
+static const uint MAX_NUM_THREADS = 16;
+
+// Bands are made at least this many rows high, so that small images don't get
+// split into bands too small to be worth handing out to other threads.
+static const uint MIN_ROWS_PER_BAND = 32;
+
+// The number of threads, including the calling one, that processing is split
+// across.
+static uint NUM_THREADS = 1;
+
+// The worker threads, and what's shared with them. Each job is given a new
+// generation number, by which the workers tell that there's a new job.
+static std::vector<std::thread> WORKERS;
+static std::mutex WORKER_MUTEX;
+static std::condition_variable JOB_READY;
+static std::condition_variable JOB_DONE;
+static const band_job_t *JOB = nullptr;
+static uint JOB_NUM_ROWS = 0;
+static uint JOB_NUM_BANDS = 0;
+static uint JOB_GENERATION = 0;
+static uint NUM_BANDS_LEFT = 0;
+static bool STOP_WORKERS = false;
+
+// Runs the given band, out of numBands, of the given job.
+//
+static void run_band(const band_job_t &job, const uint band, const uint numBands, const uint numRows)
+{
+    const uint firstRow = ((u64(numRows) * band) / numBands);
+    const uint endRow = ((u64(numRows) * (band + 1)) / numBands);
+
+    job(firstRow, endRow);
+
+    return;
+}
+
+// The loop of the worker thread that processes the given band of each job
+// after the given generation.
+//
+static void process_bands(const uint band, uint prevGeneration)
+{
+    std::unique_lock<std::mutex> lock(WORKER_MUTEX);
+
+    while (true)
+    {
+        JOB_READY.wait(lock, [&]{ return (STOP_WORKERS || (JOB_GENERATION != prevGeneration)); });
+
+        if (STOP_WORKERS)
+        {
+            break;
+        }
+
+        prevGeneration = JOB_GENERATION;
+
+        // Jobs with fewer bands than there are threads leave the rest idle.
+        if (band >= JOB_NUM_BANDS)
+        {
+            continue;
+        }
+
+        lock.unlock();
+        run_band(*JOB, band, JOB_NUM_BANDS, JOB_NUM_ROWS);
+        lock.lock();
+
+        if (!--NUM_BANDS_LEFT)
+        {
+            JOB_DONE.notify_one();
+        }
+    }
+
+    return;
+}
+
+// Sets up processing to be split across the given number of threads, including
+// the calling one; or, if 0, across one thread per CPU core.
+//
+void kpar_initialize(const uint numThreads)
+{
+    k_assert(WORKERS.empty(), "Attempting to initialize parallel processing more than once.");
+
+    NUM_THREADS = (numThreads? numThreads : std::thread::hardware_concurrency());
+    NUM_THREADS = std::max(1u, std::min(MAX_NUM_THREADS, NUM_THREADS));
+
+    INFO(("Splitting processing across %u thread(s).", NUM_THREADS));
+
+    STOP_WORKERS = false;
+
+    for (uint i = 1; i < NUM_THREADS; i++)
+    {
+        WORKERS.push_back(std::thread(process_bands, i, JOB_GENERATION));
+    }
+
+    return;
+}
+
+void kpar_release(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(WORKER_MUTEX);
+        STOP_WORKERS = true;
+    }
+
+    JOB_READY.notify_all();
+
+    for (std::thread &worker: WORKERS)
+    {
+        worker.join();
+    }
+
+    WORKERS.clear();
+    NUM_THREADS = 1;
+
+    return;
+}
+
+uint kpar_num_threads(void)
+{
+    return NUM_THREADS;
+}
+
+// Runs the given job over numRows rows, split into bands across the threads.
+// Returns once the whole job is done.
+//
+void kpar_run_in_bands(const uint numRows, const band_job_t &job)
+{
+    const uint numBands = std::min(NUM_THREADS, std::max(1u, (numRows / MIN_ROWS_PER_BAND)));
+
+    if (numBands <= 1)
+    {
+        job(0, numRows);
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(WORKER_MUTEX);
+
+        JOB = &job;
+        JOB_NUM_ROWS = numRows;
+        JOB_NUM_BANDS = numBands;
+        NUM_BANDS_LEFT = (numBands - 1);
+        JOB_GENERATION++;
+    }
+
+    JOB_READY.notify_all();
+
+    run_band(job, 0, numBands, numRows);
+
+    {
+        std::unique_lock<std::mutex> lock(WORKER_MUTEX);
+
+        JOB_DONE.wait(lock, []{ return !NUM_BANDS_LEFT; });
+
+        JOB = nullptr;
+    }
+
+    return;
+}
@@ -0,0 +1,24 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+#include "common/types.h"
+
+// A job that processes the given range of rows, [firstRow, endRow), of an image.
+typedef std::function<void(const uint firstRow, const uint endRow)> band_job_t;
+
+void kpar_initialize(const uint numThreads);
+
+void kpar_release(void);
+
+uint kpar_num_threads(void);
+
+void kpar_run_in_bands(const uint numRows, const band_job_t &job);
+
+#endif
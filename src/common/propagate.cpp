@@ -11,6 +11,10 @@
 
 #include <mutex>
 #include "propagate.h"
+#include "common/command_line.h"
+#include "capture/capture_dump.h"
+#include "capture/frame_dedup.h"
+#include "filter/auto_align.h"
 #include "capture/capture.h"
 #include "display/display.h"
 #include "common/globals.h"
@@ -33,10 +37,15 @@ void kpropagate_news_of_new_capture_video_mode(void)
 
     kc_apply_new_capture_resolution();
 
+    // Frames of the new mode mustn't be taken for repeats of the old mode's.
+    kdedup_reset();
+
     kd_update_capture_signal_info();
 
     ks_set_output_base_resolution(s.r, false);
 
+    ks_prepare_for_capture_mode();
+
     kd_redraw_output_window();
 
     return;
@@ -78,6 +87,17 @@ void kpropagate_news_of_recording_ended(void)
     return;
 }
 
+// The set of filters being applied to frames has changed; e.g. filter chains
+// have been added or removed, or filtering has been toggled on or off.
+void kpropagate_news_of_changed_filter_chains(void)
+{
+    // The new filters might accept a cheaper capture format than the old ones,
+    // or might not accept the current one.
+    kc_negotiate_capture_pixel_format();
+
+    return;
+}
+
 // Call to let the system know that the given mode parameters have been loaded
 // from the given file.
 void kpropagate_loaded_mode_params_from_disk(const std::vector<video_mode_params_s> &modeParams,
@@ -170,6 +190,8 @@ void kpropagate_news_of_invalid_capture_signal(void)
 
     ks_indicate_invalid_signal();
 
+    kdedup_reset();
+
     kd_redraw_output_window();
 
     return;
@@ -182,6 +204,8 @@ void kpropagate_news_of_lost_capture_signal(void)
 
     ks_indicate_no_signal();
 
+    kdedup_reset();
+
     kd_redraw_output_window();
 
     return;
@@ -199,13 +223,44 @@ void kpropagate_news_of_gained_capture_signal(void)
 // The capture hardware has sent us a new captured frame.
 void kpropagate_news_of_new_captured_frame(void)
 {
-    ks_scale_frame(kc_latest_captured_frame());
+    const captured_frame_s &frame = kc_latest_captured_frame();
+
+    // Dump the frame before it gets processed, since processing may modify its
+    // pixels.
+    if (kdump_is_dumping())
+    {
+        kdump_dump_frame(frame);
+    }
+
+    // If the frame repeats the one from which the current output was produced,
+    // the output can stand in for it, and the frame needn't be processed. The
+    // scaler doesn't produce output for frames that are to be skipped, so
+    // such frames mustn't become the original for later repeats.
+    if (kc_should_current_frame_be_skipped())
+    {
+        kdedup_reset();
+        ks_scale_frame(frame);
+    }
+    else if (!kdedup_is_repeat_of_processed_frame(frame) ||
+             !ks_reuse_output_for_repeat_frame(frame))
+    {
+        ks_scale_frame(frame);
+    }
 
     if (krecord_is_recording())
     {
         krecord_record_new_frame();
     }
 
+    kalign_update_alignment();
+
+    // Let the capture hardware take over as much of the downscaling of later
+    // frames as the current processing allows.
+    if (kcom_hardware_downscaling())
+    {
+        kc_set_hardware_output_size(ks_hardware_downscaling_size());
+    }
+
     kc_mark_current_frame_as_processed();
 
     kd_redraw_output_window();
@@ -213,6 +268,64 @@ void kpropagate_news_of_new_captured_frame(void)
     return;
 }
 
+// A capture source in the background - i.e. other than the selected source, which
+// kc_activate_source() has made the active one - has a new input video mode. Its
+// mode is applied like the selected source's, but as its frames aren't being
+// displayed, the GUI isn't told.
+void kpropagate_news_of_new_background_video_mode(void)
+{
+    kc_apply_new_capture_resolution();
+
+    ks_prepare_for_capture_mode();
+
+    return;
+}
+
+// A capture source in the background lost its input signal, or received an
+// invalid one.
+void kpropagate_news_of_background_signal_loss(void)
+{
+    ks_indicate_no_signal();
+
+    return;
+}
+
+// A capture source in the background has sent us a new captured frame. The frame
+// is filtered and scaled into the source's own output, and recorded if the source
+// is being recorded. Anti-tearing, alignment, duplicate frame detection and the
+// like keep track of the selected source's frames, so they're left out.
+void kpropagate_news_of_new_background_frame(void)
+{
+    ks_scale_frame(kc_latest_captured_frame());
+
+    if (krecord_is_recording())
+    {
+        krecord_record_new_frame();
+    }
+
+    if (kcom_hardware_downscaling())
+    {
+        kc_set_hardware_output_size(ks_hardware_downscaling_size());
+    }
+
+    kc_mark_current_frame_as_processed();
+
+    return;
+}
+
+// The user has selected another of the capture sources. Its recording, if any,
+// carries on; and so do those of the others, in the background.
+void kpropagate_news_of_changed_capture_source(void)
+{
+    kd_set_video_recording_is_active(krecord_is_recording());
+    kd_disable_output_size_controls(krecord_is_recording());
+    kd_update_video_recording_metainfo();
+    kd_update_output_window_title();
+    kd_update_output_window_size();
+
+    return;
+}
+
 // The capture hardware has met with an unrecoverable error.
 void kpropagate_news_of_unrecoverable_error(void)
 {
@@ -100,8 +100,15 @@ void kd_update_video_mode_params(void);
 // information about it, poll its status and update the GUI accordingly.
 void kd_update_capture_signal_info(void);
 
-// Spin the GUI's event loop, by processing any user input requests, etc.
-void kd_spin_event_loop(void);
+// Spin the GUI's event loop, by processing any user input requests, etc. If
+// waitForEvents is true, blocks until there's at least one event to process, or
+// until kd_wake_event_loop() is called.
+void kd_spin_event_loop(const bool waitForEvents);
+
+// Makes a blocked kd_spin_event_loop() return. Can be called from any thread;
+// e.g. by the capture hardware's callbacks when there's new capture data to be
+// processed. Does nothing once the display has been released.
+void kd_wake_event_loop(void);
 
 // Display a message box to the user. These should be headless, i.e. independent
 // of the output window, so that they can be spawned even before the GUI has been
@@ -149,4 +156,9 @@ uint kd_output_framerate(void);
 int kd_average_pipeline_latency(void);
 int kd_peak_pipeline_latency(void);
 
+/// Temporary. The number of capture hardware API calls per second that the
+/// capture unit's status snapshot has saved VCS from making. Available as a
+/// variable in the output overlay.
+int kd_saved_status_queries_per_second(void);
+
 #endif
@@ -7,6 +7,7 @@
  *
  */
 
+#include <QAbstractEventDispatcher>
 #include <QApplication>
 #include <QMessageBox>
 #include <assert.h>
@@ -31,6 +32,7 @@ static MainWindow *WINDOW = nullptr;
 
 extern int UPDATE_LATENCY_PEAK;
 extern int UPDATE_LATENCY_AVG;
+extern int STATUS_QUERIES_SAVED_PER_SECOND;
 
 void kd_clear_filter_graph(void)
 {
@@ -187,11 +189,31 @@ void kd_release_output_window(void)
     return;
 }
 
-void kd_spin_event_loop(void)
+void kd_spin_event_loop(const bool waitForEvents)
 {
     k_assert(WINDOW != nullptr,
              "Expected the display to have been acquired before accessing it for events processing. ");
-    WINDOW->update_gui_state();
+    WINDOW->update_gui_state(waitForEvents);
+
+    return;
+}
+
+void kd_wake_event_loop(void)
+{
+    // The application object is gone once the display has been released.
+    const QCoreApplication *const app = QCoreApplication::instance();
+
+    if (app == nullptr)
+    {
+        return;
+    }
+
+    QAbstractEventDispatcher *const dispatcher = QAbstractEventDispatcher::instance(app->thread());
+
+    if (dispatcher != nullptr)
+    {
+        dispatcher->wakeUp();
+    }
 
     return;
 }
@@ -258,6 +280,11 @@ int kd_average_pipeline_latency(void)
     return UPDATE_LATENCY_AVG;
 }
 
+int kd_saved_status_queries_per_second(void)
+{
+    return STATUS_QUERIES_SAVED_PER_SECOND;
+}
+
 bool kd_is_fullscreen(void)
 {
     k_assert(WINDOW != nullptr, "Tried to query the display before it had been initialized.");
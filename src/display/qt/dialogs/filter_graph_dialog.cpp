@@ -10,6 +10,7 @@
 #include "display/qt/dialogs/filter_graph_dialog.h"
 #include "display/qt/widgets/filter_widgets.h"
 #include "display/qt/persistent_settings.h"
+#include "common/propagate.h"
 #include "common/disk.h"
 #include "ui_filter_graph_dialog.h"
 
@@ -138,6 +139,7 @@ FilterGraphDialog::FilterGraphDialog(QWidget *parent) :
                 [=](const bool isEnabled)
                 {
                     kf_set_filtering_enabled(isEnabled);
+                    kpropagate_news_of_changed_filter_chains();
                     kd_update_output_window_title();
                     this->menubar->setEnabled(isEnabled);
                 });
@@ -294,8 +296,8 @@ FilterGraphNode* FilterGraphDialog::add_filter_node(const filter_type_enum_e typ
 
 // Visit each node in the graph and while doing so, group together such chains of
 // filters that run from an input gate through one or more filters into an output
-// gate. The chains will then be submitted to the filter handler for use in applying
-// the filters to captured frames.
+// gate. The chains will then be submitted to the filter handler, which prepares
+// each into a plan for applying the filters to captured frames.
 void FilterGraphDialog::recalculate_filter_chains(void)
 {
     kf_remove_all_filter_chains();
@@ -339,12 +341,15 @@ void FilterGraphDialog::recalculate_filter_chains(void)
         traverse_filter_node(inputGate, {});
     }
 
+    kpropagate_news_of_changed_filter_chains();
+
     return;
 }
 
 void FilterGraphDialog::clear_filter_graph(void)
 {
     kf_remove_all_filter_chains();
+    kpropagate_news_of_changed_filter_chains();
     this->graphicsScene->reset_scene();
     this->inputGateNodes.clear();
     this->numNodesAdded = 0;
@@ -60,6 +60,8 @@ OverlayDialog::OverlayDialog(QWidget *parent) :
 
                 add_action_to_menu(input, "Resolution", "$inputResolution");
                 add_action_to_menu(input, "Refresh rate (Hz)", "$inputHz");
+                add_action_to_menu(input, "Driver calls saved per second", "$savedDriverCalls");
+                add_action_to_menu(input, "Mode switch latency (ms)", "$modeSwitchLatencyMs");
 
                 add_action_to_menu(output, "Resolution", "$outputResolution");
                 add_action_to_menu(output, "Frame rate", "$outputFPS");
@@ -161,9 +163,8 @@ QString OverlayDialog::parsed_overlay_string(void)
 {
     QString parsed = ui->plainTextEdit->toPlainText();
 
-    /// TODO. I'm not totally sure how good, performance-wise, it is to poll the
-    /// capture hardware every frame. Depends on how the Datapath API caches this
-    /// info etc.
+    // Note: These status queries are served from the capture unit's status
+    // snapshot, so they don't poll the capture hardware.
     const auto inRes = kc_hardware().status.capture_resolution();
     const auto outRes = ks_output_resolution();
 
@@ -174,6 +175,8 @@ QString OverlayDialog::parsed_overlay_string(void)
     parsed.replace("$areFramesDropped", (kc_are_frames_being_dropped()? "Dropping frames" : ""));
     parsed.replace("$peakLatencyMs", QString::number(kd_peak_pipeline_latency()));
     parsed.replace("$averageLatencyMs", QString::number(kd_average_pipeline_latency()));
+    parsed.replace("$savedDriverCalls", QString::number(kd_saved_status_queries_per_second()));
+    parsed.replace("$modeSwitchLatencyMs", QString::number(kc_mode_switch_latency()));
     parsed.replace("$systemTime", QDateTime::currentDateTime().time().toString());
     parsed.replace("$systemDate", QDateTime::currentDateTime().date().toString());
 
@@ -18,6 +18,13 @@
 // The texture into which we'll stream the captured frames.
 GLuint FRAMEBUFFER_TEXTURE;
 
+// The version and resolution of the scaler output last uploaded into the frame
+// texture. While the output stays the same - e.g. because the capture source is
+// repeating its frames -, we can keep drawing the texture without re-uploading.
+bool FRAMEBUFFER_TEXTURE_IS_CURRENT = false;
+u32 FRAMEBUFFER_TEXTURE_VERSION = 0;
+resolution_s FRAMEBUFFER_TEXTURE_RES = {0, 0, 0};
+
 // The texture in which we'll display the current output overlay, if any.
 GLuint OVERLAY_TEXTURE;
 
@@ -49,6 +56,7 @@ void OGLWidget::initializeGL()
     this->glBindTexture(GL_TEXTURE_2D, FRAMEBUFFER_TEXTURE);
     this->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     this->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    FRAMEBUFFER_TEXTURE_IS_CURRENT = false;
 
     this->glGenTextures(1, &OVERLAY_TEXTURE);
     this->glBindTexture(GL_TEXTURE_2D, OVERLAY_TEXTURE);
@@ -85,7 +93,18 @@ void OGLWidget::paintGL()
         this->glDisable(GL_BLEND);
 
         this->glBindTexture(GL_TEXTURE_2D, FRAMEBUFFER_TEXTURE);
-        this->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, r.w, r.h, 0, GL_BGRA, GL_UNSIGNED_BYTE, fb);
+
+        if (!FRAMEBUFFER_TEXTURE_IS_CURRENT ||
+            (FRAMEBUFFER_TEXTURE_VERSION != ks_scaler_output_version()) ||
+            (FRAMEBUFFER_TEXTURE_RES.w != r.w) ||
+            (FRAMEBUFFER_TEXTURE_RES.h != r.h))
+        {
+            this->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, r.w, r.h, 0, GL_BGRA, GL_UNSIGNED_BYTE, fb);
+
+            FRAMEBUFFER_TEXTURE_IS_CURRENT = true;
+            FRAMEBUFFER_TEXTURE_VERSION = ks_scaler_output_version();
+            FRAMEBUFFER_TEXTURE_RES = r;
+        }
 
         glBegin(GL_TRIANGLES);
             glTexCoord2i(0, 0); glVertex2i(0,             0);
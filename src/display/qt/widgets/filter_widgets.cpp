@@ -164,12 +164,14 @@ void filter_widget_input_gate_s::create_widget(void)
     {
         k_assert(this->parameterArray, "Expected non-null filter data.");
          *(u16*)&(this->parameterArray[OFFS_WIDTH]) = newValue;
+         kf_refresh_filter_chain_gates();
     });
 
     connect(heightSpin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this](const int newValue)
     {
         k_assert(this->parameterArray, "Expected non-null filter data.");
          *(u16*)&(this->parameterArray[OFFS_HEIGHT]) = newValue;
+         kf_refresh_filter_chain_gates();
     });
 
     frame->adjustSize();
@@ -213,12 +215,14 @@ void filter_widget_output_gate_s::create_widget(void)
     {
         k_assert(this->parameterArray, "Expected non-null filter data.");
          *(u16*)&(this->parameterArray[OFFS_WIDTH]) = newValue;
+         kf_refresh_filter_chain_gates();
     });
 
     connect(heightSpin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this](const int newValue)
     {
         k_assert(this->parameterArray, "Expected non-null filter data.");
          *(u16*)&(this->parameterArray[OFFS_HEIGHT]) = newValue;
+         kf_refresh_filter_chain_gates();
     });
 
     frame->adjustSize();
@@ -25,6 +25,8 @@
 #include <QScreen>
 #include <QImage>
 #include <QLabel>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include "display/qt/subclasses/QOpenGLWidget_opengl_renderer.h"
 #include "display/qt/dialogs/output_resolution_dialog.h"
@@ -48,11 +50,16 @@
 #include "scaler/scaler.h"
 #include "ui_output_window.h"
 
-/// Temp. Stores the number of milliseconds passed for each frame update. This
-/// number includes everything done to the frame - capture, scaling, and display.
+/// Temp. The peak and average number of milliseconds between a frame's capture
+/// and its being handed over for display. This includes everything done to the
+/// frame, including any time it spent queued in the capture unit.
 int UPDATE_LATENCY_PEAK = 0;
 int UPDATE_LATENCY_AVG = 0;
 
+/// Temp. The number of capture hardware API calls per second that were avoided
+/// by serving status queries from the capture unit's status snapshot.
+int STATUS_QUERIES_SAVED_PER_SECOND = 0;
+
 /// Temporary.
 uint CURRENT_OUTPUT_FRAMERATE = 0;
 
@@ -164,9 +171,26 @@ MainWindow::MainWindow(QWidget *parent) :
                 c15->setCheckable(true);
                 colorDepth->addAction(c15);
 
-                connect(c24, &QAction::triggered, this, [=]{kc_set_input_color_depth(24);});
-                connect(c16, &QAction::triggered, this, [=]{kc_set_input_color_depth(16);});
-                connect(c15, &QAction::triggered, this, [=]{kc_set_input_color_depth(15);});
+                QAction *yuv = new QAction("16-bit (YUV 4:2:2)", this);
+                yuv->setActionGroup(group);
+                yuv->setCheckable(true);
+                yuv->setEnabled(kc_hardware().supports.yuv());
+                colorDepth->addAction(yuv);
+
+                colorDepth->addSeparator();
+
+                // Let VCS choose the cheapest color depth that the active
+                // filters accept.
+                QAction *automatic = new QAction("Automatic", this);
+                automatic->setActionGroup(group);
+                automatic->setCheckable(true);
+                colorDepth->addAction(automatic);
+
+                connect(c24, &QAction::triggered, this, [=]{kc_set_pixel_format_negotiation_enabled(false); kc_set_input_color_depth(24);});
+                connect(c16, &QAction::triggered, this, [=]{kc_set_pixel_format_negotiation_enabled(false); kc_set_input_color_depth(16);});
+                connect(c15, &QAction::triggered, this, [=]{kc_set_pixel_format_negotiation_enabled(false); kc_set_input_color_depth(15);});
+                connect(yuv, &QAction::triggered, this, [=]{kc_set_pixel_format_negotiation_enabled(false); kc_set_capture_pixel_format(RGB_PIXELFORMAT_YUY2);});
+                connect(automatic, &QAction::triggered, this, [=]{kc_set_pixel_format_negotiation_enabled(true);});
             }
 
             menu->addMenu(channel);
@@ -846,13 +870,16 @@ void MainWindow::paintEvent(QPaintEvent *)
     return;
 }
 
-// Call this once per frame and it'll derive the current frame rate.
+// Call this once per frame and it'll derive the current frame rate, and the
+// latency between the capture of the frames and their being handed over for
+// display.
 //
 void MainWindow::measure_framerate()
 {
-    static qint64 elapsed = 0, prevElapsed = 0;
-    static u32 peakProcessTime = 0, avgProcessTime = 0;
-    static u32 numFramesDrawn = 0;
+    static qint64 elapsed = 0;
+    static u32 peakLatency = 0, totalLatency = 0;
+    static u32 numFramesDrawn = 0, numLatencySamples = 0;
+    static std::chrono::steady_clock::time_point prevCaptureTimestamp;
 
     static QElapsedTimer fpsTimer;
     if (!fpsTimer.isValid())
@@ -862,12 +889,22 @@ void MainWindow::measure_framerate()
 
     elapsed = fpsTimer.elapsed();
 
-    if ((elapsed - prevElapsed) > peakProcessTime)
+    // Only sample the latency when there's a newly-captured frame to display,
+    // rather than on redraws of the same frame.
     {
-        peakProcessTime = (elapsed - prevElapsed);
-    }
+        const auto captureTimestamp = ks_scaler_output_meta().timestamp;
+
+        if (captureTimestamp != prevCaptureTimestamp)
+        {
+            const u32 latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - captureTimestamp).count();
 
-    avgProcessTime += (elapsed - prevElapsed);
+            peakLatency = std::max(peakLatency, latency);
+            totalLatency += latency;
+            numLatencySamples++;
+
+            prevCaptureTimestamp = captureTimestamp;
+        }
+    }
 
     numFramesDrawn++;
 
@@ -876,22 +913,21 @@ void MainWindow::measure_framerate()
     {
         const int fps = round(1000 / (real(elapsed) / numFramesDrawn));
 
-        UPDATE_LATENCY_AVG = (avgProcessTime / numFramesDrawn);
-        UPDATE_LATENCY_PEAK = peakProcessTime;
+        UPDATE_LATENCY_AVG = (numLatencySamples? (totalLatency / numLatencySamples) : 0);
+        UPDATE_LATENCY_PEAK = peakLatency;
+
+        STATUS_QUERIES_SAVED_PER_SECOND = round(kc_num_saved_status_queries() / (real(elapsed) / 1000));
+        kc_reset_saved_status_queries_count();
 
         this->update_output_framerate(fps, kc_are_frames_being_dropped());
         kc_reset_missed_frames_count();
 
         numFramesDrawn = 0;
-        avgProcessTime = 0;
-        peakProcessTime = 0;
-        prevElapsed = 0;
+        numLatencySamples = 0;
+        totalLatency = 0;
+        peakLatency = 0;
         fpsTimer.restart();
     }
-    else
-    {
-        prevElapsed = elapsed;
-    }
 
     return;
 }
@@ -1123,11 +1159,12 @@ void MainWindow::update_recording_metainfo(void)
     return;
 }
 
-void MainWindow::update_gui_state()
+void MainWindow::update_gui_state(const bool waitForEvents)
 {
     // Manually spin the event loop.
     QCoreApplication::sendPostedEvents();
-    QCoreApplication::processEvents();
+    QCoreApplication::processEvents(waitForEvents? QEventLoop::WaitForMoreEvents
+                                                 : QEventLoop::AllEvents);
 
     return;
 }
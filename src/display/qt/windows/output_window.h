@@ -38,7 +38,7 @@ public:
     ~MainWindow();
 
     // Gets user input in the GUI, etc.
-    void update_gui_state(void);
+    void update_gui_state(const bool waitForEvents);
 
     // Returns true if the window has a border.
     bool window_has_border(void);
@@ -0,0 +1,222 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS active area detection
+ *
+ * Finds the part of captured frames that contains the image, i.e. the area
+ * inside any black borders; e.g. 640 x 400 of content centered in a 720 x 480
+ * capture. Only this active area then needs to go through anti-tearing, the
+ * filters, and scaling, with the borders filled in as black in the output.
+ *
+ * The area is measured every so often with kf_find_black_borders(), and locked
+ * onto once several consecutive measurements agree on it. So that no part of
+ * the image is ever left out, each frame's borders - the parts of it outside
+ * the locked area - are verified to be black before the area is applied to it,
+ * to within the noise of a black signal rather than by the looser black level
+ * of the measurements; if they aren't, the frame is processed in full, and the
+ * area is measured anew.
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include "common/command_line.h"
+#include "filter/active_area.h"
+#include "common/globals.h"
+#include "filter/filter.h"
+
+// Every how many frames the active area is measured; or 0 if frames are always
+// processed in full.
+static uint INTERVAL = 0;
+
+// How many consecutive measurements must agree on the active area for it to be
+// locked onto. Measurements agree if none of the area's edges differs between
+// them by more than the given number of pixels; the locked area then covers
+// them all.
+static const uint NUM_AGREEING_MEASUREMENTS_REQD = 3;
+static const uint MAX_EDGE_DIFFERENCE = 2;
+
+// An active area covering more than this fraction (in percent) of the frame
+// isn't locked onto, as processing it rather than the whole frame would save
+// too little to be worth it.
+static const uint MAX_AREA_PERCENT = 90;
+
+// The level above which a color channel of a pixel in a frame's borders counts as
+// part of the image when verifying that the borders are black. Kept to just above
+// the noise of a black signal, so that dark parts of the image - which measuring
+// the area with kf_find_black_borders() may take for black border - never get
+// left out.
+static const u8 BORDER_NOISE_LEVEL = 4;
+
+// The active area currently locked onto, if any, and the frame size it's for.
+static bool IS_LOCKED = false;
+static frame_area_s LOCKED_AREA = {0, 0, 0, 0};
+static resolution_s LOCKED_RES = {0, 0, 0};
+
+// The area that the most recent measurements agree on, the frame size they were
+// made at, and how many of them there have been.
+static frame_area_s CANDIDATE_AREA = {0, 0, 0, 0};
+static resolution_s CANDIDATE_RES = {0, 0, 0};
+static uint NUM_AGREEING_MEASUREMENTS = 0;
+
+// The number of frames since the active area was last measured.
+static uint NUM_FRAMES_SINCE_MEASUREMENT = 0;
+
+void karea_initialize(void)
+{
+    INTERVAL = kcom_active_area_interval();
+
+    if (INTERVAL)
+    {
+        INFO(("Processing only the active area of frames, measuring it every %u frames.", INTERVAL));
+    }
+
+    return;
+}
+
+bool karea_is_enabled(void)
+{
+    return (INTERVAL > 0);
+}
+
+// Returns true if the parts of the given frame outside the given area are all
+// black.
+//
+static bool is_black_outside_area(const u8 *const pixels, const resolution_s &r, const frame_area_s &area)
+{
+    // The rows above and below the area are contiguous in memory, so they can
+    // be checked as single spans.
+    if (!kf_is_black_span(pixels, (area.y * r.w), BORDER_NOISE_LEVEL) ||
+        !kf_is_black_span((pixels + ((area.y + area.h) * r.w * 4)), ((r.h - area.y - area.h) * r.w), BORDER_NOISE_LEVEL))
+    {
+        return false;
+    }
+
+    for (uint y = area.y; y < (area.y + area.h); y++)
+    {
+        const u8 *const row = (pixels + (y * r.w * 4));
+
+        if (!kf_is_black_span(row, area.x, BORDER_NOISE_LEVEL) ||
+            !kf_is_black_span((row + ((area.x + area.w) * 4)), (r.w - area.x - area.w), BORDER_NOISE_LEVEL))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Measures the active area of the given frame, and updates the candidate area
+// with it.
+//
+static void measure_active_area(const u8 *const pixels, const resolution_s &r)
+{
+    const black_borders_s borders = kf_find_black_borders(pixels, r);
+
+    NUM_FRAMES_SINCE_MEASUREMENT = 0;
+
+    // An all-black frame tells nothing of where the image is.
+    if (((borders.left + 1) >= r.w) ||
+        ((borders.top + 1) >= r.h))
+    {
+        return;
+    }
+
+    const frame_area_s area = {borders.left,
+                               borders.top,
+                               (uint(r.w) - borders.left - borders.right),
+                               (uint(r.h) - borders.top - borders.bottom)};
+
+    const auto differs_by = [](const uint a, const uint b)
+    {
+        return uint(std::abs(int(a) - int(b)));
+    };
+
+    if (NUM_AGREEING_MEASUREMENTS &&
+        (r.w == CANDIDATE_RES.w) &&
+        (r.h == CANDIDATE_RES.h) &&
+        (differs_by(area.x, CANDIDATE_AREA.x) <= MAX_EDGE_DIFFERENCE) &&
+        (differs_by(area.y, CANDIDATE_AREA.y) <= MAX_EDGE_DIFFERENCE) &&
+        (differs_by((area.x + area.w), (CANDIDATE_AREA.x + CANDIDATE_AREA.w)) <= MAX_EDGE_DIFFERENCE) &&
+        (differs_by((area.y + area.h), (CANDIDATE_AREA.y + CANDIDATE_AREA.h)) <= MAX_EDGE_DIFFERENCE))
+    {
+        const uint right = std::max((area.x + area.w), (CANDIDATE_AREA.x + CANDIDATE_AREA.w));
+        const uint bottom = std::max((area.y + area.h), (CANDIDATE_AREA.y + CANDIDATE_AREA.h));
+
+        CANDIDATE_AREA.x = std::min(area.x, CANDIDATE_AREA.x);
+        CANDIDATE_AREA.y = std::min(area.y, CANDIDATE_AREA.y);
+        CANDIDATE_AREA.w = (right - CANDIDATE_AREA.x);
+        CANDIDATE_AREA.h = (bottom - CANDIDATE_AREA.y);
+
+        NUM_AGREEING_MEASUREMENTS++;
+    }
+    else
+    {
+        CANDIDATE_AREA = area;
+        CANDIDATE_RES = r;
+        NUM_AGREEING_MEASUREMENTS = 1;
+    }
+
+    if ((NUM_AGREEING_MEASUREMENTS >= NUM_AGREEING_MEASUREMENTS_REQD) &&
+        ((CANDIDATE_AREA.w * CANDIDATE_AREA.h * 100) <= (r.w * r.h * MAX_AREA_PERCENT)))
+    {
+        if (!IS_LOCKED ||
+            (CANDIDATE_AREA.x != LOCKED_AREA.x) ||
+            (CANDIDATE_AREA.y != LOCKED_AREA.y) ||
+            (CANDIDATE_AREA.w != LOCKED_AREA.w) ||
+            (CANDIDATE_AREA.h != LOCKED_AREA.h))
+        {
+            DEBUG(("Locking onto an active area of %u x %u at %u, %u.",
+                   CANDIDATE_AREA.w, CANDIDATE_AREA.h, CANDIDATE_AREA.x, CANDIDATE_AREA.y));
+        }
+
+        IS_LOCKED = true;
+        LOCKED_AREA = CANDIDATE_AREA;
+        LOCKED_RES = r;
+    }
+
+    return;
+}
+
+// To be called once per processed frame, with the frame's pixels in BGRA. Returns
+// true if only the given frame's active area needs processing, in which case the
+// area is returned via the 'area' parameter; or false if the frame should be
+// processed in full.
+//
+bool karea_find_active_area(const u8 *const pixels, const resolution_s &r, frame_area_s *const area)
+{
+    k_assert((r.bpp == 32), "Expected 32-bit pixel data for finding the active area.");
+
+    if (!INTERVAL)
+    {
+        return false;
+    }
+
+    if (++NUM_FRAMES_SINCE_MEASUREMENT >= INTERVAL)
+    {
+        measure_active_area(pixels, r);
+    }
+
+    if (!IS_LOCKED)
+    {
+        return false;
+    }
+
+    if ((r.w != LOCKED_RES.w) ||
+        (r.h != LOCKED_RES.h) ||
+        !is_black_outside_area(pixels, r, LOCKED_AREA))
+    {
+        DEBUG(("The image has left the active area. Processing frames in full."));
+
+        IS_LOCKED = false;
+        NUM_AGREEING_MEASUREMENTS = 0;
+
+        // Start looking for the new area right away.
+        measure_active_area(pixels, r);
+
+        return false;
+    }
+
+    *area = LOCKED_AREA;
+
+    return true;
+}
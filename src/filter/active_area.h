@@ -0,0 +1,27 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef ACTIVE_AREA_H
+#define ACTIVE_AREA_H
+
+#include "common/globals.h"
+
+// A rectangular area of a frame, in pixels.
+struct frame_area_s
+{
+    uint x;
+    uint y;
+    uint w;
+    uint h;
+};
+
+void karea_initialize(void);
+
+bool karea_is_enabled(void);
+
+bool karea_find_active_area(const u8 *const pixels, const resolution_s &r, frame_area_s *const area);
+
+#endif
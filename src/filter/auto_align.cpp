@@ -0,0 +1,269 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS continuous capture alignment
+ *
+ * Keeps the captured image aligned with the edges of the capture screen as the
+ * alignment drifts - e.g. with an analog source's timing -, by measuring every
+ * so often how far the image is out of alignment, and adjusting the capture's
+ * position to correct it.
+ *
+ * The measuring is done on a worker thread, on a copy of every nth frame, so
+ * that it never holds up the processing of frames. Corrections are applied
+ * with hysteresis: an offset must be at least a couple of pixels, and must be
+ * measured the same in several consecutive scans, before the capture is
+ * adjusted; so that noise along the image's edges, or a scene briefly going
+ * dark at one edge, doesn't have the capture wander about.
+ *
+ */
+
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include "common/command_line.h"
+#include "common/propagate.h"
+#include "filter/auto_align.h"
+#include "common/globals.h"
+#include "common/memory.h"
+#include "filter/filter.h"
+
+// Every how many frames the alignment is measured; or 0 if continuous alignment
+// is disabled.
+static uint INTERVAL = 0;
+
+// The smallest offset, in pixels, that gets corrected.
+static const uint MIN_OFFSET = 2;
+
+// The largest offset that gets corrected, as a fraction of the frame's width or
+// height. Larger offsets are more likely to be due to the image itself having
+// a dark edge than to drift.
+static const uint MAX_OFFSET_DIVISOR = 16;
+
+// How many consecutive scans must measure the same offset for it to be
+// corrected.
+static const uint NUM_AGREEING_SCANS_REQD = 3;
+
+// The worker thread, and what's shared with it. A frame submitted for scanning
+// belongs to the worker until its borders have been found.
+static std::thread WORKER;
+static std::mutex WORKER_MUTEX;
+static std::condition_variable WORKER_WAKEUP;
+static bool STOP_WORKER = false;
+static bool IS_SCAN_PENDING = false;
+static bool HAS_SCAN_RESULT = false;
+static heap_bytes_s<u8> SCAN_FRAME;
+static resolution_s SCAN_FRAME_RES = {0, 0, 0};
+static black_borders_s SCAN_RESULT = {0, 0, 0, 0};
+
+// The number of frames processed since a frame was last submitted for scanning.
+static uint NUM_FRAMES_SINCE_SUBMIT = 0;
+
+// The offset most recently measured, the resolution of the frame it was
+// measured on, and in how many consecutive scans it's been measured.
+static int CANDIDATE_OFFSET[2] = {0, 0};
+static resolution_s CANDIDATE_RES = {0, 0, 0};
+static uint NUM_AGREEING_SCANS = 0;
+
+static void scan_frames(void)
+{
+    std::unique_lock<std::mutex> lock(WORKER_MUTEX);
+
+    while (true)
+    {
+        WORKER_WAKEUP.wait(lock, []{ return (STOP_WORKER || IS_SCAN_PENDING); });
+
+        if (STOP_WORKER)
+        {
+            break;
+        }
+
+        lock.unlock();
+        const black_borders_s borders = kf_find_black_borders(SCAN_FRAME.ptr(), SCAN_FRAME_RES);
+        lock.lock();
+
+        SCAN_RESULT = borders;
+        HAS_SCAN_RESULT = true;
+        IS_SCAN_PENDING = false;
+    }
+
+    return;
+}
+
+void kalign_initialize(void)
+{
+    INTERVAL = kcom_auto_align_interval();
+
+    if (!INTERVAL)
+    {
+        return;
+    }
+
+    INFO(("Aligning the capture continuously, measuring every %u frames.", INTERVAL));
+
+    SCAN_FRAME.alloc(MAX_FRAME_SIZE, "Auto-alignment buffer");
+
+    STOP_WORKER = false;
+    WORKER = std::thread(scan_frames);
+
+    return;
+}
+
+void kalign_release(void)
+{
+    if (!WORKER.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(WORKER_MUTEX);
+        STOP_WORKER = true;
+    }
+
+    WORKER_WAKEUP.notify_one();
+    WORKER.join();
+
+    SCAN_FRAME.release_memory();
+
+    return;
+}
+
+bool kalign_is_enabled(void)
+{
+    return (INTERVAL > 0);
+}
+
+// Returns true if a frame is due to be submitted for scanning, i.e. if the
+// next frame to be processed should be passed to kalign_submit_frame().
+//
+bool kalign_wants_frame(void)
+{
+    if (!INTERVAL ||
+        (NUM_FRAMES_SINCE_SUBMIT < INTERVAL))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(WORKER_MUTEX);
+
+    return (!IS_SCAN_PENDING && !HAS_SCAN_RESULT);
+}
+
+// Hands a copy of the given frame, which is expected to be in BGRA and at the
+// capture resolution, to the worker thread for scanning.
+//
+void kalign_submit_frame(const u8 *const pixels, const resolution_s &r)
+{
+    k_assert((r.bpp == 32), "Expected 32-bit pixel data for auto-alignment.");
+
+    if (!kalign_wants_frame() ||
+        ((r.w * r.h * (r.bpp / 8)) > SCAN_FRAME.size()))
+    {
+        return;
+    }
+
+    // The worker isn't touching the buffer while there's no scan pending.
+    memcpy(SCAN_FRAME.ptr(), pixels, (r.w * r.h * (r.bpp / 8)));
+    SCAN_FRAME_RES = r;
+
+    {
+        std::lock_guard<std::mutex> lock(WORKER_MUTEX);
+        IS_SCAN_PENDING = true;
+    }
+
+    WORKER_WAKEUP.notify_one();
+
+    NUM_FRAMES_SINCE_SUBMIT = 0;
+
+    return;
+}
+
+// Returns the offset along one axis that the given black borders at its near
+// and far edges indicate, or 0 if there's nothing to correct. The image is
+// expected to reach past one edge of the screen: if there's a border at both
+// edges, or the frame is black all the way across, the offset can't be told.
+//
+static int axis_offset(const uint nearBorder, const uint farBorder, const uint size)
+{
+    const int offset = (nearBorder? int(nearBorder) : -int(farBorder));
+
+    if ((nearBorder && farBorder) ||
+        ((std::max(nearBorder, farBorder) + 1) >= size) ||
+        (uint(std::abs(offset)) < MIN_OFFSET) ||
+        (uint(std::abs(offset)) > (size / MAX_OFFSET_DIVISOR)))
+    {
+        return 0;
+    }
+
+    return offset;
+}
+
+// To be called once per frame that's processed. Applies the result of the most
+// recent scan, if there's a new one, and counts down towards the next scan.
+//
+void kalign_update_alignment(void)
+{
+    black_borders_s borders;
+    resolution_s r;
+
+    if (!INTERVAL)
+    {
+        return;
+    }
+
+    NUM_FRAMES_SINCE_SUBMIT++;
+
+    {
+        std::lock_guard<std::mutex> lock(WORKER_MUTEX);
+
+        if (!HAS_SCAN_RESULT)
+        {
+            return;
+        }
+
+        borders = SCAN_RESULT;
+        r = SCAN_FRAME_RES;
+        HAS_SCAN_RESULT = false;
+    }
+
+    {
+        const int offset[2] = {axis_offset(borders.left, borders.right, r.w),
+                               axis_offset(borders.top, borders.bottom, r.h)};
+
+        if (!offset[0] && !offset[1])
+        {
+            NUM_AGREEING_SCANS = 0;
+            return;
+        }
+
+        if ((offset[0] == CANDIDATE_OFFSET[0]) &&
+            (offset[1] == CANDIDATE_OFFSET[1]) &&
+            (r.w == CANDIDATE_RES.w) &&
+            (r.h == CANDIDATE_RES.h))
+        {
+            NUM_AGREEING_SCANS++;
+        }
+        else
+        {
+            CANDIDATE_OFFSET[0] = offset[0];
+            CANDIDATE_OFFSET[1] = offset[1];
+            CANDIDATE_RES = r;
+            NUM_AGREEING_SCANS = 1;
+        }
+
+        if (NUM_AGREEING_SCANS >= NUM_AGREEING_SCANS_REQD)
+        {
+            DEBUG(("Correcting the capture's alignment by %d, %d.", offset[0], offset[1]));
+
+            kpropagate_capture_alignment_adjust(offset[0], offset[1]);
+
+            // The correction invalidates the offsets measured so far.
+            NUM_AGREEING_SCANS = 0;
+            CANDIDATE_OFFSET[0] = CANDIDATE_OFFSET[1] = 0;
+        }
+    }
+
+    return;
+}
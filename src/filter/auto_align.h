@@ -0,0 +1,24 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef AUTO_ALIGN_H
+#define AUTO_ALIGN_H
+
+#include "common/globals.h"
+
+void kalign_initialize(void);
+
+void kalign_release(void);
+
+bool kalign_is_enabled(void);
+
+bool kalign_wants_frame(void);
+
+void kalign_submit_frame(const u8 *const pixels, const resolution_s &r);
+
+void kalign_update_alignment(void);
+
+#endif
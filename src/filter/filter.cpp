@@ -8,11 +8,15 @@
  */
 
 #include <unordered_map>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 #include <ctime>
 #include <cmath>
 #include <map>
+#if __SSE2__
+    #include <emmintrin.h>
+#endif
 #include "display/qt/widgets/filter_widgets.h"
 #include "display/display.h"
 #include "capture/capture.h"
@@ -27,6 +31,10 @@
 
 static bool FILTERING_ENABLED = false;
 
+// The level above which we consider a pixel's color value to be not part of the
+// black background; e.g. when looking for black borders around the image.
+static const u8 BLACK_LEVEL = 50;
+
 // Note: all filter functions expect the input pixels to be in 32-bit color.
 static void filter_func_blur(FILTER_FUNC_PARAMS);
 static void filter_func_unique_count(FILTER_FUNC_PARAMS);
@@ -44,7 +52,7 @@ static void filter_func_rotate(FILTER_FUNC_PARAMS);
 // Invoke this macro at the start of each filter_func_*() function, to verify
 // that the parameters passed are valid to operate on.
 #define VALIDATE_FILTER_INPUT  k_assert(r->bpp == 32, "This filter expects 32-bit source color.");\
-                               if (pixels == nullptr || params == nullptr || r == nullptr) return;
+                               if (pixels == nullptr || plan == nullptr || r == nullptr) return;
 
 // All filter types available to the user.
 //
@@ -77,15 +85,98 @@ const uint NUM_COLOR_CHANNELS = (32 / 8);
 // All filters the user has added to the filter graph.
 static std::vector<filter_c*> FILTER_POOL;
 
-// Sets of filters, starting with an input gate, followed by a number of filters,
-// and ending with an output gate. These chains will be used to filter incoming
-// frames.
-static std::vector<std::vector<const filter_c*>> FILTER_CHAINS;
+// A filter of a filter chain as prepared for applying to frames: its parameters
+// decoded from the filter's parameter bytes, and whatever it keeps from frame to
+// frame. Each chain has a plan of its own for each of its filters; so that e.g.
+// two chains sharing a temporal denoiser don't mix up each other's frames.
+struct filter_plan_s
+{
+    const filter_c *filter;
+
+    // The parameter bytes that the parameters were decoded from. If the user
+    // changes the filter's parameters, they're decoded anew.
+    u8 decodedParameterData[FILTER_PARAMETER_ARRAY_LENGTH];
+
+    union
+    {
+        struct { u8 type; real kernelSize; u8 boxKernelWidth; } blur;
+        struct { u8 threshold; u8 corner; } uniqueCount;
+        struct { u8 h; u8 hColor; u8 templateWindowSize; u8 searchWindowSize; } denoiseNonlocalMeans;
+        struct { u8 threshold; } denoiseTemporal;
+        struct { real strength; real radius; } unsharpMask;
+        struct { u8 factor; u8 type; } decimate;
+        struct { uint x; uint y; uint w; uint h; int scaler; } crop;
+        struct { int axis; } flip;
+        struct { double angle; double scale; } rotate;
+        struct { u8 kernelSize; } median;
+    } params;
+
+    // For filters that compare each frame against the previous one, the
+    // previous frame's pixels. Sized by the frames the chain is given.
+    std::vector<u8> prevPixels;
+
+    // For the unique count filter.
+    u32 uniqueFramesProcessed;
+    u32 uniqueFramesPerSecond;
+    time_t timer;
+
+#ifdef USE_OPENCV
+    // An intermediate image, kept from frame to frame so that it needn't be
+    // reallocated for each one.
+    cv::Mat scratch;
+
+    // For the rotate filter, the transform as made for frames of transformRes.
+    cv::Mat transform;
+    resolution_s transformRes;
+#endif
+};
+
+// A filter chain as prepared for applying to frames: an input gate, followed by
+// a number of filters, and ending with an output gate.
+struct filter_chain_plan_s
+{
+    const filter_c *inputGate;
+    const filter_c *outputGate;
+
+    // The gates' sizes, as decoded from their parameters. A size of 0 in either
+    // dimension means any.
+    resolution_s inputGateRes;
+    resolution_s outputGateRes;
+
+    // The filters between the gates.
+    std::vector<filter_plan_s> filters;
+};
+
+// The filter chains as prepared for one capture source's frames. Each capture
+// source has a set of its own, so that the filters that keep something from frame
+// to frame (e.g. the temporal denoiser) don't mix up different sources' frames.
+// The set in use is that of the capture source being processed; see
+// kc_active_source_idx().
+struct filter_pipeline_s
+{
+    // The filter chains that will be used to filter incoming frames.
+    std::vector<filter_chain_plan_s> chains;
+
+    // For each combination of frame and output resolution that frames have been
+    // filtered at, the index in the list of filter chains of the chain that
+    // applies to it, or -1 if none does; so that the chain needn't be looked for
+    // again each frame. Forgotten when the chains or their gates change.
+    std::unordered_map<u64, int> chainForResolutions;
+
+    // The index in the list of filter chains of the chain that was most recently
+    // used. Generally, this will be the filter chain that matches the current
+    // input/output resolution.
+    int mostRecentChainIdx = -1;
+};
+
+static filter_pipeline_s PIPELINES[MAX_INPUT_CHANNELS];
 
-// The index in the list of filter chains of the chain that was most recently used.
-// Generally, this will be the filter chain that matches the current input/output
-// resolution.
-static int MOST_RECENT_FILTER_CHAIN_IDX = -1;
+// Returns the filter chains of the capture source that's being processed.
+//
+static filter_pipeline_s& pipeline(void)
+{
+    return PIPELINES[kc_active_source_idx()];
+}
 
 std::string kf_filter_name_for_type(const filter_type_enum_e type)
 {
@@ -127,82 +218,239 @@ std::string kf_filter_id_for_type(const filter_type_enum_e type)
     return "(unknown)";
 }
 
-// Apply to the given pixel buffer the chain of filters (if any) whose input gate
-// matches the frame's resolution and output gate that of the current output resolution.
-void kf_apply_filter_chain(u8 *const pixels, const resolution_s &r)
+// Returns the index in the list of filter chains of the first chain, if any,
+// whose input and output gates match the given frame and output resolution. If
+// no such chain is found, returns the index of a matching partially or fully
+// open chain (a chain being open if its input or output gate's resolution
+// contains one or more 0 values); or, failing that, -1.
+//
+static int find_filter_chain(const resolution_s &inputRes, const resolution_s &outputRes)
 {
-    if (!FILTERING_ENABLED) return;
-
-    k_assert((r.bpp == 32), "Filters can only be applied to 32-bit pixel data.");
-
-    std::pair<const std::vector<const filter_c*>*, unsigned> partialMatch = {nullptr, 0};
-    std::pair<const std::vector<const filter_c*>*, unsigned> openMatch = {nullptr, 0};
-    const resolution_s outputRes = ks_output_resolution();
+    const std::vector<filter_chain_plan_s> &chains = pipeline().chains;
+    int partialMatchIdx = -1;
+    int openMatchIdx = -1;
 
-    static const auto apply_chain = [=](const std::vector<const filter_c*> &chain, const unsigned idx)
+    for (unsigned i = 0; i < chains.size(); i++)
     {
-        // The gate filters are expected to be #first and #last, while the actual
-        // applicable filters are the ones in-between.
-        for (unsigned c = 1; c < (chain.size() - 1); c++)
+        const resolution_s &inputGate = chains[i].inputGateRes;
+        const resolution_s &outputGate = chains[i].outputGateRes;
+
+        // A gate size of 0 in either dimension means pass all values. Otherwise, the
+        // value must match the corresponding size of the frame or output.
+        if (!inputGate.w &&
+            !inputGate.h &&
+            !outputGate.w &&
+            !outputGate.h)
+        {
+            openMatchIdx = i;
+        }
+        else if ((!inputGate.w || inputGate.w == inputRes.w) &&
+                 (!inputGate.h || inputGate.h == inputRes.h) &&
+                 (!outputGate.w || outputGate.w == outputRes.w) &&
+                 (!outputGate.h || outputGate.h == outputRes.h))
+        {
+            partialMatchIdx = i;
+        }
+        else if ((inputRes.w == inputGate.w) &&
+                 (inputRes.h == inputGate.h) &&
+                 (outputRes.w == outputGate.w) &&
+                 (outputRes.h == outputGate.h))
         {
-            chain[c]->metaData.apply(pixels, &r, chain[c]->parameterData.ptr());
+            return i;
         }
+    }
 
-        MOST_RECENT_FILTER_CHAIN_IDX = idx;
+    return ((partialMatchIdx >= 0)? partialMatchIdx : openMatchIdx);
+}
 
-        return;
-    };
+// Decodes the filter's parameters from its parameter bytes into the plan.
+//
+static void decode_filter_parameters(filter_plan_s *const plan)
+{
+    const u8 *const params = plan->filter->parameterData.ptr();
 
-    // Apply the first filter chain, if any, whose input and output resolution matches
-    // those of the frame and the current scaler. If no such chain is found, we'll secondarily
-    // apply a matching partially or fully open chain (a chain being open if its input or
-    // output node's resolution contains one or more 0 values).
-    for (unsigned i = 0; i < FILTER_CHAINS.size(); i++)
-    {
-        const auto &filterChain = FILTER_CHAINS[i];
+    memcpy(plan->decodedParameterData, params, FILTER_PARAMETER_ARRAY_LENGTH);
 
-        const unsigned inputGateWidth = *(u16*)&(filterChain.front()->parameterData[0]);
-        const unsigned inputGateHeight = *(u16*)&(filterChain.front()->parameterData[2]);
+    switch (plan->filter->metaData.type)
+    {
+        case filter_type_enum_e::blur:
+        {
+            plan->params.blur.type = params[filter_widget_blur_s::OFFS_TYPE];
+            plan->params.blur.kernelSize = (params[filter_widget_blur_s::OFFS_KERNEL_SIZE] / 10.0);
+            plan->params.blur.boxKernelWidth = ((int(plan->params.blur.kernelSize) * 2) + 1);
+            break;
+        }
+        case filter_type_enum_e::unique_count:
+        {
+            plan->params.uniqueCount.threshold = params[filter_widget_unique_count_s::OFFS_THRESHOLD];
+            plan->params.uniqueCount.corner = params[filter_widget_unique_count_s::OFFS_CORNER];
+            break;
+        }
+        case filter_type_enum_e::denoise_nonlocal_means:
+        {
+            plan->params.denoiseNonlocalMeans.h = params[filter_widget_denoise_nonlocal_means_s::OFFS_H];
+            plan->params.denoiseNonlocalMeans.hColor = params[filter_widget_denoise_nonlocal_means_s::OFFS_H_COLOR];
+            plan->params.denoiseNonlocalMeans.templateWindowSize = params[filter_widget_denoise_nonlocal_means_s::OFFS_TEMPLATE_WINDOW_SIZE];
+            plan->params.denoiseNonlocalMeans.searchWindowSize = params[filter_widget_denoise_nonlocal_means_s::OFFS_SEARCH_WINDOW_SIZE];
+            break;
+        }
+        case filter_type_enum_e::denoise_temporal:
+        {
+            plan->params.denoiseTemporal.threshold = params[filter_widget_denoise_temporal_s::OFFS_THRESHOLD];
+            break;
+        }
+        case filter_type_enum_e::unsharp_mask:
+        {
+            plan->params.unsharpMask.strength = (params[filter_widget_unsharp_mask_s::OFFS_STRENGTH] / 100.0);
+            plan->params.unsharpMask.radius = (params[filter_widget_unsharp_mask_s::OFFS_RADIUS] / 10.0);
+            break;
+        }
+        case filter_type_enum_e::decimate:
+        {
+            plan->params.decimate.factor = params[filter_widget_decimate_s::OFFS_FACTOR];
+            plan->params.decimate.type = params[filter_widget_decimate_s::OFFS_TYPE];
+            break;
+        }
+        case filter_type_enum_e::crop:
+        {
+            plan->params.crop.x = *(u16*)&(params[filter_widget_crop_s::OFFS_X]);
+            plan->params.crop.y = *(u16*)&(params[filter_widget_crop_s::OFFS_Y]);
+            plan->params.crop.w = *(u16*)&(params[filter_widget_crop_s::OFFS_WIDTH]);
+            plan->params.crop.h = *(u16*)&(params[filter_widget_crop_s::OFFS_HEIGHT]);
 
-        const unsigned outputGateWidth = *(u16*)&(filterChain.back()->parameterData[0]);
-        const unsigned outputGateHeight = *(u16*)&(filterChain.back()->parameterData[2]);
+            #ifdef USE_OPENCV
+                switch (params[filter_widget_crop_s::OFFS_SCALER])
+                {
+                    case 0: plan->params.crop.scaler = cv::INTER_LINEAR; break;
+                    case 1: plan->params.crop.scaler = cv::INTER_NEAREST; break;
+                    case 2: plan->params.crop.scaler = -1 /*Don't scale.*/; break;
+                    default: k_assert(0, "Unknown scaler type for the crop filter."); break;
+                }
+            #endif
 
-        // A gate size of 0 in either dimension means pass all values. Otherwise, the
-        // value must match the corresponding size of the frame or output.
-        if (!inputGateWidth &&
-            !inputGateHeight &&
-            !outputGateWidth &&
-            !outputGateHeight)
+            break;
+        }
+        case filter_type_enum_e::flip:
         {
-            openMatch = {&filterChain, i};
+            // 0 = vertical, 1 = horizontal, -1 = both.
+            plan->params.flip.axis = ((params[filter_widget_flip_s::OFFS_AXIS] == 2)? -1 : params[filter_widget_flip_s::OFFS_AXIS]);
+            break;
         }
-        else if ((!inputGateWidth || inputGateWidth == r.w) &&
-                 (!inputGateHeight || inputGateHeight == r.h) &&
-                 (!outputGateWidth || outputGateWidth == outputRes.w) &&
-                 (!outputGateHeight || outputGateHeight == outputRes.h))
+        case filter_type_enum_e::rotate:
         {
-            partialMatch = {&filterChain, i};
+            plan->params.rotate.angle = (*(i16*)&(params[filter_widget_rotate_s::OFFS_ROT]) / 10.0);
+            plan->params.rotate.scale = (*(i16*)&(params[filter_widget_rotate_s::OFFS_SCALE]) / 100.0);
+            break;
         }
-        else if ((r.w == inputGateWidth) &&
-                 (r.h == inputGateHeight) &&
-                 (outputRes.w == outputGateWidth) &&
-                 (outputRes.h == outputGateHeight))
+        case filter_type_enum_e::median:
         {
-            apply_chain(filterChain, i);
-
-            return;
+            plan->params.median.kernelSize = params[filter_widget_median_s::OFFS_KERNEL_SIZE];
+            break;
         }
+        default: break;
+    }
+
+#ifdef USE_OPENCV
+    // A transform made with the previous parameters no longer applies.
+    plan->transform.release();
+#endif
+
+    return;
+}
+
+// Decodes the sizes of the given chain's gates from the gates' parameters.
+//
+static void decode_gate_sizes(filter_chain_plan_s *const chain)
+{
+    const u8 *const inputParams = chain->inputGate->parameterData.ptr();
+    const u8 *const outputParams = chain->outputGate->parameterData.ptr();
+
+    chain->inputGateRes = {*(u16*)&(inputParams[filter_widget_input_gate_s::OFFS_WIDTH]),
+                           *(u16*)&(inputParams[filter_widget_input_gate_s::OFFS_HEIGHT]),
+                           0};
+
+    chain->outputGateRes = {*(u16*)&(outputParams[filter_widget_output_gate_s::OFFS_WIDTH]),
+                            *(u16*)&(outputParams[filter_widget_output_gate_s::OFFS_HEIGHT]),
+                            0};
+
+    return;
+}
+
+// Returns the plan's buffer for the previous frame's pixels, sized for frames of
+// the given resolution. If the previous frame was of another size, the buffer is
+// cleared.
+//
+static u8* previous_frame_pixels(filter_plan_s *const plan, const resolution_s &r)
+{
+    const uint frameSize = (r.w * r.h * (r.bpp / 8));
+
+    if (plan->prevPixels.size() != frameSize)
+    {
+        plan->prevPixels.assign(frameSize, 0);
     }
 
-    if (partialMatch.first)
+    return plan->prevPixels.data();
+}
+
+// Returns the index in the given pipeline's list of filter chains of the chain
+// that applies to frames of the given resolution at the given output resolution,
+// or -1 if none does; looking for it only if it hasn't been already.
+//
+static int filter_chain_for_resolutions(filter_pipeline_s &p, const resolution_s &inputRes, const resolution_s &outputRes)
+{
+    const u64 resolutionsKey = ((u64(inputRes.w) << 48) | (u64(inputRes.h) << 32) | (u64(outputRes.w) << 16) | u64(outputRes.h));
+
+    auto chainForResolutions = p.chainForResolutions.find(resolutionsKey);
+
+    if (chainForResolutions == p.chainForResolutions.end())
     {
-        apply_chain(*partialMatch.first, partialMatch.second);
+        chainForResolutions = p.chainForResolutions.insert({resolutionsKey, find_filter_chain(inputRes, outputRes)}).first;
     }
-    else if (openMatch.first)
+
+    return chainForResolutions->second;
+}
+
+// Finds ahead of time the filter chain, if any, that applies to frames of the
+// given resolution at the given output resolution; e.g. on a video mode switch,
+// so that the first frame in the new mode needn't wait for it.
+//
+void kf_prepare_filter_chain(const resolution_s &inputRes, const resolution_s &outputRes)
+{
+    filter_chain_for_resolutions(pipeline(), inputRes, outputRes);
+
+    return;
+}
+
+// Apply to the given pixel buffer the chain of filters (if any) whose input gate
+// matches the frame's resolution and output gate that of the current output resolution.
+// The frame's pixels may be just the part of it that contains the image, in which
+// case the chain is still chosen by the size of the whole frame (inputRes).
+void kf_apply_filter_chain(u8 *const pixels, const resolution_s &r, const resolution_s &inputRes)
+{
+    if (!FILTERING_ENABLED) return;
+
+    k_assert((r.bpp == 32), "Filters can only be applied to 32-bit pixel data.");
+
+    filter_pipeline_s &p = pipeline();
+    const int chainIdx = filter_chain_for_resolutions(p, inputRes, ks_output_resolution());
+
+    if (chainIdx < 0)
     {
-        apply_chain(*openMatch.first, openMatch.second);
+        return;
     }
 
+    for (filter_plan_s &filterPlan: p.chains[chainIdx].filters)
+    {
+        if (memcmp(filterPlan.decodedParameterData, filterPlan.filter->parameterData.ptr(), FILTER_PARAMETER_ARRAY_LENGTH) != 0)
+        {
+            decode_filter_parameters(&filterPlan);
+        }
+
+        filterPlan.filter->metaData.apply(pixels, &r, &filterPlan);
+    }
+
+    p.mostRecentChainIdx = chainIdx;
+
     return;
 }
 
@@ -225,15 +473,60 @@ void kf_add_filter_chain(std::vector<const filter_c*> newChain)
              (newChain.at(newChain.size()-1)->metaData.type == filter_type_enum_e::output_gate),
              "Detected a malformed filter chain.");
 
-    FILTER_CHAINS.push_back(newChain);
+    filter_chain_plan_s chain;
+
+    chain.inputGate = newChain.front();
+    chain.outputGate = newChain.back();
+    decode_gate_sizes(&chain);
+
+    for (unsigned i = 1; i < (newChain.size() - 1); i++)
+    {
+        filter_plan_s filterPlan;
+
+        filterPlan.filter = newChain[i];
+        filterPlan.uniqueFramesProcessed = 0;
+        filterPlan.uniqueFramesPerSecond = 0;
+        filterPlan.timer = time(NULL);
+        decode_filter_parameters(&filterPlan);
+
+        chain.filters.push_back(filterPlan);
+    }
+
+    for (filter_pipeline_s &p: PIPELINES)
+    {
+        p.chains.push_back(chain);
+        p.chainForResolutions.clear();
+    }
 
     return;
 }
 
 void kf_remove_all_filter_chains(void)
 {
-    FILTER_CHAINS.clear();
-    MOST_RECENT_FILTER_CHAIN_IDX = -1;
+    for (filter_pipeline_s &p: PIPELINES)
+    {
+        p.chains.clear();
+        p.chainForResolutions.clear();
+        p.mostRecentChainIdx = -1;
+    }
+
+    return;
+}
+
+// To be called when the size of one of the filter graph's gates has changed; so
+// that the chains are matched to frames by their gates' new sizes.
+//
+void kf_refresh_filter_chain_gates(void)
+{
+    for (filter_pipeline_s &p: PIPELINES)
+    {
+        for (filter_chain_plan_s &chain: p.chains)
+        {
+            decode_gate_sizes(&chain);
+        }
+
+        p.chainForResolutions.clear();
+    }
 
     return;
 }
@@ -298,7 +591,7 @@ void kf_release_filters(void)
 {
     DEBUG(("Releasing custom filtering."));
 
-    MOST_RECENT_FILTER_CHAIN_IDX = -1;
+    kf_remove_all_filter_chains();
 
     for (auto filter: FILTER_POOL)
     {
@@ -317,14 +610,14 @@ static void filter_func_unique_count(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    static heap_bytes_s<u8> prevPixels(MAX_FRAME_SIZE, "Unique count filter buffer");
+    u8 *const prevPixels = previous_frame_pixels(plan, *r);
 
-    const u8 threshold = params[filter_widget_unique_count_s::OFFS_THRESHOLD];
-    const u8 corner = params[filter_widget_unique_count_s::OFFS_CORNER];
+    const u8 threshold = plan->params.uniqueCount.threshold;
+    const u8 corner = plan->params.uniqueCount.corner;
 
-    static u32 uniqueFramesProcessed = 0;
-    static u32 uniqueFramesPerSecond = 0;
-    static time_t timer = time(NULL);
+    u32 &uniqueFramesProcessed = plan->uniqueFramesProcessed;
+    u32 &uniqueFramesPerSecond = plan->uniqueFramesPerSecond;
+    time_t &timer = plan->timer;
 
     for (u32 i = 0; i < (r->w * r->h); i++)
     {
@@ -340,7 +633,7 @@ static void filter_func_unique_count(FILTER_FUNC_PARAMS)
         }
     }
 
-    memcpy(prevPixels.ptr(), pixels, prevPixels.up_to(r->w * r->h * (r->bpp / 8)));
+    memcpy(prevPixels, pixels, (r->w * r->h * (r->bpp / 8)));
 
     const double secsElapsed = difftime(time(NULL), timer);
     if (secsElapsed >= 1)
@@ -386,10 +679,10 @@ static void filter_func_denoise_nonlocal_means(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
     #if USE_OPENCV
-        const u8 h = params[filter_widget_denoise_nonlocal_means_s::OFFS_H];
-        const u8 hColor = params[filter_widget_denoise_nonlocal_means_s::OFFS_H_COLOR];
-        const u8 templateWindowSize = params[filter_widget_denoise_nonlocal_means_s::OFFS_TEMPLATE_WINDOW_SIZE];
-        const u8 searchWindowSize = params[filter_widget_denoise_nonlocal_means_s::OFFS_SEARCH_WINDOW_SIZE];
+        const u8 h = plan->params.denoiseNonlocalMeans.h;
+        const u8 hColor = plan->params.denoiseNonlocalMeans.hColor;
+        const u8 templateWindowSize = plan->params.denoiseNonlocalMeans.templateWindowSize;
+        const u8 searchWindowSize = plan->params.denoiseNonlocalMeans.searchWindowSize;
 
         cv::Mat input = cv::Mat(r->h, r->w, CV_8UC4, pixels);
         cv::fastNlMeansDenoisingColored(input, input, h, hColor, templateWindowSize, searchWindowSize);
@@ -406,8 +699,8 @@ static void filter_func_denoise_temporal(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    const u8 threshold = params[filter_widget_denoise_temporal_s::OFFS_THRESHOLD];
-    static heap_bytes_s<u8> prevPixels(MAX_FRAME_SIZE, "Denoising filter buffer");
+    const u8 threshold = plan->params.denoiseTemporal.threshold;
+    u8 *const prevPixels = previous_frame_pixels(plan, *r);
 
     for (uint i = 0; i < (r->h * r->w); i++)
     {
@@ -440,7 +733,7 @@ static void filter_func_delta_histogram(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    static heap_bytes_s<u8> prevFramePixels(MAX_FRAME_SIZE, "Delta histogram buffer");
+    u8 *const prevFramePixels = previous_frame_pixels(plan, *r);
 
     const uint numBins = 512;
 
@@ -489,7 +782,7 @@ static void filter_func_delta_histogram(FILTER_FUNC_PARAMS)
         cv::line(output, cv::Point(x1, y1r), cv::Point(x2, y2r), cv::Scalar(0, 0, 255), 2, CV_AA);
     }
 
-    memcpy(prevFramePixels.ptr(), pixels, prevFramePixels.up_to(r->w * r->h * (r->bpp / 8)));
+    memcpy(prevFramePixels, pixels, (r->w * r->h * (r->bpp / 8)));
 #endif
 
     return;
@@ -500,14 +793,12 @@ static void filter_func_unsharp_mask(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    static heap_bytes_s<u8> TMP_BUF(MAX_FRAME_SIZE, "Unsharp mask buffer");
-    const real str = params[filter_widget_unsharp_mask_s::OFFS_STRENGTH] / 100.0;
-    const real rad = params[filter_widget_unsharp_mask_s::OFFS_RADIUS] / 10.0;
+    const real str = plan->params.unsharpMask.strength;
+    const real rad = plan->params.unsharpMask.radius;
 
-    cv::Mat tmp = cv::Mat(r->h, r->w, CV_8UC4, TMP_BUF.ptr());
     cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
-    cv::GaussianBlur(output, tmp, cv::Size(0, 0), rad);
-    cv::addWeighted(output, 1 + str, tmp, -str, 0, output);
+    cv::GaussianBlur(output, plan->scratch, cv::Size(0, 0), rad);
+    cv::addWeighted(output, 1 + str, plan->scratch, -str, 0, output);
 #endif
 
     return;
@@ -518,11 +809,11 @@ static void filter_func_sharpen(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    float kernel[] = { 0, -1,  0,
-                      -1,  5, -1,
-                       0, -1,  0};
+    static float kernel[] = { 0, -1,  0,
+                             -1,  5, -1,
+                              0, -1,  0};
 
-    cv::Mat ker = cv::Mat(3, 3, CV_32F, &kernel);
+    static const cv::Mat ker = cv::Mat(3, 3, CV_32F, &kernel);
     cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
     cv::filter2D(output, output, -1, ker);
 #endif
@@ -537,8 +828,8 @@ static void filter_func_decimate(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    const u8 factor = params[filter_widget_decimate_s::OFFS_FACTOR];
-    const u8 type = params[filter_widget_decimate_s::OFFS_TYPE];
+    const u8 factor = plan->params.decimate.factor;
+    const u8 type = plan->params.decimate.type;
 
     for (u32 y = 0; y < r->h; y += factor)
     {
@@ -597,20 +888,13 @@ static void filter_func_crop(FILTER_FUNC_PARAMS)
 {
     VALIDATE_FILTER_INPUT
 
-    uint x = *(u16*)&(params[filter_widget_crop_s::OFFS_X]);
-    uint y = *(u16*)&(params[filter_widget_crop_s::OFFS_Y]);
-    uint w = *(u16*)&(params[filter_widget_crop_s::OFFS_WIDTH]);
-    uint h = *(u16*)&(params[filter_widget_crop_s::OFFS_HEIGHT]);
+    const uint x = plan->params.crop.x;
+    const uint y = plan->params.crop.y;
+    const uint w = plan->params.crop.w;
+    const uint h = plan->params.crop.h;
 
     #ifdef USE_OPENCV
-        int scaler = -1;
-        switch (params[filter_widget_crop_s::OFFS_SCALER])
-        {
-            case 0: scaler = cv::INTER_LINEAR; break;
-            case 1: scaler = cv::INTER_NEAREST; break;
-            case 2: scaler = -1 /*Don't scale.*/; break;
-            default: k_assert(0, "Unknown scaler type for the crop filter."); break;
-        }
+        const int scaler = plan->params.crop.scaler;
 
         if (((x + w) > r->w) || ((y + h) > r->h))
         {
@@ -620,7 +904,9 @@ static void filter_func_crop(FILTER_FUNC_PARAMS)
         else
         {
             cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
-            cv::Mat cropped = output(cv::Rect(x, y, w, h)).clone();
+            cv::Mat &cropped = plan->scratch;
+
+            output(cv::Rect(x, y, w, h)).copyTo(cropped);
 
             // If the user doesn't want scaling, just append some black borders around the
             // cropping. Otherwise, stretch the cropped region to fill the entire frame.
@@ -643,17 +929,14 @@ static void filter_func_flip(FILTER_FUNC_PARAMS)
 {
     VALIDATE_FILTER_INPUT
 
-    static heap_bytes_s<u8> scratch(MAX_FRAME_SIZE, "Flip filter scratch buffer");
-
     // 0 = vertical, 1 = horizontal, -1 = both.
-    const uint axis = ((params[filter_widget_flip_s::OFFS_AXIS] == 2)? -1 : params[filter_widget_flip_s::OFFS_AXIS]);
+    const int axis = plan->params.flip.axis;
 
     #ifdef USE_OPENCV
         cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
-        cv::Mat temp = cv::Mat(r->h, r->w, CV_8UC4, scratch.ptr());
 
-        cv::flip(output, temp, axis);
-        temp.copyTo(output);
+        cv::flip(output, plan->scratch, axis);
+        plan->scratch.copyTo(output);
     #else
         (void)axis;
     #endif
@@ -665,18 +948,24 @@ static void filter_func_rotate(FILTER_FUNC_PARAMS)
 {
     VALIDATE_FILTER_INPUT
 
-    static heap_bytes_s<u8> scratch(MAX_FRAME_SIZE, "Rotate filter scratch buffer");
-
-    const double angle = (*(i16*)&(params[filter_widget_rotate_s::OFFS_ROT]) / 10.0);
-    const double scale = (*(i16*)&(params[filter_widget_rotate_s::OFFS_SCALE]) / 100.0);
+    const double angle = plan->params.rotate.angle;
+    const double scale = plan->params.rotate.scale;
 
     #ifdef USE_OPENCV
         cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
-        cv::Mat temp = cv::Mat(r->h, r->w, CV_8UC4, scratch.ptr());
 
-        cv::Mat transf = cv::getRotationMatrix2D(cv::Point2d((r->w / 2), (r->h / 2)), -angle, scale);
-        cv::warpAffine(output, temp, transf, cv::Size(r->w, r->h));
-        temp.copyTo(output);
+        // The transform depends only on the parameters and the frame size, so it's
+        // only made anew when either changes.
+        if (plan->transform.empty() ||
+            (plan->transformRes.w != r->w) ||
+            (plan->transformRes.h != r->h))
+        {
+            plan->transform = cv::getRotationMatrix2D(cv::Point2d((r->w / 2), (r->h / 2)), -angle, scale);
+            plan->transformRes = *r;
+        }
+
+        cv::warpAffine(output, plan->scratch, plan->transform, cv::Size(r->w, r->h));
+        plan->scratch.copyTo(output);
     #else
         (void)angle;
         (void)scale;
@@ -690,7 +979,7 @@ static void filter_func_median(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    const u8 kernelS = params[filter_widget_median_s::OFFS_KERNEL_SIZE];
+    const u8 kernelS = plan->params.median.kernelSize;
 
     cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
     cv::medianBlur(output, output, kernelS);
@@ -704,17 +993,17 @@ static void filter_func_blur(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    const real kernelS = (params[filter_widget_blur_s::OFFS_KERNEL_SIZE] / 10.0);
+    const real kernelS = plan->params.blur.kernelSize;
 
     cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
 
-    if (params[filter_widget_blur_s::OFFS_TYPE] == filter_widget_blur_s::FILTER_TYPE_GAUSSIAN)
+    if (plan->params.blur.type == filter_widget_blur_s::FILTER_TYPE_GAUSSIAN)
     {
         cv::GaussianBlur(output, output, cv::Size(0, 0), kernelS);
     }
     else
     {
-        const u8 kernelW = ((int(kernelS) * 2) + 1);
+        const u8 kernelW = plan->params.blur.boxKernelWidth;
         cv::blur(output, output, cv::Size(kernelW, kernelW));
     }
 #endif
@@ -729,92 +1018,213 @@ void kf_set_filtering_enabled(const bool enabled)
     return;
 }
 
+// Returns true if any of the filters currently being applied to frames needs
+// the frames' full color information; i.e. analyzes their colors, rather than
+// just transforming them, so that capturing in a format of reduced color
+// resolution - e.g. YUV 4:2:2 - would skew its results.
+//
+bool kf_active_filters_need_full_color(void)
+{
+    if (!FILTERING_ENABLED)
+    {
+        return false;
+    }
+
+    for (const auto &chain: pipeline().chains)
+    {
+        for (const filter_plan_s &filterPlan: chain.filters)
+        {
+            const filter_c *const filter = filterPlan.filter;
+
+            if ((filter->metaData.type == filter_type_enum_e::unique_count) ||
+                (filter->metaData.type == filter_type_enum_e::delta_histogram))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Returns true if any of the filters currently being applied to frames needs
+// the frames in full, rather than just the part of them containing the image;
+// i.e. operates on given coordinates (e.g. crop, flip), or on the frame as a
+// whole (e.g. unique count).
+//
+bool kf_active_filters_need_full_frame(void)
+{
+    if (!FILTERING_ENABLED)
+    {
+        return false;
+    }
+
+    for (const auto &chain: pipeline().chains)
+    {
+        for (const filter_plan_s &filterPlan: chain.filters)
+        {
+            switch (filterPlan.filter->metaData.type)
+            {
+                case filter_type_enum_e::unique_count:
+                case filter_type_enum_e::delta_histogram:
+                case filter_type_enum_e::decimate:
+                case filter_type_enum_e::crop:
+                case filter_type_enum_e::flip:
+                case filter_type_enum_e::rotate: return true;
+                default: break;
+            }
+        }
+    }
+
+    return false;
+}
+
 bool kf_is_filtering_enabled(void)
 {
     return FILTERING_ENABLED;
 }
 
-// Find by how many pixels the given image is out of alignment with the
-// edges of the capture screen vertically and horizontally, by counting how
-// many vertical/horizontal columns/rows at the edges of the image contain
-// nothing but black pixels. This is an estimate and not necessarily accurate -
-// depending on the image, it may be grossly inaccurate. The vector returned
-// contains as two components the image's alignment offset on the vertical
-// and horizontal axes.
+// Finds how many all-black columns and rows there are at each edge of the given
+// image; i.e. columns and rows in which no pixel's color channel rises above the
+// level of the black background. At most all but one of the columns and rows are
+// counted from each edge.
 //
-// This will not work if the image is fully contained within the capture screen -
-// at least one edge of the image is expected to fall outside of the screen.
-std::vector<int> kf_find_capture_alignment(u8 *const pixels, const resolution_s &r)
+// The image is scanned row by row in a single pass, taking for each byte column
+// its maximum over the rows, and for each row its maximum over the color bytes;
+// so that memory is read sequentially, rather than striding down each column in
+// turn.
+//
+black_borders_s kf_find_black_borders(const u8 *const pixels, const resolution_s &r)
 {
-    k_assert((r.bpp == 32), "Expected 32-bit pixel data for finding image alignment.");
+    k_assert((r.bpp == 32), "Expected 32-bit pixel data for finding black borders.");
 
-    // The level above which we consider a pixel's color value to be not part
-    // of the black background.
-    const int threshold = 50;
+    const uint rowSize = (r.w * 4);
+    std::vector<u8> columnMax(rowSize, 0);
+    std::vector<u8> rowMax(r.h, 0);
+    black_borders_s borders = {0, 0, 0, 0};
 
-    const auto find_horizontal = [r, pixels, threshold](int x, int limit, int direction)->uint
+    for (uint y = 0; y < r.h; y++)
     {
-        uint steps = 0;
-        while (x != limit)
+        const u8 *const row = (pixels + (y * rowSize));
+        uint i = 0;
+
+#if __SSE2__
         {
-            for (uint y = 0; y < r.h; y++)
+            // Leaves out each pixel's alpha byte.
+            const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+            __m128i rowAcc = _mm_setzero_si128();
+
+            for (; (i + 16) <= rowSize; i += 16)
             {
-                // If any pixel on this vertical column is above the threshold,
-                // consider the column to be part of the image rather than of
-                // the background.
-                const uint idx = ((x + y * r.w) * 4);
-                if (pixels[idx + 0] > threshold ||
-                    pixels[idx + 1] > threshold ||
-                    pixels[idx + 2] > threshold)
-                {
-                    goto done;
-                }
+                const __m128i bytes = _mm_loadu_si128((const __m128i*)(row + i));
+                const __m128i colAcc = _mm_loadu_si128((const __m128i*)(columnMax.data() + i));
+
+                _mm_storeu_si128((__m128i*)(columnMax.data() + i), _mm_max_epu8(colAcc, bytes));
+                rowAcc = _mm_max_epu8(rowAcc, _mm_and_si128(bytes, colorMask));
             }
 
-            steps++;
-            x += direction;
+            rowAcc = _mm_max_epu8(rowAcc, _mm_srli_si128(rowAcc, 8));
+            rowAcc = _mm_max_epu8(rowAcc, _mm_srli_si128(rowAcc, 4));
+            rowAcc = _mm_max_epu8(rowAcc, _mm_srli_si128(rowAcc, 2));
+            rowAcc = _mm_max_epu8(rowAcc, _mm_srli_si128(rowAcc, 1));
+
+            rowMax[y] = u8(_mm_cvtsi128_si32(rowAcc));
         }
+#endif
 
-        done:
-        return steps;
+        for (; i < rowSize; i++)
+        {
+            columnMax[i] = std::max(columnMax[i], row[i]);
+
+            if ((i % 4) != 3)
+            {
+                rowMax[y] = std::max(rowMax[y], row[i]);
+            }
+        }
+    }
+
+    const auto is_black_column = [&](const uint x)
+    {
+        return ((columnMax[(x * 4) + 0] <= BLACK_LEVEL) &&
+                (columnMax[(x * 4) + 1] <= BLACK_LEVEL) &&
+                (columnMax[(x * 4) + 2] <= BLACK_LEVEL));
     };
 
-    const auto find_vertical = [r, pixels, threshold](int y, int limit, int direction)->uint
+    const auto is_black_row = [&](const uint y)
+    {
+        return (rowMax[y] <= BLACK_LEVEL);
+    };
+
+    while (((borders.left + 1) < r.w) && is_black_column(borders.left))                  borders.left++;
+    while (((borders.right + 1) < r.w) && is_black_column(r.w - 1 - borders.right))      borders.right++;
+    while (((borders.top + 1) < r.h) && is_black_row(borders.top))                       borders.top++;
+    while (((borders.bottom + 1) < r.h) && is_black_row(r.h - 1 - borders.bottom))       borders.bottom++;
+
+    return borders;
+}
+
+// Returns true if none of the given consecutive 32-bit pixels has a color channel
+// above the given black level.
+//
+bool kf_is_black_span(const u8 *const pixels, const uint numPixels, const u8 blackLevel)
+{
+    const uint numBytes = (numPixels * 4);
+    uint i = 0;
+
+#if __SSE2__
     {
-        uint steps = 0;
-        while (y != limit)
+        const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+        const __m128i maxLevel = _mm_set1_epi8(char(blackLevel));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+
+        for (; (i + 16) <= numBytes; i += 16)
         {
-            for (uint x = 0; x < r.w; x++)
-            {
-                const uint idx = ((x + y * r.w) * 4);
-                if (pixels[idx + 0] > threshold ||
-                    pixels[idx + 1] > threshold ||
-                    pixels[idx + 2] > threshold)
-                {
-                    goto done;
-                }
-            }
+            acc = _mm_max_epu8(acc, _mm_and_si128(_mm_loadu_si128((const __m128i*)(pixels + i)), colorMask));
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(acc, maxLevel), zero)) != 0xffff)
+        {
+            return false;
+        }
+    }
+#endif
 
-            steps++;
-            y += direction;
+    for (; i < numBytes; i++)
+    {
+        if (((i % 4) != 3) &&
+            (pixels[i] > blackLevel))
+        {
+            return false;
         }
+    }
 
-        done:
-        return steps;
-    };
+    return true;
+}
+
+// Find by how many pixels the given image is out of alignment with the
+// edges of the capture screen vertically and horizontally, by counting how
+// many vertical/horizontal columns/rows at the edges of the image contain
+// nothing but black pixels. This is an estimate and not necessarily accurate -
+// depending on the image, it may be grossly inaccurate. The vector returned
+// contains as two components the image's alignment offset on the vertical
+// and horizontal axes.
+//
+// This will not work if the image is fully contained within the capture screen -
+// at least one edge of the image is expected to fall outside of the screen.
+std::vector<int> kf_find_capture_alignment(u8 *const pixels, const resolution_s &r)
+{
+    k_assert((r.bpp == 32), "Expected 32-bit pixel data for finding image alignment.");
 
-    int left = find_horizontal(0, r.w-1, +1);
-    int right = find_horizontal(r.w-1, 0, -1);
-    int top = find_vertical(0, r.h-1, +1);
-    int bottom = find_vertical(r.h-1, 0, -1);
+    const black_borders_s borders = kf_find_black_borders(pixels, r);
 
-    return {(left? left : -right),
-            (top? top : -bottom)};
+    return {(borders.left? int(borders.left) : -int(borders.right)),
+            (borders.top? int(borders.top) : -int(borders.bottom))};
 }
 
 int kf_current_filter_chain_idx(void)
 {
-    return MOST_RECENT_FILTER_CHAIN_IDX;
+    return pipeline().mostRecentChainIdx;
 }
 
 void kf_initialize_filters(void)
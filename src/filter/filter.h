@@ -12,10 +12,21 @@
 #include "common/globals.h"
 
 struct filter_widget_s;
+struct filter_plan_s;
+
+// The number of all-black columns or rows at each edge of an image. See
+// kf_find_black_borders().
+struct black_borders_s
+{
+    uint left;
+    uint right;
+    uint top;
+    uint bottom;
+};
 
 // The signature of the function of a filter which applies that function to the
-// given pixels.
-#define FILTER_FUNC_PARAMS u8 *const pixels, const resolution_s *const r, const u8 *const params
+// given pixels, with the filter's parameters and state as given in its plan.
+#define FILTER_FUNC_PARAMS u8 *const pixels, const resolution_s *const r, filter_plan_s *const plan
 typedef void(*filter_function_t)(FILTER_FUNC_PARAMS);
 
 enum class filter_type_enum_e
@@ -76,6 +87,8 @@ void kf_add_filter_chain(std::vector<const filter_c*> newChain);
 
 void kf_remove_all_filter_chains(void);
 
+void kf_refresh_filter_chain_gates(void);
+
 std::string kf_filter_name_for_type(const filter_type_enum_e type);
 
 std::string kf_filter_name_for_id(const std::string id);
@@ -84,7 +97,9 @@ std::string kf_filter_id_for_type(const filter_type_enum_e type);
 
 filter_type_enum_e kf_filter_type_for_id(const std::string id);
 
-void kf_apply_filter_chain(u8 *const pixels, const resolution_s &r);
+void kf_apply_filter_chain(u8 *const pixels, const resolution_s &r, const resolution_s &inputRes);
+
+void kf_prepare_filter_chain(const resolution_s &inputRes, const resolution_s &outputRes);
 
 std::vector<const filter_meta_s*> kf_known_filter_types(void);
 
@@ -99,6 +114,14 @@ void kf_set_filtering_enabled(const bool enabled);
 
 bool kf_is_filtering_enabled(void);
 
+bool kf_active_filters_need_full_color(void);
+
+bool kf_active_filters_need_full_frame(void);
+
+bool kf_is_black_span(const u8 *const pixels, const uint numPixels, const u8 blackLevel);
+
+black_borders_s kf_find_black_borders(const u8 *const pixels, const resolution_s &r);
+
 std::vector<int> kf_find_capture_alignment(u8 *const pixels, const resolution_s &r);
 
 #endif
@@ -4,12 +4,12 @@
  *
  */
 
-#include <chrono>
-#include <thread>
 #include <mutex>
 #include "display/qt/windows/output_window.h"
 #include "common/command_line.h"
+#include "filter/active_area.h"
 #include "filter/anti_tear.h"
+#include "filter/auto_align.h"
 #include "common/propagate.h"
 #include "capture/capture.h"
 #include "display/display.h"
@@ -31,13 +31,22 @@ static void cleanup_all(void)
 {
     INFO(("Received orders to exit. Initiating cleanup."));
 
+    // Release the capture first, so that its threads - which wake the display's
+    // event loop as they receive frames - have stopped by the time the display
+    // is released.
+    kc_release_capture();
     kd_release_output_window();
     ks_release_scaler();
-    kc_release_capture();
     kat_release_anti_tear();
     kf_release_filters();
+    kalign_release();
 
-    if (krecord_is_recording()) krecord_stop_recording();
+    // Each capture source may be being recorded.
+    for (uint i = 0; i < kc_num_capture_sources(); i++)
+    {
+        kc_activate_source(i);
+        if (krecord_is_recording()) krecord_stop_recording();
+    }
 
     // Call this last.
     kmem_deallocate_memory_cache();
@@ -52,6 +61,8 @@ static bool initialize_all(void)
     if (!PROGRAM_EXIT_REQUESTED) kc_initialize_capture();
     if (!PROGRAM_EXIT_REQUESTED) kat_initialize_anti_tear();
     if (!PROGRAM_EXIT_REQUESTED) kf_initialize_filters();
+    if (!PROGRAM_EXIT_REQUESTED) kalign_initialize();
+    if (!PROGRAM_EXIT_REQUESTED) karea_initialize();
 
     // Ideally, do these last.
     if (!PROGRAM_EXIT_REQUESTED)
@@ -65,27 +76,9 @@ static bool initialize_all(void)
 
 static capture_event_e process_next_capture_event(void)
 {
-    // Normally, the capture card's output rate limits the program's frame rate;
-    // but if the program is built without capture functionality, the rate needs
-    // to be limited artificially.
-    #if !USE_RGBEASY_API
-        static auto startTime_ = std::chrono::system_clock::now();
-        std::chrono::duration<double> timeDelta_ = (std::chrono::system_clock::now() - startTime_);
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(timeDelta_).count() <= 16)
-        {
-            return capture_event_e::none;
-        }
-        else startTime_ = std::chrono::system_clock::now();
-    #endif
-
     std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
 
-    #if USE_RGBEASY_API
-        const capture_event_e e = kc_latest_capture_event();
-    #else
-        const capture_event_e e = capture_event_e::new_frame;
-        kc_insert_test_image();
-    #endif
+    const capture_event_e e = kc_latest_capture_event();
 
     switch (e)
     {
@@ -115,15 +108,9 @@ static capture_event_e process_next_capture_event(void)
             break;
         }
         case capture_event_e::sleep:
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(4)); /// TODO. Is 4 the best wait-time?
-
-            break;
-        }
         case capture_event_e::none:
         {
-            /// TODO. Technically we might loop until we get an event other than
-            /// none, but for now we just move on.
+            // The main loop will wait for the next event.
 
             break;
         }
@@ -137,6 +124,68 @@ static capture_event_e process_next_capture_event(void)
     return e;
 }
 
+// Processes the next capture event, if any, of each of the capture sources other
+// than the selected one; e.g. so that their frames can be recorded while the
+// selected source is being displayed. Returns true if there was any event to
+// process.
+static bool process_next_background_capture_events(void)
+{
+    std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+
+    bool hadEvents = false;
+
+    for (uint i = 0; i < kc_num_capture_sources(); i++)
+    {
+        if (i == kc_selected_source_idx())
+        {
+            continue;
+        }
+
+        kc_activate_source(i);
+
+        switch (kc_latest_capture_event())
+        {
+            case capture_event_e::unrecoverable_error:
+            {
+                kpropagate_news_of_unrecoverable_error();
+                break;
+            }
+            case capture_event_e::new_frame:
+            {
+                kpropagate_news_of_new_background_frame();
+                hadEvents = true;
+                break;
+            }
+            case capture_event_e::new_video_mode:
+            {
+                kpropagate_news_of_new_background_video_mode();
+                hadEvents = true;
+                break;
+            }
+            case capture_event_e::no_signal:
+            case capture_event_e::invalid_signal:
+            {
+                kpropagate_news_of_background_signal_loss();
+                break;
+            }
+            case capture_event_e::sleep:
+            case capture_event_e::none:
+            {
+                break;
+            }
+
+            default:
+            {
+                k_assert(0, "Unrecognized capture event.");
+            }
+        }
+    }
+
+    kc_activate_source(kc_selected_source_idx());
+
+    return hadEvents;
+}
+
 // Load in any data files that the user requested via the command-line.
 static void load_user_data(void)
 {
@@ -194,8 +243,15 @@ int main(int argc, char *argv[])
     INFO(("Entering the main loop."));
     while (!PROGRAM_EXIT_REQUESTED)
     {
-        process_next_capture_event();
-        kd_spin_event_loop();
+        const capture_event_e e = process_next_capture_event();
+        const bool hadBackgroundEvents = process_next_background_capture_events();
+
+        // Unless there's more capture data already waiting to be processed,
+        // block until either the capture hardware or the GUI has something for
+        // us to do. The capture hardware's callbacks wake us up via
+        // kd_wake_event_loop().
+        kd_spin_event_loop(((e == capture_event_e::none) || (e == capture_event_e::sleep)) &&
+                           !hadBackgroundEvents);
     }
 
     cleanup_all();
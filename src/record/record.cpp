@@ -14,7 +14,11 @@
 #include <QElapsedTimer>
 #include <QFileInfo>
 #include <QFuture>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
 #include "common/propagate.h"
+#include "capture/capture.h"
 #include "display/display.h"
 #include "common/globals.h"
 #include "scaler/scaler.h"
@@ -25,8 +29,6 @@
     #include <opencv2/core/core.hpp>
     #include <opencv2/imgproc/imgproc.hpp>
     #include <opencv2/videoio/videoio.hpp>
-
-    static cv::VideoWriter VIDEO_WRITER;
 #endif
 
 // The maximum number of frames that can fit into a frame buffer.
@@ -35,7 +37,7 @@ static const uint FRAME_BUFFER_CAPACITY = 60;
 // Used to keep track of the recording's frame rate. Counts the number
 // of frames captured between two points in time, and derives from that
 // and the amount of time elapsed an estimate of the frame rate.
-static struct framerate_estimator_s
+struct framerate_estimator_s
 {
     uint prevFrameCount = 0;
     double fps = 0;
@@ -65,8 +67,7 @@ static struct framerate_estimator_s
     {
         return this->fps;
     }
-
-} FRAMERATE_ESTIMATE;
+};
 
 // Incoming frames will first be accumulated into a frame buffer; and when the buffer
 // is full, encoded into the video file.
@@ -80,7 +81,8 @@ struct frame_buffer_s
     // How many frames the frame buffer is currently storing.
     uint numFrames = 0;
 
-    // A timestamp of roughly when the corresponding frame was captured.
+    // When the corresponding frame was captured, in nanoseconds since the
+    // recording was started.
     std::vector<i64> frameTimestamps;
 
     // How many frames in total the buffer has memory capacity for.
@@ -140,13 +142,23 @@ struct frame_buffer_s
     // capacity to hold the pixels of a single frame.
     u8* next_slot(const i64 timestamp)
     {
-        k_assert((this->numFrames < this->maxNumFrames), "Overflowing the video recording frame buffer.");
-
-        const uint offset = ((this->frameResolution.w * this->frameResolution.h * 3) * this->numFrames);
+        u8 *const slot = this->upcoming_slot();
 
         this->frameTimestamps.at(this->numFrames) = timestamp;
         this->numFrames++;
 
+        return slot;
+    }
+
+    // Returns the area of the frame buffer that the next call to next_slot()
+    // will return, without taking it into use; e.g. for a frame's pixels to be
+    // put there before the frame is added.
+    u8* upcoming_slot(void) const
+    {
+        k_assert((this->numFrames < this->maxNumFrames), "Overflowing the video recording frame buffer.");
+
+        const uint offset = ((this->frameResolution.w * this->frameResolution.h * 3) * this->numFrames);
+
         return (memoryPool + offset);
     }
 
@@ -163,7 +175,12 @@ struct frame_buffer_s
     }
 };
 
-static struct recording_s
+// A recording of one capture source's frames. Each capture source can be recorded
+// into a video of its own, the background sources' frames being recorded as they
+// get processed; and the recording in use is that of the capture source being
+// processed - see kc_active_source_idx() -, which from the GUI's point of view
+// is the selected source.
+struct recording_s
 {
     // Accumulate the captured frames in two back buffers. When one buffer
     // fills up, we'll flip the buffers and encode the filled-up one's frames
@@ -178,6 +195,12 @@ static struct recording_s
     // We'll run the recording's video encoding in a separate thread.
     QFuture<void> encoderThread;
 
+#ifdef USE_OPENCV
+    cv::VideoWriter videoWriter;
+#endif
+
+    framerate_estimator_s framerateEstimate;
+
     // If true, frames will be inserted into the video in linear time, not as
     // they come in. For instance, if the input FPS is 55 and the video's playback
     // rate is set to 60, linear insertion tries to ensure that frames are duplicated
@@ -202,8 +225,21 @@ static struct recording_s
 
         // Milliseconds passed since the recording was started.
         QElapsedTimer recordingTimer;
+
+        // When the recording was started. The frames are timed relative to this
+        // by when they were captured.
+        std::chrono::steady_clock::time_point startTimestamp;
     } meta;
-} RECORDING;
+};
+
+static recording_s RECORDINGS[MAX_INPUT_CHANNELS];
+
+// Returns the recording of the capture source that's being processed.
+//
+static recording_s& recording(void)
+{
+    return RECORDINGS[kc_active_source_idx()];
+}
 
 // Prepare the OpenCV video writer for recording frames into a video.
 // Returns true if successful, false otherwise.
@@ -225,7 +261,9 @@ bool krecord_start_recording(const char *const filename,
 
     return false;
 #else
-    k_assert(!VIDEO_WRITER.isOpened(),
+    recording_s &rec = recording();
+
+    k_assert(!rec.videoWriter.isOpened(),
              "Attempting to intialize a recording that has already been initialized.");
 
     if ((width % 2 != 0) || (height % 2 != 0))
@@ -243,19 +281,20 @@ bool krecord_start_recording(const char *const filename,
         return false;
     }
 
-    RECORDING.meta.filename = filename;
-    RECORDING.meta.resolution = {width, height, 24};
-    RECORDING.meta.playbackFrameRate = frameRate;
-    RECORDING.linearFrameInsertion = linearFrameInsertion;
-    RECORDING.meta.numFrames = 0;
-    RECORDING.meta.recordingTimer.start();
-    FRAMERATE_ESTIMATE.initialize(0);
+    rec.meta.filename = filename;
+    rec.meta.resolution = {width, height, 24};
+    rec.meta.playbackFrameRate = frameRate;
+    rec.linearFrameInsertion = linearFrameInsertion;
+    rec.meta.numFrames = 0;
+    rec.meta.recordingTimer.start();
+    rec.meta.startTimestamp = std::chrono::steady_clock::now();
+    rec.framerateEstimate.initialize(0);
 
     // Allocate memory.
     try
     {
-        RECORDING.backBuffers[0].initialize(width, height, FRAME_BUFFER_CAPACITY);
-        RECORDING.backBuffers[1].initialize(width, height, FRAME_BUFFER_CAPACITY);
+        rec.backBuffers[0].initialize(width, height, FRAME_BUFFER_CAPACITY);
+        rec.backBuffers[1].initialize(width, height, FRAME_BUFFER_CAPACITY);
     }
     catch(...)
     {
@@ -264,28 +303,28 @@ bool krecord_start_recording(const char *const filename,
                                        "The video's resolution may be too high.");
         return false;
     }
-    RECORDING.activeFrameBuffer = &RECORDING.backBuffers[0];
+    rec.activeFrameBuffer = &rec.backBuffers[0];
 
     #if _WIN32
         // Encoder: x264vfw. Container: AVI.
-        if (QFileInfo(filename).suffix() != "avi") RECORDING.meta.filename += ".avi";
+        if (QFileInfo(filename).suffix() != "avi") rec.meta.filename += ".avi";
         const auto encoder = cv::VideoWriter::fourcc('X','2','6','4');
     #elif __linux__
         // Encoder: x264. Container: MP4.
-        if (QFileInfo(filename).suffix() != "mp4") RECORDING.meta.filename += ".mp4";
+        if (QFileInfo(filename).suffix() != "mp4") rec.meta.filename += ".mp4";
         const auto encoder = cv::VideoWriter::fourcc('a','v','c','1');
     #else
         #error "Unknown platform."
     #endif
 
-    DEBUG(("Starting recording into file '%s'.", RECORDING.meta.filename.c_str()));
+    DEBUG(("Starting recording into file '%s'.", rec.meta.filename.c_str()));
 
-    VIDEO_WRITER.open(RECORDING.meta.filename,
+    rec.videoWriter.open(rec.meta.filename,
                       encoder,
-                      RECORDING.meta.playbackFrameRate,
-                      cv::Size(RECORDING.meta.resolution.w, RECORDING.meta.resolution.h));
+                      rec.meta.playbackFrameRate,
+                      cv::Size(rec.meta.resolution.w, rec.meta.resolution.h));
 
-    if (!VIDEO_WRITER.isOpened())
+    if (!rec.videoWriter.isOpened())
     {
         kd_show_headless_error_message("VCS can't start recording",
                                        "An error was encountred while attempting to start recording.\n\n"
@@ -293,6 +332,10 @@ bool krecord_start_recording(const char *const filename,
         return false;
     }
 
+    // Have the scaler output its frames in BGR as well, straight into the frame
+    // buffer, so they needn't be converted or copied here.
+    ks_set_bgr_output_enabled(true);
+
     kpropagate_news_of_recording_started();
 
     return true;
@@ -302,7 +345,7 @@ bool krecord_start_recording(const char *const filename,
 bool krecord_is_recording(void)
 {
 #ifdef USE_OPENCV
-    return VIDEO_WRITER.isOpened();
+    return recording().videoWriter.isOpened();
 #else
     return false;
 #endif
@@ -310,48 +353,64 @@ bool krecord_is_recording(void)
 
 uint krecord_playback_framerate(void)
 {
-    return RECORDING.meta.playbackFrameRate;
+    return recording().meta.playbackFrameRate;
 }
 
 double krecord_recording_framerate(void)
 {
-    return FRAMERATE_ESTIMATE.framerate();
+    return recording().framerateEstimate.framerate();
 }
 
 std::string krecord_video_filename(void)
 {
-    return RECORDING.meta.filename;
+    return recording().meta.filename;
 }
 
 uint krecord_num_frames_recorded(void)
 {
-    return RECORDING.meta.numFrames;
+    return recording().meta.numFrames;
 }
 
 i64 krecord_recording_time(void)
 {
-    return RECORDING.meta.recordingTimer.elapsed();
+    return recording().meta.recordingTimer.elapsed();
 }
 
 resolution_s krecord_video_resolution(void)
 {
     k_assert(krecord_is_recording(), "Querying video resolution while recording is inactive.");
 
-    return RECORDING.meta.resolution;
+    return recording().meta.resolution;
 }
 
-void encode_frame_buffer(frame_buffer_s *const frameBuffer)
+// Returns the memory into which the next frame to be recorded will be saved, for
+// the scaler to output the frame into in BGR. The frame buffer holding it isn't
+// switched until the frame has been recorded.
+//
+u8* krecord_next_frame_slot(void)
+{
+    k_assert(krecord_is_recording(), "Asking for a frame slot while recording is inactive.");
+
+    return recording().activeFrameBuffer->upcoming_slot();
+}
+
+// Encodes the given frame buffer's frames into the given recording's video.
+// Meant to be run in the recording's encoder thread.
+//
+static void encode_frame_buffer(recording_s *const recording, frame_buffer_s *const frameBuffer)
 {
 #ifdef USE_OPENCV
-    if (RECORDING.linearFrameInsertion)
+    recording_s &rec = *recording;
+
+    if (rec.linearFrameInsertion)
     {
         const auto &frameTimestamps = frameBuffer->frame_timestamps();
 
         // Nanoseconds between each frame at the recording's playback rate.
-        const i64 stampDelta = ((1000.0 / RECORDING.meta.playbackFrameRate) * 1000000);
+        const i64 stampDelta = ((1000.0 / rec.meta.playbackFrameRate) * 1000000);
 
         // Add frames at even intervals as per the recording's playback rate.
-        i64 stamp = (RECORDING.meta.numFrames * stampDelta);
+        i64 stamp = (rec.meta.numFrames * stampDelta);
         uint i = 0;
         while (stamp <= frameTimestamps[frameBuffer->frame_count()-1])
         {
@@ -359,8 +418,8 @@ void encode_frame_buffer(frame_buffer_s *const frameBuffer)
             {
                 if (frameTimestamps[i] >= stamp)
                 {
-                    VIDEO_WRITER << cv::Mat(frameBuffer->resolution().h, frameBuffer->resolution().w, CV_8UC3, frameBuffer->frame(i));
-                    RECORDING.meta.numFrames++;
+                    rec.videoWriter << cv::Mat(frameBuffer->resolution().h, frameBuffer->resolution().w, CV_8UC3, frameBuffer->frame(i));
+                    rec.meta.numFrames++;
                     break;
                 }
             }
@@ -372,8 +431,8 @@ void encode_frame_buffer(frame_buffer_s *const frameBuffer)
     {
         for (uint i = 0; i < frameBuffer->frame_count(); i++)
         {
-            VIDEO_WRITER << cv::Mat(frameBuffer->resolution().h, frameBuffer->resolution().w, CV_8UC3, frameBuffer->frame(i));
-            RECORDING.meta.numFrames++;
+            rec.videoWriter << cv::Mat(frameBuffer->resolution().h, frameBuffer->resolution().w, CV_8UC3, frameBuffer->frame(i));
+            rec.meta.numFrames++;
         }
     }
 
@@ -381,6 +440,7 @@ void encode_frame_buffer(frame_buffer_s *const frameBuffer)
 
     return;
 #else
+    (void)recording;
     (void)frameBuffer;
 #endif
 }
@@ -390,37 +450,64 @@ void encode_frame_buffer(frame_buffer_s *const frameBuffer)
 void krecord_record_new_frame(void)
 {
 #ifdef USE_OPENCV
-    k_assert(VIDEO_WRITER.isOpened(),
+    recording_s &rec = recording();
+
+    k_assert(rec.videoWriter.isOpened(),
              "Attempted to record a video frame before video recording had been initialized.");
 
-    // Get the current output frame.
+    // Get the current output frame; in BGR, if the scaler has it so.
     const resolution_s resolution = ks_output_resolution();
+    const u8 *const bgrFrameData = ks_scaler_bgr_output_as_raw_ptr();
     const u8 *const frameData = ks_scaler_output_as_raw_ptr();
     if (frameData == nullptr) return;
 
-    k_assert((resolution.w == RECORDING.meta.resolution.w &&
-              resolution.h == RECORDING.meta.resolution.h), "Incompatible frame for recording: mismatched resolution.");
+    k_assert((resolution.w == rec.meta.resolution.w &&
+              resolution.h == rec.meta.resolution.h), "Incompatible frame for recording: mismatched resolution.");
 
-    // Convert the frame to BRG, and save it into the frame buffer.
-    cv::Mat originalFrame(resolution.h, resolution.w, CV_8UC4, (u8*)frameData);
-    cv::Mat frame = cv::Mat(resolution.h, resolution.w, CV_8UC3, RECORDING.activeFrameBuffer->next_slot(RECORDING.meta.recordingTimer.nsecsElapsed()));
-    cv::cvtColor(originalFrame, frame, CV_BGRA2BGR);
+    // Time the frame by when it was captured, rather than by when it got through
+    // processing. A frame captured before the recording started (e.g. one that
+    // was still queued at the time) counts as being from the start.
+    const i64 timestamp = std::max(i64(0), i64(std::chrono::duration_cast<std::chrono::nanoseconds>(ks_scaler_output_meta().timestamp -
+                                                                                                     rec.meta.startTimestamp).count()));
+
+    // Save the frame into the frame buffer. The scaler will normally have output
+    // it there already; but the output may instead be from an earlier frame -
+    // e.g. one that this frame repeats -, which is copied over from where it was
+    // saved, or converted into BGR if the scaler didn't output it so.
+    u8 *const slot = rec.activeFrameBuffer->next_slot(timestamp);
+
+    if (!bgrFrameData)
+    {
+        cv::Mat originalFrame(resolution.h, resolution.w, CV_8UC4, (u8*)frameData);
+        cv::Mat frame = cv::Mat(resolution.h, resolution.w, CV_8UC3, slot);
+        cv::cvtColor(originalFrame, frame, CV_BGRA2BGR);
+    }
+    else if (bgrFrameData != slot)
+    {
+        memcpy(slot, bgrFrameData, (resolution.w * resolution.h * 3));
+    }
 
     // Once we've accumulated enough frames to fill the frame buffer, encode
     // its contents into the video file.
-    if (RECORDING.activeFrameBuffer->is_full())
+    if (rec.activeFrameBuffer->is_full())
     {
-        RECORDING.encoderThread.waitForFinished();
+        rec.encoderThread.waitForFinished();
 
-        FRAMERATE_ESTIMATE.update(RECORDING.meta.numFrames);
-        kd_update_video_recording_metainfo();
+        rec.framerateEstimate.update(rec.meta.numFrames);
+
+        // The GUI shows the selected source's recording.
+        if (kc_is_selected_source_active())
+        {
+            kd_update_video_recording_metainfo();
+        }
 
         // Run the encoding in a separate thread.
-        const auto frameBuffer = RECORDING.activeFrameBuffer;
-        RECORDING.encoderThread = QtConcurrent::run([=]{encode_frame_buffer(frameBuffer);});
+        recording_s *const recordingPtr = &rec;
+        frame_buffer_s *const frameBuffer = rec.activeFrameBuffer;
+        rec.encoderThread = QtConcurrent::run([=]{encode_frame_buffer(recordingPtr, frameBuffer);});
 
         // Meanwhile, switch to the other frame buffer, and keep accumulating new frames.
-        RECORDING.flip_frame_buffer();
+        rec.flip_frame_buffer();
     }
 
     return;
@@ -430,10 +517,14 @@ void krecord_record_new_frame(void)
 void krecord_stop_recording(void)
 {
 #ifdef USE_OPENCV
-    DEBUG(("Stopping recording into file '%s'.", RECORDING.meta.filename.c_str()));
+    recording_s &rec = recording();
+
+    DEBUG(("Stopping recording into file '%s'.", rec.meta.filename.c_str()));
+
+    rec.encoderThread.waitForFinished();
+    rec.videoWriter.release();
 
-    RECORDING.encoderThread.waitForFinished();
-    VIDEO_WRITER.release();
+    ks_set_bgr_output_enabled(false);
 
     kpropagate_news_of_recording_ended();
 
@@ -27,6 +27,8 @@ bool krecord_is_recording(void);
 
 void krecord_record_new_frame(void);
 
+u8* krecord_next_frame_slot(void);
+
 void krecord_stop_recording(void);
 
 #endif
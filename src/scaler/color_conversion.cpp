@@ -0,0 +1,354 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS color conversion
+ *
+ * Converts pixels from the formats in which the capture hardware can send them
+ * (16-bit 555 and 565 RGB, 16-bit YUV 4:2:2 in YUY2 order, and 24-bit 888 RGB)
+ * into the 32-bit BGRA that the filters, anti-tearing, and the scalers operate
+ * on; and BGRA into the packed 24-bit BGR that video recording takes.
+ *
+ * The 16-bit formats are converted eight pixels at a time using SSE2 where it's
+ * available. The plain versions compute the same values, so the output doesn't
+ * depend on which of them was used. BGRA is converted into BGR sixteen pixels at
+ * a time, with SSSE3's byte shuffle if VCS is built for it, and otherwise SSE2.
+ *
+ * YUV is taken to be BT.601 with studio-range levels (luma in 16-235), as sent
+ * by capture hardware for standard-definition video. The conversion is done in
+ * 6-bit fixed point.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#if __SSE2__
+    #include <emmintrin.h>
+#endif
+#if __SSSE3__
+    #include <tmmintrin.h>
+#endif
+#include "scaler/color_conversion.h"
+#include "common/globals.h"
+
+// Fixed-point (6-bit) coefficients for converting BT.601 studio-range YUV into
+// RGB.
+static const int YUV_Y_COEFF = 75;          // 1.164
+static const int YUV_V_TO_RED = 102;        // 1.596
+static const int YUV_U_TO_GREEN = 25;       // 0.391
+static const int YUV_V_TO_GREEN = 52;       // 0.813
+static const int YUV_U_TO_BLUE = 129;       // 2.018
+
+// Returns true if pixels of the given resolution and format are already in
+// BGRA, i.e. need no conversion.
+//
+bool kconv_is_bgra(const resolution_s &r, const PIXELFORMAT pixelFormat)
+{
+    return ((r.bpp == 32) &&
+            (pixelFormat == RGB_PIXELFORMAT_888));
+}
+
+// Returns true if pixels of the given resolution and format can be converted
+// into BGRA.
+//
+bool kconv_can_convert_to_bgra(const resolution_s &r, const PIXELFORMAT pixelFormat)
+{
+    switch (r.bpp)
+    {
+        case 16:
+        {
+            // In YUY2, each pair of horizontally adjacent pixels shares its
+            // chroma, so rows must consist of whole pairs.
+            return ((pixelFormat == RGB_PIXELFORMAT_555) ||
+                    (pixelFormat == RGB_PIXELFORMAT_565) ||
+                    ((pixelFormat == RGB_PIXELFORMAT_YUY2) && !(r.w % 2)));
+        }
+        case 24:
+        case 32: return (pixelFormat == RGB_PIXELFORMAT_888);
+        default: return false;
+    }
+}
+
+// Expands the given 5- and 6-bit color channel values to 8 bits, such that the
+// channel's maximum maps to 255.
+//
+static inline u8 expand_5_bits(const uint value)
+{
+    return ((value << 3) | (value >> 2));
+}
+
+static inline u8 expand_6_bits(const uint value)
+{
+    return ((value << 2) | (value >> 4));
+}
+
+static inline u8 clamp_yuv_result(const int value)
+{
+    return std::min(255, (std::max(0, value) >> 6));
+}
+
+#if __SSE2__
+    // Writes eight BGRA pixels into dst, given their color channels as 16-bit
+    // values in the range 0-255.
+    //
+    static inline void store_bgra_x8(u8 *const dst, const __m128i blue, const __m128i green, const __m128i red)
+    {
+        const __m128i blueGreen = _mm_or_si128(blue, _mm_slli_epi16(green, 8));
+        const __m128i redAlpha = _mm_or_si128(red, _mm_set1_epi16(short(0xff00)));
+
+        _mm_storeu_si128((__m128i*)dst,        _mm_unpacklo_epi16(blueGreen, redAlpha));
+        _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(blueGreen, redAlpha));
+
+        return;
+    }
+
+    // Expands the given 16-bit lanes of 5- and 6-bit color channel values to 8
+    // bits; as expand_5_bits() and expand_6_bits().
+    //
+    static inline __m128i expand_5_bits_x8(const __m128i value)
+    {
+        return _mm_or_si128(_mm_slli_epi16(value, 3), _mm_srli_epi16(value, 2));
+    }
+
+    static inline __m128i expand_6_bits_x8(const __m128i value)
+    {
+        return _mm_or_si128(_mm_slli_epi16(value, 2), _mm_srli_epi16(value, 4));
+    }
+
+    static inline __m128i clamp_yuv_result_x8(const __m128i value)
+    {
+        return _mm_min_epi16(_mm_set1_epi16(255), _mm_max_epi16(_mm_setzero_si128(), _mm_srai_epi16(value, 6)));
+    }
+
+    // Returns the given four BGRA pixels as BGR, packed into the lowest 12 bytes;
+    // the rest being zero.
+    //
+    static inline __m128i pack_bgr_x4(const __m128i bgra)
+    {
+    #if __SSSE3__
+        return _mm_shuffle_epi8(bgra, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+    #else
+        // Close up the gap left by the alpha in each half, then the gap of two
+        // bytes left between the halves.
+        const __m128i evenPixels = _mm_and_si128(bgra, _mm_setr_epi32(0xffffff, 0, 0xffffff, 0));
+        const __m128i oddPixels = _mm_and_si128(bgra, _mm_setr_epi32(0, 0xffffff, 0, 0xffffff));
+        const __m128i halves = _mm_or_si128(evenPixels, _mm_srli_epi64(oddPixels, 8));
+
+        return _mm_or_si128(_mm_move_epi64(halves), _mm_slli_si128(_mm_srli_si128(halves, 8), 6));
+    #endif
+    }
+#endif
+
+static void convert_565_to_bgra(const u8 *const src, u8 *const dst, const uint numPixels)
+{
+    uint i = 0;
+
+#if __SSE2__
+    {
+        const __m128i mask5 = _mm_set1_epi16(0x1f);
+        const __m128i mask6 = _mm_set1_epi16(0x3f);
+
+        for (; (i + 8) <= numPixels; i += 8)
+        {
+            const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + (i * 2)));
+
+            store_bgra_x8((dst + (i * 4)),
+                          expand_5_bits_x8(_mm_and_si128(pixels, mask5)),
+                          expand_6_bits_x8(_mm_and_si128(_mm_srli_epi16(pixels, 5), mask6)),
+                          expand_5_bits_x8(_mm_srli_epi16(pixels, 11)));
+        }
+    }
+#endif
+
+    for (; i < numPixels; i++)
+    {
+        u16 pixel;
+        memcpy(&pixel, (src + (i * 2)), sizeof(pixel));
+
+        dst[(i * 4) + 0] = expand_5_bits(pixel & 0x1f);
+        dst[(i * 4) + 1] = expand_6_bits((pixel >> 5) & 0x3f);
+        dst[(i * 4) + 2] = expand_5_bits(pixel >> 11);
+        dst[(i * 4) + 3] = 255;
+    }
+
+    return;
+}
+
+static void convert_555_to_bgra(const u8 *const src, u8 *const dst, const uint numPixels)
+{
+    uint i = 0;
+
+#if __SSE2__
+    {
+        const __m128i mask5 = _mm_set1_epi16(0x1f);
+
+        for (; (i + 8) <= numPixels; i += 8)
+        {
+            const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + (i * 2)));
+
+            store_bgra_x8((dst + (i * 4)),
+                          expand_5_bits_x8(_mm_and_si128(pixels, mask5)),
+                          expand_5_bits_x8(_mm_and_si128(_mm_srli_epi16(pixels, 5), mask5)),
+                          expand_5_bits_x8(_mm_and_si128(_mm_srli_epi16(pixels, 10), mask5)));
+        }
+    }
+#endif
+
+    for (; i < numPixels; i++)
+    {
+        u16 pixel;
+        memcpy(&pixel, (src + (i * 2)), sizeof(pixel));
+
+        dst[(i * 4) + 0] = expand_5_bits(pixel & 0x1f);
+        dst[(i * 4) + 1] = expand_5_bits((pixel >> 5) & 0x1f);
+        dst[(i * 4) + 2] = expand_5_bits((pixel >> 10) & 0x1f);
+        dst[(i * 4) + 3] = 255;
+    }
+
+    return;
+}
+
+// Converts pixels in YUY2 order - Y0 U Y1 V for each pair of pixels - into BGRA.
+// The number of pixels is expected to be even.
+//
+static void convert_yuy2_to_bgra(const u8 *const src, u8 *const dst, const uint numPixels)
+{
+    uint i = 0;
+
+#if __SSE2__
+    {
+        const __m128i lowWordMask = _mm_set1_epi32(0xffff);
+        const __m128i rounding = _mm_set1_epi16(32);
+
+        for (; (i + 8) <= numPixels; i += 8)
+        {
+            const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + (i * 2)));
+
+            const __m128i luma = _mm_mullo_epi16(_mm_sub_epi16(_mm_and_si128(pixels, _mm_set1_epi16(0xff)), _mm_set1_epi16(16)),
+                                                 _mm_set1_epi16(YUV_Y_COEFF));
+
+            // The chroma samples, U and V alternating, with each pair's U then
+            // copied over its V and vice versa, so that each pixel has both.
+            const __m128i chroma = _mm_sub_epi16(_mm_srli_epi16(pixels, 8), _mm_set1_epi16(128));
+            const __m128i u = _mm_or_si128(_mm_and_si128(chroma, lowWordMask), _mm_slli_epi32(chroma, 16));
+            const __m128i v = _mm_or_si128(_mm_srli_epi32(chroma, 16), _mm_andnot_si128(lowWordMask, chroma));
+
+            const __m128i red = _mm_adds_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(v, _mm_set1_epi16(YUV_V_TO_RED))), rounding);
+            const __m128i green = _mm_adds_epi16(_mm_subs_epi16(_mm_subs_epi16(luma, _mm_mullo_epi16(u, _mm_set1_epi16(YUV_U_TO_GREEN))),
+                                                                _mm_mullo_epi16(v, _mm_set1_epi16(YUV_V_TO_GREEN))), rounding);
+            const __m128i blue = _mm_adds_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(u, _mm_set1_epi16(YUV_U_TO_BLUE))), rounding);
+
+            store_bgra_x8((dst + (i * 4)), clamp_yuv_result_x8(blue), clamp_yuv_result_x8(green), clamp_yuv_result_x8(red));
+        }
+    }
+#endif
+
+    for (; (i + 2) <= numPixels; i += 2)
+    {
+        const u8 *const pair = (src + (i * 2));
+        const int u = (pair[1] - 128);
+        const int v = (pair[3] - 128);
+
+        for (uint p = 0; p < 2; p++)
+        {
+            const int luma = ((pair[p * 2] - 16) * YUV_Y_COEFF);
+            u8 *const pixel = (dst + ((i + p) * 4));
+
+            pixel[0] = clamp_yuv_result(luma + (u * YUV_U_TO_BLUE) + 32);
+            pixel[1] = clamp_yuv_result(luma - (u * YUV_U_TO_GREEN) - (v * YUV_V_TO_GREEN) + 32);
+            pixel[2] = clamp_yuv_result(luma + (v * YUV_V_TO_RED) + 32);
+            pixel[3] = 255;
+        }
+    }
+
+    return;
+}
+
+static void convert_888_to_bgra(const u8 *const src, u8 *const dst, const uint numPixels)
+{
+    for (uint i = 0; i < numPixels; i++)
+    {
+        dst[(i * 4) + 0] = src[(i * 3) + 0];
+        dst[(i * 4) + 1] = src[(i * 3) + 1];
+        dst[(i * 4) + 2] = src[(i * 3) + 2];
+        dst[(i * 4) + 3] = 255;
+    }
+
+    return;
+}
+
+// Converts the given number of consecutive pixels of the given bit depth and
+// format from src into BGRA in dst. The pixels are expected to be in a format
+// for which kconv_can_convert_to_bgra() returns true.
+//
+void kconv_convert_row_to_bgra(const u8 *const src, u8 *const dst, const uint numPixels,
+                               const uint bpp, const PIXELFORMAT pixelFormat)
+{
+    switch (bpp)
+    {
+        case 16:
+        {
+            switch (pixelFormat)
+            {
+                case RGB_PIXELFORMAT_565:  convert_565_to_bgra(src, dst, numPixels); break;
+                case RGB_PIXELFORMAT_555:  convert_555_to_bgra(src, dst, numPixels); break;
+                case RGB_PIXELFORMAT_YUY2: convert_yuy2_to_bgra(src, dst, numPixels); break;
+                default: k_assert(0, "Was asked to convert 16-bit pixels of an unknown format."); break;
+            }
+
+            break;
+        }
+        case 24: convert_888_to_bgra(src, dst, numPixels); break;
+        case 32: memcpy(dst, src, (numPixels * 4)); break;
+        default: k_assert(0, "Was asked to convert pixels of an unknown bit depth."); break;
+    }
+
+    return;
+}
+
+// Converts the given frame's pixels from src into BGRA in dst, which is expected
+// to have room for them.
+//
+void kconv_convert_frame_to_bgra(const u8 *const src, u8 *const dst, const resolution_s &r,
+                                 const PIXELFORMAT pixelFormat)
+{
+    k_assert(kconv_can_convert_to_bgra(r, pixelFormat),
+             "Was asked to convert a frame whose pixels can't be converted into BGRA.");
+
+    // The frame's rows are contiguous, and - in YUY2 - consist of whole pairs of
+    // pixels, so the frame converts as a single row.
+    kconv_convert_row_to_bgra(src, dst, (r.w * r.h), r.bpp, pixelFormat);
+
+    return;
+}
+
+// Converts the given number of consecutive BGRA pixels from src into BGR in dst,
+// dropping their alpha.
+//
+void kconv_convert_bgra_row_to_bgr(const u8 *const src, u8 *const dst, const uint numPixels)
+{
+    uint i = 0;
+
+#if __SSE2__
+    // Sixteen pixels at a time, whose 48 bytes of BGR are stored as three
+    // 16-byte blocks.
+    for (; (i + 16) <= numPixels; i += 16)
+    {
+        const __m128i a = pack_bgr_x4(_mm_loadu_si128((const __m128i*)(src + (i * 4))));
+        const __m128i b = pack_bgr_x4(_mm_loadu_si128((const __m128i*)(src + (i * 4) + 16)));
+        const __m128i c = pack_bgr_x4(_mm_loadu_si128((const __m128i*)(src + (i * 4) + 32)));
+        const __m128i d = pack_bgr_x4(_mm_loadu_si128((const __m128i*)(src + (i * 4) + 48)));
+
+        _mm_storeu_si128((__m128i*)(dst + (i * 3)),      _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i*)(dst + (i * 3) + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i*)(dst + (i * 3) + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+#endif
+
+    for (; i < numPixels; i++)
+    {
+        dst[(i * 3) + 0] = src[(i * 4) + 0];
+        dst[(i * 3) + 1] = src[(i * 4) + 1];
+        dst[(i * 3) + 2] = src[(i * 4) + 2];
+    }
+
+    return;
+}
@@ -0,0 +1,24 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef COLOR_CONVERSION_H
+#define COLOR_CONVERSION_H
+
+#include "capture/capture.h"
+
+bool kconv_is_bgra(const resolution_s &r, const PIXELFORMAT pixelFormat);
+
+bool kconv_can_convert_to_bgra(const resolution_s &r, const PIXELFORMAT pixelFormat);
+
+void kconv_convert_row_to_bgra(const u8 *const src, u8 *const dst, const uint numPixels,
+                               const uint bpp, const PIXELFORMAT pixelFormat);
+
+void kconv_convert_frame_to_bgra(const u8 *const src, u8 *const dst, const resolution_s &r,
+                                 const PIXELFORMAT pixelFormat);
+
+void kconv_convert_bgra_row_to_bgr(const u8 *const src, u8 *const dst, const uint numPixels);
+
+#endif
@@ -0,0 +1,741 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS native scaler
+ *
+ * VCS's own nearest-neighbor and bilinear scalers, which output BGRA pixels,
+ * available whether or not VCS is built with OpenCV.
+ *
+ * Nearest-neighbor scaling copies each source row's pixels out into the output
+ * once, and duplicates the output row for the source row's other occurrences.
+ * Bilinear scaling first blends the two source rows nearest to each output row
+ * into one, then blends the resulting row's two pixels nearest to each output
+ * pixel. The blending is done with 7-bit weights, so that the weighted sums of
+ * 8-bit color values fit in 16 bits, and SSE2 where available; the plain
+ * versions compute the same values.
+ *
+ * The scalers work row by row from tables precomputed into a plan, and can be
+ * given any band of the output's rows to scale; each output row depending only
+ * on the source, so that bands scaled concurrently come out as they would with
+ * the whole image scaled at once.
+ *
+ * Source pixels not in BGRA - e.g. 16-bit captures - are converted into it a
+ * row at a time as the rows are needed, rather than the whole frame being
+ * converted into a buffer first and then read back in for scaling.
+ *
+ * Scaling along one axis only - e.g. 720 x 400 to 720 x 540, as for 4:3 aspect
+ * correction - has its own versions that leave the other axis alone, rather than
+ * resampling it at 1:1.
+ *
+ * Scaling by whole numbers - e.g. 320 x 200 to 1280 x 800, or 640 x 480 to 320 x
+ * 240 - has its own pixel replication (up) and block averaging (down) versions,
+ * specialized for the common factors of 2 to 4; which give the same result as
+ * OpenCV's nearest-neighbor upscaling and area downscaling would. Like OpenCV's,
+ * the block averages are rounded half up for 2 x 2 blocks, and otherwise from
+ * the single-precision product of the sum and the inverse of the block size, to
+ * the nearest even value on a tie.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <cmath>
+#if __SSE2__
+    #include <emmintrin.h>
+#endif
+#include "scaler/color_conversion.h"
+#include "scaler/native_scaler.h"
+#include "common/globals.h"
+
+// Bilinear blending weights are fixed-point fractions of this many bits.
+static const uint WEIGHT_BITS = 7;
+static const uint WEIGHT_ONE = (1 << WEIGHT_BITS);
+
+// Returns for each of dstSize output pixels the source pixel it's a copy of, out
+// of srcSize. The pixels are picked as OpenCV's nearest-neighbor scaling picks
+// them, down to its floating-point arithmetic, so that the two give the same
+// result.
+//
+static void find_nearest_samples(std::vector<uint> &samples, const uint srcSize, const uint dstSize)
+{
+    const double ratio = (1.0 / (double(dstSize) / srcSize));
+
+    samples.resize(dstSize);
+
+    for (uint d = 0; d < dstSize; d++)
+    {
+        samples[d] = std::min(uint(std::floor(d * ratio)), (srcSize - 1));
+    }
+
+    return;
+}
+
+// Returns for each of dstSize output pixels the source pixels it's blended from,
+// out of srcSize, with pixel centers aligned between the two.
+//
+static void find_linear_samples(std::vector<linear_sample_s> &samples, const uint srcSize, const uint dstSize)
+{
+    const real ratio = (srcSize / real(dstSize));
+
+    samples.resize(dstSize);
+
+    for (uint d = 0; d < dstSize; d++)
+    {
+        const real pos = std::max(0.0, (((d + 0.5) * ratio) - 0.5));
+        uint idx = uint(pos);
+        uint weight = std::round((pos - idx) * WEIGHT_ONE);
+
+        if (weight == WEIGHT_ONE)
+        {
+            idx++;
+            weight = 0;
+        }
+
+        if (idx >= (srcSize - 1))
+        {
+            idx = (srcSize - 1);
+            weight = 0;
+        }
+
+        samples[d] = {idx, weight};
+    }
+
+    return;
+}
+
+// Sets up the given plan for scaling pixels of size srcRes and the given format
+// to BGRA of size dstRes.
+//
+void kns_make_plan(native_scaling_plan_s *const plan, const resolution_s &srcRes, const PIXELFORMAT srcPixelFormat,
+                   const resolution_s &dstRes)
+{
+    plan->srcRes = srcRes;
+    plan->dstRes = dstRes;
+    plan->srcPixelFormat = srcPixelFormat;
+
+    find_nearest_samples(plan->nearestColumns, srcRes.w, dstRes.w);
+    find_nearest_samples(plan->nearestRows, srcRes.h, dstRes.h);
+
+    find_linear_samples(plan->linearColumns, srcRes.w, dstRes.w);
+    find_linear_samples(plan->linearRows, srcRes.h, dstRes.h);
+
+    return;
+}
+
+// Returns the given row of the plan's source pixels in BGRA; either as it is in
+// src, if the source is in BGRA, or else converted into 'converted', which is
+// expected to have room for the row.
+//
+static const u8* bgra_row(const u8 *const src, const uint y, const native_scaling_plan_s &plan, u8 *const converted)
+{
+    const u8 *const row = (src + (y * plan.srcRes.w * (plan.srcRes.bpp / 8)));
+
+    if (kconv_is_bgra(plan.srcRes, plan.srcPixelFormat))
+    {
+        return row;
+    }
+
+    kconv_convert_row_to_bgra(row, converted, plan.srcRes.w, plan.srcRes.bpp, plan.srcPixelFormat);
+
+    return converted;
+}
+
+// Blends the given rows of bytes, a and b, into dst, with the given weight for b.
+//
+static void blend_rows(const u8 *const a, const u8 *const b, u8 *const dst, const uint numBytes, const uint weight)
+{
+    uint i = 0;
+
+    if (!weight)
+    {
+        memcpy(dst, a, numBytes);
+
+        return;
+    }
+
+#if __SSE2__
+    {
+        const __m128i weightA = _mm_set1_epi16(WEIGHT_ONE - weight);
+        const __m128i weightB = _mm_set1_epi16(weight);
+        const __m128i rounding = _mm_set1_epi16(WEIGHT_ONE / 2);
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; (i + 16) <= numBytes; i += 16)
+        {
+            const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+            const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+
+            const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), weightA),
+                                                                          _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), weightB)),
+                                                            rounding), WEIGHT_BITS);
+            const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), weightA),
+                                                                          _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), weightB)),
+                                                            rounding), WEIGHT_BITS);
+
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+        }
+    }
+#endif
+
+    for (; i < numBytes; i++)
+    {
+        dst[i] = (((a[i] * (WEIGHT_ONE - weight)) + (b[i] * weight) + (WEIGHT_ONE / 2)) >> WEIGHT_BITS);
+    }
+
+    return;
+}
+
+// Scales the given row of pixels into dst, blending each output pixel from the
+// source pixels given for it in 'samples'. The source row is expected to have
+// one pixel more than the samples refer to, so that the pixel after each sample
+// can be read.
+//
+static void scale_row_linear(const u8 *const src, u8 *const dst, const std::vector<linear_sample_s> &samples)
+{
+    const uint numPixels = samples.size();
+    uint x = 0;
+
+#if __SSE2__
+    {
+        const __m128i one = _mm_set1_epi16(WEIGHT_ONE);
+        const __m128i rounding = _mm_set1_epi16(WEIGHT_ONE / 2);
+        const __m128i zero = _mm_setzero_si128();
+
+        // Two output pixels at a time, each from a pair of adjacent source
+        // pixels.
+        for (; (x + 2) <= numPixels; x += 2)
+        {
+            const linear_sample_s &s1 = samples[x];
+            const linear_sample_s &s2 = samples[x + 1];
+
+            const __m128i pair1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + (s1.idx * 4))), zero);
+            const __m128i pair2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + (s2.idx * 4))), zero);
+
+            const __m128i left = _mm_unpacklo_epi64(pair1, pair2);
+            const __m128i right = _mm_unpackhi_epi64(pair1, pair2);
+            const __m128i weightRight = _mm_set_epi16(s2.weight, s2.weight, s2.weight, s2.weight,
+                                                      s1.weight, s1.weight, s1.weight, s1.weight);
+            const __m128i weightLeft = _mm_sub_epi16(one, weightRight);
+
+            const __m128i result = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(left, weightLeft),
+                                                                              _mm_mullo_epi16(right, weightRight)),
+                                                                rounding), WEIGHT_BITS);
+
+            _mm_storel_epi64((__m128i*)(dst + (x * 4)), _mm_packus_epi16(result, result));
+        }
+    }
+#endif
+
+    for (; x < numPixels; x++)
+    {
+        const u8 *const left = (src + (samples[x].idx * 4));
+        const u8 *const right = (left + 4);
+        const uint weight = samples[x].weight;
+
+        for (uint c = 0; c < 4; c++)
+        {
+            dst[(x * 4) + c] = (((left[c] * (WEIGHT_ONE - weight)) + (right[c] * weight) + (WEIGHT_ONE / 2)) >> WEIGHT_BITS);
+        }
+    }
+
+    return;
+}
+
+void kns_scale_nearest(NATIVE_SCALER_FUNC_PARAMS)
+{
+    const resolution_s &srcRes = plan.srcRes;
+    const resolution_s &dstRes = plan.dstRes;
+    const std::vector<uint> &columns = plan.nearestColumns;
+    std::vector<u8> convertedRow(srcRes.w * 4);
+    uint prevSrcY = ~0u;
+
+    k_assert(kconv_can_convert_to_bgra(srcRes, plan.srcPixelFormat) && (dstRes.bpp == 32),
+             "The native scalers require convertible source pixels and 32-bit target color.");
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        const uint srcY = plan.nearestRows[y];
+        u8 *const dstRow = (dst + (y * dstPitch));
+
+        // Consecutive output rows from the same source row are identical.
+        if (srcY == prevSrcY)
+        {
+            memcpy(dstRow, (dstRow - dstPitch), (dstRes.w * 4));
+            continue;
+        }
+
+        const u8 *const srcRow = bgra_row(src, srcY, plan, convertedRow.data());
+
+        for (uint x = 0; x < dstRes.w; x++)
+        {
+            memcpy((dstRow + (x * 4)), (srcRow + (columns[x] * 4)), 4);
+        }
+
+        prevSrcY = srcY;
+    }
+
+    return;
+}
+
+// The two adjacent source rows, in BGRA, that a bilinearly scaled output row is
+// blended from; converted from the source as needed. Each converted row has room
+// for one pixel past its end, so that it can be given to scale_row_linear().
+//
+struct linear_row_pair_s
+{
+    linear_row_pair_s(const u8 *const src, const native_scaling_plan_s &plan) :
+        src(src),
+        plan(plan),
+        srcPitch(plan.srcRes.w * 4),
+        convertedRows((srcPitch + 4) * 2),
+        upperRowBuffer(convertedRows.data()),
+        lowerRowBuffer(convertedRows.data() + srcPitch + 4)
+    {
+        return;
+    }
+
+    // Points the pair at source row idx and the one after it.
+    void fetch(const uint idx)
+    {
+        if (idx == upperRowIdx)
+        {
+            return;
+        }
+
+        // Moving down by one source row, the previous lower row becomes the
+        // upper one, and needn't be converted again.
+        if (lowerRow &&
+            (idx == (upperRowIdx + 1)))
+        {
+            upperRow = lowerRow;
+            std::swap(upperRowBuffer, lowerRowBuffer);
+        }
+        else
+        {
+            upperRow = bgra_row(src, idx, plan, upperRowBuffer);
+        }
+
+        lowerRow = bgra_row(src, std::min((idx + 1), uint(plan.srcRes.h - 1)), plan, lowerRowBuffer);
+        upperRowIdx = idx;
+
+        return;
+    }
+
+    const u8 *const src;
+    const native_scaling_plan_s &plan;
+    const uint srcPitch;
+    std::vector<u8> convertedRows;
+    u8 *upperRowBuffer;
+    u8 *lowerRowBuffer;
+    const u8 *upperRow = nullptr;
+    const u8 *lowerRow = nullptr;
+    uint upperRowIdx = ~0u;
+};
+
+// Returns true if output row y repeats the previous one, i.e. is blended from the
+// same source rows with the same weight.
+//
+static bool is_repeated_linear_row(const std::vector<linear_sample_s> &rows, const uint y, const uint firstRow)
+{
+    return ((y > firstRow) &&
+            (rows[y].idx == rows[y - 1].idx) &&
+            (rows[y].weight == rows[y - 1].weight));
+}
+
+void kns_scale_linear(NATIVE_SCALER_FUNC_PARAMS)
+{
+    const resolution_s &srcRes = plan.srcRes;
+    const resolution_s &dstRes = plan.dstRes;
+    const std::vector<linear_sample_s> &columns = plan.linearColumns;
+    const std::vector<linear_sample_s> &rows = plan.linearRows;
+    const uint srcPitch = (srcRes.w * 4);
+    linear_row_pair_s sourceRows(src, plan);
+
+    k_assert(kconv_can_convert_to_bgra(srcRes, plan.srcPixelFormat) && (dstRes.bpp == 32),
+             "The native scalers require convertible source pixels and 32-bit target color.");
+
+    // Room for the source row's last pixel to be repeated past its end; see
+    // scale_row_linear().
+    std::vector<u8> blendedRow(srcPitch + 4);
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        const linear_sample_s &row = rows[y];
+        u8 *const dstRow = (dst + (y * dstPitch));
+
+        if (is_repeated_linear_row(rows, y, firstRow))
+        {
+            memcpy(dstRow, (dstRow - dstPitch), (dstRes.w * 4));
+            continue;
+        }
+
+        sourceRows.fetch(row.idx);
+
+        blend_rows(sourceRows.upperRow, sourceRows.lowerRow, blendedRow.data(), srcPitch, row.weight);
+
+        memcpy((blendedRow.data() + srcPitch), (blendedRow.data() + srcPitch - 4), 4);
+
+        scale_row_linear(blendedRow.data(), dstRow, columns);
+    }
+
+    return;
+}
+
+// Bilinear scaling for when only the height changes; e.g. 720 x 400 to 720 x 540.
+// Each output row is blended from its two source rows straight into the output,
+// with nothing done across the row.
+//
+void kns_scale_linear_vertical(NATIVE_SCALER_FUNC_PARAMS)
+{
+    const resolution_s &srcRes = plan.srcRes;
+    const resolution_s &dstRes = plan.dstRes;
+    const std::vector<linear_sample_s> &rows = plan.linearRows;
+    linear_row_pair_s sourceRows(src, plan);
+
+    k_assert(kconv_can_convert_to_bgra(srcRes, plan.srcPixelFormat) && (dstRes.bpp == 32),
+             "The native scalers require convertible source pixels and 32-bit target color.");
+    k_assert((srcRes.w == dstRes.w), "Expected the width to be unchanged for vertical-only scaling.");
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        const linear_sample_s &row = rows[y];
+        u8 *const dstRow = (dst + (y * dstPitch));
+
+        if (is_repeated_linear_row(rows, y, firstRow))
+        {
+            memcpy(dstRow, (dstRow - dstPitch), (dstRes.w * 4));
+            continue;
+        }
+
+        sourceRows.fetch(row.idx);
+
+        blend_rows(sourceRows.upperRow, sourceRows.lowerRow, dstRow, (dstRes.w * 4), row.weight);
+    }
+
+    return;
+}
+
+// Bilinear scaling for when only the width changes. Each source row is scaled
+// across straight into the output, with no rows blended together.
+//
+void kns_scale_linear_horizontal(NATIVE_SCALER_FUNC_PARAMS)
+{
+    const resolution_s &srcRes = plan.srcRes;
+    const resolution_s &dstRes = plan.dstRes;
+    const std::vector<linear_sample_s> &columns = plan.linearColumns;
+    const uint srcPitch = (srcRes.w * 4);
+    const bool isBgra = kconv_is_bgra(srcRes, plan.srcPixelFormat);
+
+    k_assert(kconv_can_convert_to_bgra(srcRes, plan.srcPixelFormat) && (dstRes.bpp == 32),
+             "The native scalers require convertible source pixels and 32-bit target color.");
+    k_assert((srcRes.h == dstRes.h), "Expected the height to be unchanged for horizontal-only scaling.");
+
+    // Room for the source row's last pixel to be repeated past its end; see
+    // scale_row_linear().
+    std::vector<u8> paddedRow(srcPitch + 4);
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        u8 *const dstRow = (dst + (y * dstPitch));
+
+        // A BGRA source row other than the last one can be read from where it
+        // is, the pixel past its end being the first of the next row.
+        if (isBgra &&
+            ((y + 1) < srcRes.h))
+        {
+            scale_row_linear((src + (y * srcPitch)), dstRow, columns);
+            continue;
+        }
+
+        const u8 *const srcRow = bgra_row(src, y, plan, paddedRow.data());
+
+        if (srcRow != paddedRow.data())
+        {
+            memcpy(paddedRow.data(), srcRow, srcPitch);
+        }
+
+        memcpy((paddedRow.data() + srcPitch), (paddedRow.data() + srcPitch - 4), 4);
+
+        scale_row_linear(paddedRow.data(), dstRow, columns);
+    }
+
+    return;
+}
+
+// Nearest-neighbor scaling for when only the height changes. Each output row is
+// a copy of its source row.
+//
+void kns_scale_nearest_vertical(NATIVE_SCALER_FUNC_PARAMS)
+{
+    const resolution_s &srcRes = plan.srcRes;
+    const resolution_s &dstRes = plan.dstRes;
+    const bool isBgra = kconv_is_bgra(srcRes, plan.srcPixelFormat);
+
+    k_assert(kconv_can_convert_to_bgra(srcRes, plan.srcPixelFormat) && (dstRes.bpp == 32),
+             "The native scalers require convertible source pixels and 32-bit target color.");
+    k_assert((srcRes.w == dstRes.w), "Expected the width to be unchanged for vertical-only scaling.");
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        u8 *const dstRow = (dst + (y * dstPitch));
+
+        // Rows not in BGRA are converted straight into the output, and needn't
+        // be converted again for the source row's other occurrences.
+        if (!isBgra &&
+            (y > firstRow) &&
+            (plan.nearestRows[y] == plan.nearestRows[y - 1]))
+        {
+            memcpy(dstRow, (dstRow - dstPitch), (dstRes.w * 4));
+        }
+        else if (isBgra)
+        {
+            memcpy(dstRow, (src + (plan.nearestRows[y] * srcRes.w * 4)), (dstRes.w * 4));
+        }
+        else
+        {
+            kconv_convert_row_to_bgra((src + (plan.nearestRows[y] * srcRes.w * (srcRes.bpp / 8))), dstRow,
+                                      srcRes.w, srcRes.bpp, plan.srcPixelFormat);
+        }
+    }
+
+    return;
+}
+
+// Writes each of the given pixels Factor times over into dst.
+//
+template <uint Factor>
+static void replicate_row(const u8 *const src, u8 *const dst, const uint numPixels)
+{
+    uint x = 0;
+
+#if __SSE2__
+    if (Factor == 2)
+    {
+        for (; (x + 4) <= numPixels; x += 4)
+        {
+            const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + (x * 4)));
+
+            _mm_storeu_si128((__m128i*)(dst + (x * 8)),      _mm_unpacklo_epi32(pixels, pixels));
+            _mm_storeu_si128((__m128i*)(dst + (x * 8) + 16), _mm_unpackhi_epi32(pixels, pixels));
+        }
+    }
+    else if (Factor == 4)
+    {
+        for (; (x + 4) <= numPixels; x += 4)
+        {
+            const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + (x * 4)));
+
+            _mm_storeu_si128((__m128i*)(dst + (x * 16)),      _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 0, 0, 0)));
+            _mm_storeu_si128((__m128i*)(dst + (x * 16) + 16), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 1, 1, 1)));
+            _mm_storeu_si128((__m128i*)(dst + (x * 16) + 32), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 2, 2)));
+            _mm_storeu_si128((__m128i*)(dst + (x * 16) + 48), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+    }
+#endif
+
+    for (; x < numPixels; x++)
+    {
+        for (uint f = 0; f < Factor; f++)
+        {
+            memcpy((dst + (((x * Factor) + f) * 4)), (src + (x * 4)), 4);
+        }
+    }
+
+    return;
+}
+
+// As replicate_row(), but for any factor.
+//
+static void replicate_row_by(const u8 *const src, u8 *const dst, const uint numPixels, const uint factor)
+{
+    for (uint x = 0; x < numPixels; x++)
+    {
+        for (uint f = 0; f < factor; f++)
+        {
+            memcpy((dst + (((x * factor) + f) * 4)), (src + (x * 4)), 4);
+        }
+    }
+
+    return;
+}
+
+// Returns the average of a block of blockSize pixels whose channel values add up
+// to the given sum, rounded as OpenCV's area downscaling rounds the averages of
+// blocks other than 2 x 2: the single-precision product of the sum and the
+// block size's inverse, to the nearest value - and on a tie, to the even one.
+//
+static u8 rounded_block_average(const uint sum, const uint blockSize)
+{
+    return u8(std::min(255L, lrintf(float(sum) * (1.0f / blockSize))));
+}
+
+// Writes into dst the averages of the Factor x Factor blocks of pixels in the
+// given rows, which begin at src, pitch bytes apart. 2 x 2 blocks are rounded
+// half up; others as by rounded_block_average().
+//
+template <uint Factor>
+static void average_row(const u8 *const src, const uint pitch, u8 *const dst, const uint numPixels)
+{
+    static const uint blockSize = (Factor * Factor);
+    uint x = 0;
+
+#if __SSE2__
+    if (Factor == 2)
+    {
+        const __m128i rounding = _mm_set1_epi16(2);
+        const __m128i zero = _mm_setzero_si128();
+
+        // Two output pixels at a time, from four pixels of each of two rows.
+        for (; (x + 2) <= numPixels; x += 2)
+        {
+            const __m128i a = _mm_loadu_si128((const __m128i*)(src + (x * 8)));
+            const __m128i b = _mm_loadu_si128((const __m128i*)(src + pitch + (x * 8)));
+
+            const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            const __m128i sums = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+            const __m128i averages = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+
+            _mm_storel_epi64((__m128i*)(dst + (x * 4)), _mm_packus_epi16(averages, averages));
+        }
+    }
+#endif
+
+    for (; x < numPixels; x++)
+    {
+        for (uint c = 0; c < 4; c++)
+        {
+            uint sum = 0;
+
+            for (uint by = 0; by < Factor; by++)
+            {
+                for (uint bx = 0; bx < Factor; bx++)
+                {
+                    sum += src[(by * pitch) + (((x * Factor) + bx) * 4) + c];
+                }
+            }
+
+            dst[(x * 4) + c] = ((Factor == 2)? ((sum + (blockSize / 2)) / blockSize)
+                                : rounded_block_average(sum, blockSize));
+        }
+    }
+
+    return;
+}
+
+// As average_row(), but for blocks of any size other than 2 x 2.
+//
+static void average_row_by(const u8 *const src, const uint pitch, u8 *const dst, const uint numPixels,
+                           const uint factorX, const uint factorY)
+{
+    const uint blockSize = (factorX * factorY);
+
+    for (uint x = 0; x < numPixels; x++)
+    {
+        for (uint c = 0; c < 4; c++)
+        {
+            uint sum = 0;
+
+            for (uint by = 0; by < factorY; by++)
+            {
+                for (uint bx = 0; bx < factorX; bx++)
+                {
+                    sum += src[(by * pitch) + (((x * factorX) + bx) * 4) + c];
+                }
+            }
+
+            dst[(x * 4) + c] = rounded_block_average(sum, blockSize);
+        }
+    }
+
+    return;
+}
+
+// Upscales by replicating each pixel into a block of pixels. The output's size
+// is expected to be a whole multiple of the input's on both axes.
+//
+void kns_scale_integer_up(NATIVE_SCALER_FUNC_PARAMS)
+{
+    const resolution_s &srcRes = plan.srcRes;
+    const resolution_s &dstRes = plan.dstRes;
+
+    k_assert(kconv_can_convert_to_bgra(srcRes, plan.srcPixelFormat) && (dstRes.bpp == 32),
+             "The native scalers require convertible source pixels and 32-bit target color.");
+    k_assert(!(dstRes.w % srcRes.w) && !(dstRes.h % srcRes.h),
+             "Expected the output size to be a whole multiple of the input size.");
+
+    const uint factorX = (dstRes.w / srcRes.w);
+    const uint factorY = (dstRes.h / srcRes.h);
+    std::vector<u8> convertedRow(srcRes.w * 4);
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        u8 *const dstRow = (dst + (y * dstPitch));
+
+        // Each source row makes factorY identical output rows.
+        if ((y > firstRow) &&
+            (y % factorY))
+        {
+            memcpy(dstRow, (dstRow - dstPitch), (dstRes.w * 4));
+            continue;
+        }
+
+        const u8 *const srcRow = bgra_row(src, (y / factorY), plan, convertedRow.data());
+
+        switch (factorX)
+        {
+            case 1: memcpy(dstRow, srcRow, (srcRes.w * 4)); break;
+            case 2: replicate_row<2>(srcRow, dstRow, srcRes.w); break;
+            case 3: replicate_row<3>(srcRow, dstRow, srcRes.w); break;
+            case 4: replicate_row<4>(srcRow, dstRow, srcRes.w); break;
+            default: replicate_row_by(srcRow, dstRow, srcRes.w, factorX); break;
+        }
+    }
+
+    return;
+}
+
+// Downscales by averaging each block of pixels into one. The input's size is
+// expected to be a whole multiple of the output's on both axes.
+//
+void kns_scale_integer_down(NATIVE_SCALER_FUNC_PARAMS)
+{
+    const resolution_s &srcRes = plan.srcRes;
+    const resolution_s &dstRes = plan.dstRes;
+
+    k_assert(kconv_can_convert_to_bgra(srcRes, plan.srcPixelFormat) && (dstRes.bpp == 32),
+             "The native scalers require convertible source pixels and 32-bit target color.");
+    k_assert(!(srcRes.w % dstRes.w) && !(srcRes.h % dstRes.h),
+             "Expected the input size to be a whole multiple of the output size.");
+
+    const uint factorX = (srcRes.w / dstRes.w);
+    const uint factorY = (srcRes.h / dstRes.h);
+    const bool isBgra = kconv_is_bgra(srcRes, plan.srcPixelFormat);
+    const uint srcPitch = (srcRes.w * 4);
+    std::vector<u8> convertedRows(isBgra? 0 : (srcPitch * factorY));
+
+    for (uint y = firstRow; y < endRow; y++)
+    {
+        const u8 *srcRows = (src + (y * factorY * srcPitch));
+        u8 *const dstRow = (dst + (y * dstPitch));
+
+        // The rows of each block are averaged together, so they're converted
+        // into BGRA together.
+        if (!isBgra)
+        {
+            for (uint r = 0; r < factorY; r++)
+            {
+                bgra_row(src, ((y * factorY) + r), plan, (convertedRows.data() + (r * srcPitch)));
+            }
+
+            srcRows = convertedRows.data();
+        }
+
+        if ((factorX == factorY) && (factorX == 2))      average_row<2>(srcRows, srcPitch, dstRow, dstRes.w);
+        else if ((factorX == factorY) && (factorX == 3)) average_row<3>(srcRows, srcPitch, dstRow, dstRes.w);
+        else if ((factorX == factorY) && (factorX == 4)) average_row<4>(srcRows, srcPitch, dstRow, dstRes.w);
+        else average_row_by(srcRows, srcPitch, dstRow, dstRes.w, factorX, factorY);
+    }
+
+    return;
+}
@@ -0,0 +1,72 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ */
+
+#ifndef NATIVE_SCALER_H
+#define NATIVE_SCALER_H
+
+#include <vector>
+#include "capture/capture.h"
+#include "common/globals.h"
+
+// For bilinear scaling, the source pixels (or rows) that an output pixel (or row)
+// is blended from: the one at idx, and the one after it, with the given weight
+// for the latter.
+struct linear_sample_s
+{
+    uint idx;
+    uint weight;
+};
+
+// What the native scalers need to know about scaling pixels from one size to
+// another, worked out in advance by kns_make_plan(); so that a plan can be made
+// once and reused for as long as the sizes don't change.
+struct native_scaling_plan_s
+{
+    resolution_s srcRes;
+    resolution_s dstRes;
+
+    // The format of the source pixels; which, if they're not in BGRA, are
+    // converted into it a row at a time as they're scaled.
+    PIXELFORMAT srcPixelFormat;
+
+    // For nearest-neighbor scaling, the source column and row of each output
+    // column and row.
+    std::vector<uint> nearestColumns;
+    std::vector<uint> nearestRows;
+
+    // For bilinear scaling, the source columns and rows that each output column
+    // and row is blended from.
+    std::vector<linear_sample_s> linearColumns;
+    std::vector<linear_sample_s> linearRows;
+};
+
+// The signature of VCS's own scaling functions, which scale the pixels in src
+// into BGRA in dst according to the given plan. Each row of dst begins dstPitch
+// bytes after the previous one, so that dst can be an area of a larger image.
+// Only the output rows from firstRow up to but not including endRow are written,
+// so that an image can be scaled in bands; each band coming out the same as it
+// would as part of the whole.
+#define NATIVE_SCALER_FUNC_PARAMS const u8 *const src, u8 *const dst, const uint dstPitch, const native_scaling_plan_s &plan, const uint firstRow, const uint endRow
+typedef void(*native_scaler_func_t)(NATIVE_SCALER_FUNC_PARAMS);
+
+void kns_make_plan(native_scaling_plan_s *const plan, const resolution_s &srcRes, const PIXELFORMAT srcPixelFormat,
+                   const resolution_s &dstRes);
+
+void kns_scale_nearest(NATIVE_SCALER_FUNC_PARAMS);
+
+void kns_scale_linear(NATIVE_SCALER_FUNC_PARAMS);
+
+void kns_scale_nearest_vertical(NATIVE_SCALER_FUNC_PARAMS);
+
+void kns_scale_linear_vertical(NATIVE_SCALER_FUNC_PARAMS);
+
+void kns_scale_linear_horizontal(NATIVE_SCALER_FUNC_PARAMS);
+
+void kns_scale_integer_up(NATIVE_SCALER_FUNC_PARAMS);
+
+void kns_scale_integer_down(NATIVE_SCALER_FUNC_PARAMS);
+
+#endif
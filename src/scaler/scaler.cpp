@@ -10,13 +10,23 @@
 #include <cstring>
 #include <vector>
 #include <cmath>
+#include <atomic>
+#include <list>
+#include "filter/active_area.h"
 #include "filter/anti_tear.h"
+#include "filter/auto_align.h"
+#include "capture/capture_dump.h"
+#include "capture/frame_dedup.h"
+#include "common/command_line.h"
 #include "common/propagate.h"
+#include "common/parallel.h"
 #include "capture/capture.h"
 #include "display/display.h"
 #include "common/globals.h"
 #include "common/memory.h"
 #include "filter/filter.h"
+#include "scaler/color_conversion.h"
+#include "scaler/native_scaler.h"
 #include "record/record.h"
 #include "scaler/scaler.h"
 
@@ -30,31 +40,168 @@ void s_scaler_linear(SCALER_FUNC_PARAMS);
 void s_scaler_area(SCALER_FUNC_PARAMS);
 void s_scaler_cubic(SCALER_FUNC_PARAMS);
 void s_scaler_lanczos(SCALER_FUNC_PARAMS);
+void s_scaler_native_nearest(SCALER_FUNC_PARAMS);
+void s_scaler_native_linear(SCALER_FUNC_PARAMS);
 
 static const scaling_filter_s *UPSCALE_FILTER = nullptr;
 static const scaling_filter_s *DOWNSCALE_FILTER = nullptr;
 static const std::vector<scaling_filter_s> SCALING_FILTERS =    // User-facing scaling filters. Note that these names will be shown in the GUI.
 #ifdef USE_OPENCV
-                {{"Nearest", &s_scaler_nearest},
-                 {"Linear",  &s_scaler_linear},
-                 {"Area",    &s_scaler_area},
-                 {"Cubic",   &s_scaler_cubic},
-                 {"Lanczos", &s_scaler_lanczos}};
+                {{"Nearest",          &s_scaler_nearest},
+                 {"Linear",           &s_scaler_linear},
+                 {"Area",             &s_scaler_area},
+                 {"Cubic",            &s_scaler_cubic},
+                 {"Lanczos",          &s_scaler_lanczos},
+                 {"Nearest (native)", &s_scaler_native_nearest},
+                 {"Linear (native)",  &s_scaler_native_linear}};
 #else
-                {{"Nearest", &s_scaler_nearest}};
+                {{"Nearest", &s_scaler_native_nearest},
+                 {"Linear",  &s_scaler_native_linear}};
 #endif
 
-// The pixel buffer where scaled frames are to be placed.
-static heap_bytes_s<u8> OUTPUT_BUFFER;
+// A pixel buffer into which scaled frames are placed.
+struct output_buffer_s
+{
+    heap_bytes_s<u8> pixels;
+
+    // An area of the buffer, of the given output size, outside of which the
+    // buffer is known to be all black; so that when images are placed into the
+    // same area frame after frame, their borders needn't be filled in again
+    // each time. Of zero size if the buffer isn't known to have black borders.
+    frame_area_s blackBorderArea;
+    resolution_s blackBorderRes;
+};
+
+// The scaler's output is triple-buffered. Frames are scaled into the back buffer,
+// which nothing else reads, and then published as the latest complete output by
+// swapping the back buffer with the middle one. Readers of the output take the
+// latest published output as the front buffer by swapping it in turn with the
+// middle one, and can then read it undisturbed until they next ask for the
+// output; so that scaling needn't wait on the output being read, nor the output
+// ever be seen half-scaled. The readers share the front buffer, and are expected
+// to ask for it from the same thread.
+static const uint NUM_OUTPUT_BUFFERS = 3;
+
+// Set in the index of the middle buffer if it holds output published since the
+// readers last took the front buffer.
+static const uint NEW_OUTPUT_FLAG = 0x100;
 
 // Scratch buffers.
 static heap_bytes_s<u8> COLORCONV_BUFFER;
-static heap_bytes_s<u8> TMP_BUFFER;
+
+// Where the frame being scaled is also to be output in packed 24-bit BGR - the
+// recorder's next frame slot, while BGR output is enabled -, or nullptr; and
+// whether it's been output there yet. Set by ks_scale_frame().
+static u8 *BGR_TARGET = nullptr;
+static bool IS_BGR_TARGET_FILLED = false;
+
+// How frames of a given size - or a given part of them, e.g. their active area -
+// are scaled to a given output size with the current scaler settings; worked out
+// in advance, so that it needn't be for each frame. See scaling_plan().
+struct scaling_plan_s
+{
+    // What the plan is for. The frame's pixels are in the given bit depth and
+    // pixel format; for frames converted into BGRA before scaling, 32-bit 888.
+    resolution_s frameRes;
+    PIXELFORMAT pixelFormat;
+    frame_area_s frameArea;
+    resolution_s outputRes;
+    aspect_mode_e aspectMode;
+    bool forceAspect;
+
+    // The scaling filter to use; or nullptr if there's none.
+    const scaling_filter_s *filter;
+
+    // Whether the frame is output as it is, without scaling.
+    bool isUnscaled;
+
+    // The area of the output buffer into which the scaled image goes; the rest
+    // of the output being filled with black.
+    frame_area_s outputImageArea;
+
+    // If the scaling can be done by one of VCS's own scalers, that scaler; or
+    // nullptr. Besides the native filters, scaling by whole numbers has faster
+    // specialized versions that give the same result as the filter - for area
+    // downscaling, with the averages rounded as OpenCV rounds them.
+    native_scaler_func_t nativeScaler;
+
+    // For the native scalers, for scaling the frame area into the output image
+    // area.
+    native_scaling_plan_s nativePlan;
+};
+
+static const uint MAX_NUM_SCALING_PLANS = 16;
+
+// The scaler's state for one capture source. Each source's frames are scaled in
+// a pipeline of their own, so that the background sources' frames can be scaled
+// - e.g. for recording - alongside the selected source's without overwriting its
+// output, and without their plans crowding out its plans. The pipeline in use is
+// that of the capture source being processed; see kc_active_source_idx().
+struct scaler_pipeline_s
+{
+    // The output buffers, and the indices of the back and front buffers among
+    // them; and the index of the middle buffer, with NEW_OUTPUT_FLAG set as
+    // described for it.
+    output_buffer_s outputBuffers[NUM_OUTPUT_BUFFERS];
+    uint backBufferIdx = 0;
+    uint frontBufferIdx = 1;
+    std::atomic<uint> middleBuffer{2};
+
+    // Whether the frames are also output in BGR. See ks_set_bgr_output_enabled().
+    bool isBgrOutputEnabled = false;
+
+    // Where the latest output's pixels are in BGR, or nullptr if they aren't.
+    const u8 *latestBgrOutput = nullptr;
+
+    // The plans made so far, the most recently made last. They're discarded when
+    // the scaler settings they depend on change.
+    std::list<scaling_plan_s> scalingPlans;
+
+    // The size of the image currently in the output buffer.
+    resolution_s latestOutputSize = {0, 0, 0};
+
+    // The capture metadata of the frame from which the latest published output
+    // was produced. When anti-tearing assembles the image out of several frames,
+    // this is the frame that completed it.
+    captured_frame_meta_s latestOutputMeta;
+
+    // The value of OUTPUT_VERSION when the latest output was published.
+    u32 outputVersion = 0;
+};
+
+static scaler_pipeline_s PIPELINES[MAX_INPUT_CHANNELS];
+
+// Returns the pipeline of the capture source that's being processed.
+//
+static scaler_pipeline_s& pipeline(void)
+{
+    return PIPELINES[kc_active_source_idx()];
+}
+
+// Discards the scaling plans made so far, e.g. because the settings they were
+// made with have changed.
+//
+static void invalidate_scaling_plans(void)
+{
+    for (scaler_pipeline_s &p: PIPELINES)
+    {
+        p.scalingPlans.clear();
+    }
+
+    return;
+}
+
+// The plan of the frame currently being scaled. Set by ks_scale_frame() for the
+// scaling filters to use.
+static const scaling_plan_s *CURRENT_PLAN = nullptr;
 
 static aspect_mode_e ASPECT_MODE = aspect_mode_e::native;
 static bool FORCE_ASPECT = true;
 
-static resolution_s LATEST_OUTPUT_SIZE = {0};       // The size of the image currently in the scaler's output buffer.
+// Incremented each time new output is published in any of the pipelines, so that
+// e.g. the display can tell whether it needs to re-upload it; also when it's
+// switched over to another capture source.
+static u32 OUTPUT_VERSION = 0;
 
 static const u32 OUTPUT_BIT_DEPTH = 32;             // The bit depth we're currently scaling to.
 
@@ -68,6 +215,7 @@ static bool FORCE_SCALING = false;
 void ks_set_aspect_mode(const aspect_mode_e mode)
 {
     ASPECT_MODE = mode;
+    invalidate_scaling_plans();
 
     return;
 }
@@ -153,7 +301,6 @@ bool ks_is_forced_aspect_enabled(void)
     return FORCE_ASPECT;
 }
 
-#if USE_OPENCV
 // Returns a resolution corresponding to sourceRes scaled up to targetRes but
 // maintaining sourceRes's aspect ratio according to the scaler's current aspect
 // mode.
@@ -195,30 +342,334 @@ static resolution_s padded_resolution(const resolution_s &sourceRes, const resol
     return {w, h, OUTPUT_BIT_DEPTH};
 }
 
-// Returns border padding sizes for cv::copyMakeBorder()
+// Returns the area of an output of size outputRes that's covered by the image
+// of a frame of size frameRes whose pixels are the given part of it (e.g. its
+// active area), when the frame is scaled to the output. With forced aspect, the
+// frame's image is padded out to the output's size, and centered.
+//
+static frame_area_s output_image_area(const resolution_s &frameRes,
+                                      const frame_area_s &frameArea,
+                                      const resolution_s &outputRes)
+{
+    const resolution_s imageRes = (FORCE_ASPECT? padded_resolution(frameRes, outputRes) : outputRes);
+    const uint left = ((outputRes.w - imageRes.w) / 2);
+    const uint top = ((outputRes.h - imageRes.h) / 2);
+
+    const auto to_output = [](const uint coord, const uint frameSize, const uint imageSize)->uint
+    {
+        return std::round(coord * (imageSize / real(frameSize)));
+    };
+
+    const uint x1 = to_output(frameArea.x, frameRes.w, imageRes.w);
+    const uint y1 = to_output(frameArea.y, frameRes.h, imageRes.h);
+    const uint x2 = std::max((x1 + 1), to_output((frameArea.x + frameArea.w), frameRes.w, imageRes.w));
+    const uint y2 = std::max((y1 + 1), to_output((frameArea.y + frameArea.h), frameRes.h, imageRes.h));
+
+    return {(left + x1), (top + y1), (x2 - x1), (y2 - y1)};
+}
+
+// Returns the output buffer into which frames are currently being scaled.
+//
+static heap_bytes_s<u8>& back_buffer(void)
+{
+    return pipeline().outputBuffers[pipeline().backBufferIdx].pixels;
+}
+
+// Publishes the back buffer's contents as the latest complete output, and takes
+// over the buffer that held the previous one as the new back buffer.
+//
+static void publish_output(void)
+{
+    scaler_pipeline_s &p = pipeline();
+
+    p.backBufferIdx = (p.middleBuffer.exchange(p.backBufferIdx | NEW_OUTPUT_FLAG) & ~NEW_OUTPUT_FLAG);
+    p.outputVersion = ++OUTPUT_VERSION;
+
+    return;
+}
+
+// Returns the output buffer holding the latest complete output, which stays as it
+// is - the scaler writing into other buffers - until this function is next called.
+//
+static const output_buffer_s& front_buffer(void)
+{
+    scaler_pipeline_s &p = pipeline();
+
+    // Take the latest published output, if there's any since we last took it.
+    if (p.middleBuffer.load() & NEW_OUTPUT_FLAG)
+    {
+        p.frontBufferIdx = (p.middleBuffer.exchange(p.frontBufferIdx) & ~NEW_OUTPUT_FLAG);
+    }
+
+    return p.outputBuffers[p.frontBufferIdx];
+}
+
+// Returns the output buffer into which frames are currently being scaled, along
+// with its other properties.
+//
+static output_buffer_s& back_output_buffer(void)
+{
+    return pipeline().outputBuffers[pipeline().backBufferIdx];
+}
+
+// Converts the given rows of the back buffer's pixels, of the given output size,
+// into BGR in BGR_TARGET.
+//
+static void convert_output_rows_to_bgr(const uint firstRow, const uint endRow, const resolution_s &outputRes)
+{
+    kconv_convert_bgra_row_to_bgr((back_buffer().ptr() + (firstRow * outputRes.w * 4)),
+                                  (BGR_TARGET + (firstRow * outputRes.w * 3)),
+                                  ((endRow - firstRow) * outputRes.w));
+
+    return;
+}
+
+// Outputs the back buffer's pixels, of the given size, into BGR_TARGET in BGR.
+//
+static void make_bgr_output(const resolution_s &outputRes)
+{
+    kpar_run_in_bands(outputRes.h, [&](const uint firstRow, const uint endRow)
+    {
+        convert_output_rows_to_bgr(firstRow, endRow, outputRes);
+    });
+
+    IS_BGR_TARGET_FILLED = true;
+
+    return;
+}
+
+// Returns true if the given area covers all of an image of the given size.
+//
+static bool is_full_area(const frame_area_s &area, const resolution_s &r)
+{
+    return ((area.x == 0) &&
+            (area.y == 0) &&
+            (area.w == r.w) &&
+            (area.h == r.h));
+}
+
+// Fills with black the parts of the output buffer, of the given size, that lie
+// outside the given area.
+//
+static void fill_output_border(const frame_area_s &area, const resolution_s &outputRes)
+{
+    u8 *const output = back_buffer().ptr();
+    const uint pitch = (outputRes.w * 4);
+
+    memset(output, 0, (area.y * pitch));
+    memset((output + ((area.y + area.h) * pitch)), 0, ((outputRes.h - area.y - area.h) * pitch));
+
+    for (uint y = area.y; y < (area.y + area.h); y++)
+    {
+        memset((output + (y * pitch)), 0, (area.x * 4));
+        memset((output + (y * pitch) + ((area.x + area.w) * 4)), 0, ((outputRes.w - area.x - area.w) * 4));
+    }
+
+    return;
+}
+
+// To be called when the output buffer's borders may no longer be black, e.g.
+// because an image covering all of the output was placed into it.
 //
-static cv::Vec4i border_padding(const resolution_s &paddedRes, const resolution_s &targetRes)
+static void forget_black_border(void)
 {
-    cv::Vec4i p;
+    back_output_buffer().blackBorderArea = {0, 0, 0, 0};
 
-    p[0] = ((targetRes.h - paddedRes.h) / 2);     // Top.
-    p[1] = ((targetRes.h - paddedRes.h + 1) / 2); // Bottom.
-    p[2] = ((targetRes.w - paddedRes.w) / 2);     // Left.
-    p[3] = ((targetRes.w - paddedRes.w + 1) / 2); // Right.
+    return;
+}
+
+// Prepares the output buffer, of the given size, for an image to be placed into
+// the given area of it, by filling the rest of the output with black; unless it's
+// known to be black already.
+//
+static void prepare_output_area(const frame_area_s &area, const resolution_s &outputRes)
+{
+    output_buffer_s &buffer = back_output_buffer();
+
+    if (is_full_area(area, outputRes))
+    {
+        forget_black_border();
 
-    return p;
+        return;
+    }
+
+    if ((area.x == buffer.blackBorderArea.x) &&
+        (area.y == buffer.blackBorderArea.y) &&
+        (area.w == buffer.blackBorderArea.w) &&
+        (area.h == buffer.blackBorderArea.h) &&
+        (outputRes.w == buffer.blackBorderRes.w) &&
+        (outputRes.h == buffer.blackBorderRes.h))
+    {
+        return;
+    }
+
+    fill_output_border(area, outputRes);
+
+    buffer.blackBorderArea = area;
+    buffer.blackBorderRes = outputRes;
+
+    return;
 }
 
-// Copies src into dsts and adds a border of the given size.
+// Copies the given pixels, which make up an image of the given area's size, into
+// the given area of the output buffer, filling the rest of the output with black.
 //
-void copy_with_border(const cv::Mat &src, cv::Mat &dst, const cv::Vec4i &borderSides)
+static void copy_to_output_area(const u8 *const pixels, const frame_area_s &area, const resolution_s &outputRes)
 {
-    cv::copyMakeBorder(src, dst, borderSides[0], borderSides[1], borderSides[2], borderSides[3], cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+    prepare_output_area(area, outputRes);
+
+    if (is_full_area(area, outputRes))
+    {
+        memcpy(back_buffer().ptr(), pixels, back_buffer().up_to(area.w * area.h * 4));
+
+        return;
+    }
+
+    for (uint y = 0; y < area.h; y++)
+    {
+        memcpy(back_buffer().ptr() + (((area.y + y) * outputRes.w) + area.x) * 4,
+               (pixels + (y * area.w * 4)),
+               (area.w * 4));
+    }
+
+    return;
+}
+
+// Reduces the given frame's pixels in place to just those in the given area of
+// it; i.e. to an image of the area's size.
+//
+static void crop_to_area(u8 *const pixels, const resolution_s &r, const frame_area_s &area)
+{
+    // Each row moves to a lower address, so they can be moved in order.
+    for (uint y = 0; y < area.h; y++)
+    {
+        memmove((pixels + (y * area.w * 4)),
+                (pixels + ((((area.y + y) * r.w) + area.x) * 4)),
+                (area.w * 4));
+    }
 
     return;
 }
 
-// Scales the given pixel data using OpenCV.
+// Scales the given pixel data using the given one of VCS's own scalers, into the
+// current plan's output image area, filling the rest of the output with black.
+// The scaling is split into bands of rows across the worker threads. If the frame
+// is also to be output in BGR, each band's rows are converted into it as soon as
+// they've been scaled, while they're still in the cache.
+//
+static void native_scale(const u8 *const pixelData,
+                         const resolution_s &targetRes,
+                         const native_scaler_func_t scale)
+{
+    const frame_area_s &area = CURRENT_PLAN->outputImageArea;
+
+    k_assert(((area.x + area.w) <= targetRes.w) &&
+             ((area.y + area.h) <= targetRes.h),
+             "The output image area exceeds the bounds of the output.");
+
+    prepare_output_area(area, targetRes);
+
+    u8 *const dst = (back_buffer().ptr() + (((area.y * targetRes.w) + area.x) * 4));
+    const native_scaling_plan_s &plan = CURRENT_PLAN->nativePlan;
+
+    kpar_run_in_bands(area.h, [&](const uint firstRow, const uint endRow)
+    {
+        scale(pixelData, dst, (targetRes.w * 4), plan, firstRow, endRow);
+
+        if (BGR_TARGET)
+        {
+            convert_output_rows_to_bgr((area.y + firstRow), (area.y + endRow), targetRes);
+        }
+    });
+
+    // The rows above and below the image area are black.
+    if (BGR_TARGET)
+    {
+        const uint bgrPitch = (targetRes.w * 3);
+
+        memset(BGR_TARGET, 0, (area.y * bgrPitch));
+        memset((BGR_TARGET + ((area.y + area.h) * bgrPitch)), 0, ((targetRes.h - area.y - area.h) * bgrPitch));
+
+        IS_BGR_TARGET_FILLED = true;
+    }
+
+    return;
+}
+
+// Returns one of VCS's own whole-number ratio scalers, if scaling an image of size
+// sourceRes to the given output image area with the given filter would amount to
+// replicating each pixel into a block of pixels (nearest-neighbor upscaling), or
+// each block of pixels into one (area downscaling) or taking one pixel of each
+// block (nearest-neighbor downscaling); or otherwise nullptr.
+//
+static native_scaler_func_t integer_ratio_scaler(const scaling_filter_s *const filter,
+                                                 const resolution_s &sourceRes,
+                                                 const frame_area_s &area)
+{
+    const bool isNearest = ((filter->scale == s_scaler_nearest) ||
+                            (filter->scale == s_scaler_native_nearest));
+
+    if ((area.w >= sourceRes.w) &&
+        (area.h >= sourceRes.h) &&
+        !(area.w % sourceRes.w) &&
+        !(area.h % sourceRes.h))
+    {
+        return (isNearest? kns_scale_integer_up : nullptr);
+    }
+    else if ((area.w <= sourceRes.w) &&
+             (area.h <= sourceRes.h) &&
+             !(sourceRes.w % area.w) &&
+             !(sourceRes.h % area.h))
+    {
+        return ((filter->scale == s_scaler_area)? kns_scale_integer_down
+                : isNearest? kns_scale_nearest
+                : nullptr);
+    }
+
+    return nullptr;
+}
+
+// Returns one of VCS's own single-axis scalers, if scaling an image of size
+// sourceRes to the given output image area with the given filter changes only one
+// of its dimensions - e.g. 720 x 400 to 720 x 540 - so that the other needn't be
+// resampled; or otherwise nullptr. OpenCV's nearest-neighbor filter is stood in
+// for too, as VCS's own picks the same pixels. OpenCV's other filters are left to
+// cv::resize(), as a one-axis version of them wouldn't give quite the same result.
+//
+static native_scaler_func_t single_axis_scaler(const scaling_filter_s *const filter,
+                                               const resolution_s &sourceRes,
+                                               const frame_area_s &area)
+{
+    const bool isWidthUnchanged = (area.w == sourceRes.w);
+    const bool isHeightUnchanged = (area.h == sourceRes.h);
+
+    if (filter->scale == s_scaler_native_nearest)
+    {
+        // Nearest-neighbor scaling across a row is already done in one pass.
+        return (isWidthUnchanged? kns_scale_nearest_vertical : nullptr);
+    }
+    else if (filter->scale == s_scaler_nearest)
+    {
+        // With the rows unchanged, the general nearest-neighbor scaler amounts to
+        // one that scales only across the rows, as each source row is copied out
+        // just the once.
+        return (isWidthUnchanged? kns_scale_nearest_vertical
+                : isHeightUnchanged? kns_scale_nearest
+                : nullptr);
+    }
+    else if (filter->scale == s_scaler_native_linear)
+    {
+        return (isWidthUnchanged? kns_scale_linear_vertical
+                : isHeightUnchanged? kns_scale_linear_horizontal
+                : nullptr);
+    }
+
+    return nullptr;
+}
+
+#if USE_OPENCV
+// Scales the given pixel data using OpenCV into the current plan's output image
+// area, filling the rest of the output with black.
 //
 void opencv_scale(u8 *const pixelData,
                   u8 *const outputBuffer,
@@ -226,30 +677,16 @@ void opencv_scale(u8 *const pixelData,
                   const resolution_s &targetRes,
                   const cv::InterpolationFlags interpolator)
 {
+    const frame_area_s &area = CURRENT_PLAN->outputImageArea;
     cv::Mat scratch = cv::Mat(sourceRes.h, sourceRes.w, CV_8UC4, pixelData);
     cv::Mat output = cv::Mat(targetRes.h, targetRes.w, CV_8UC4, outputBuffer);
 
-    if (ks_is_forced_aspect_enabled())
-    {
-        const resolution_s paddedRes = padded_resolution(sourceRes, targetRes);
-        cv::Mat tmp = cv::Mat(paddedRes.h, paddedRes.w, CV_8UC4, TMP_BUFFER.ptr());
+    prepare_output_area(area, targetRes);
 
-        if ((paddedRes.h == targetRes.h) &&
-            (paddedRes.w == targetRes.w))
-        {
-            // No padding is needed, so we can resize directly into the output buffer.
-            cv::resize(scratch, output, output.size(), 0, 0, interpolator);
-        }
-        else
-        {
-            cv::resize(scratch, tmp, tmp.size(), 0, 0, interpolator);
-            copy_with_border(tmp, output, border_padding(paddedRes, targetRes));
-        }
-    }
-    else
-    {
-        cv::resize(scratch, output, output.size(), 0, 0, interpolator);
-    }
+    // Resize straight into the image area. As the area's size matches the
+    // requested size, OpenCV writes into it rather than reallocating.
+    cv::Mat outputArea = output(cv::Rect(area.x, area.y, area.w, area.h));
+    cv::resize(scratch, outputArea, outputArea.size(), 0, 0, interpolator);
 
     return;
 }
@@ -266,9 +703,8 @@ void s_scaler_nearest(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_NEAREST);
+        opencv_scale(pixelData, back_buffer().ptr(), sourceRes, targetRes, cv::INTER_NEAREST);
     #else
-        /// TODO. Implement a non-OpenCV nearest scaler so there's a basic fallback.
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
 
@@ -285,7 +721,7 @@ void s_scaler_linear(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_LINEAR);
+        opencv_scale(pixelData, back_buffer().ptr(), sourceRes, targetRes, cv::INTER_LINEAR);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -303,7 +739,7 @@ void s_scaler_area(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_AREA);
+        opencv_scale(pixelData, back_buffer().ptr(), sourceRes, targetRes, cv::INTER_AREA);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -321,7 +757,7 @@ void s_scaler_cubic(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_CUBIC);
+        opencv_scale(pixelData, back_buffer().ptr(), sourceRes, targetRes, cv::INTER_CUBIC);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -339,7 +775,7 @@ void s_scaler_lanczos(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_LANCZOS4);
+        opencv_scale(pixelData, back_buffer().ptr(), sourceRes, targetRes, cv::INTER_LANCZOS4);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -347,6 +783,34 @@ void s_scaler_lanczos(SCALER_FUNC_PARAMS)
     return;
 }
 
+void s_scaler_native_nearest(SCALER_FUNC_PARAMS)
+{
+    k_assert((sourceRes.bpp == 32) && (targetRes.bpp == 32),
+             "This filter requires 32-bit source and target color.")
+    if (pixelData == nullptr)
+    {
+        return;
+    }
+
+    native_scale(pixelData, targetRes, kns_scale_nearest);
+
+    return;
+}
+
+void s_scaler_native_linear(SCALER_FUNC_PARAMS)
+{
+    k_assert((sourceRes.bpp == 32) && (targetRes.bpp == 32),
+             "This filter requires 32-bit source and target color.")
+    if (pixelData == nullptr)
+    {
+        return;
+    }
+
+    native_scale(pixelData, targetRes, kns_scale_linear);
+
+    return;
+}
+
 uint ks_max_output_bit_depth(void)
 {
     return MAX_OUTPUT_BPP;
@@ -374,13 +838,25 @@ void ks_initialize_scaler(void)
 {
     INFO(("Initializing the scaler."));
 
+    kpar_initialize(kcom_num_scaler_threads());
+
     #if USE_OPENCV
         cv::redirectError(cv_error_handler);
+
+        // OpenCV splits its scaling into bands of rows by itself.
+        cv::setNumThreads(kpar_num_threads());
     #endif
 
-    OUTPUT_BUFFER.alloc(MAX_FRAME_SIZE, "Scaler output buffer");
+    // Each of the capture sources gets a pipeline of its own.
+    for (uint i = 0; i < kcom_input_channels().size(); i++)
+    {
+        for (output_buffer_s &buffer: PIPELINES[i].outputBuffers)
+        {
+            buffer.pixels.alloc(MAX_FRAME_SIZE, "Scaler output buffer");
+            buffer.blackBorderArea = {0, 0, 0, 0};
+        }
+    }
     COLORCONV_BUFFER.alloc(MAX_FRAME_SIZE, "Scaler color convertion buffer");
-    TMP_BUFFER.alloc(MAX_FRAME_SIZE, "Scaler scratch buffer");
 
     ks_set_upscaling_filter(SCALING_FILTERS.at(0).name);
     ks_set_downscaling_filter(SCALING_FILTERS.at(0).name);
@@ -392,61 +868,142 @@ void ks_release_scaler(void)
 {
     INFO(("Releasing the scaler."));
 
+    kpar_release();
+
     COLORCONV_BUFFER.release_memory();
-    OUTPUT_BUFFER.release_memory();
-    TMP_BUFFER.release_memory();
+    for (scaler_pipeline_s &p: PIPELINES)
+    {
+        for (output_buffer_s &buffer: p.outputBuffers)
+        {
+            if (!buffer.pixels.is_null())
+            {
+                buffer.pixels.release_memory();
+            }
+        }
+    }
 
     return;
 }
 
-// Converts the given frame to BGRA format.
+// Returns true if a frame of the given resolution would be output as it is, i.e.
+// without being scaled.
 //
-void s_convert_frame_to_bgra(const captured_frame_s &frame)
+static bool is_unscaled_output(const resolution_s &frameRes, const resolution_s &outputRes)
 {
-    #ifdef USE_OPENCV
-        u32 conversionType = 0;
-        const u32 numColorChan = (frame.r.bpp / 8);
-
-        cv::Mat input = cv::Mat(frame.r.h, frame.r.w, CV_MAKETYPE(CV_8U,numColorChan), frame.pixels.ptr());
-        cv::Mat colorConv = cv::Mat(frame.r.h, frame.r.w, CV_8UC4, COLORCONV_BUFFER.ptr());
+    return ((!FORCE_ASPECT || ASPECT_MODE == aspect_mode_e::native) &&
+            frameRes.w == outputRes.w &&
+            frameRes.h == outputRes.h);
+}
 
-        k_assert(!COLORCONV_BUFFER.is_null(),
-                 "Was asked to convert a frame's color depth, but the color conversion buffer "
-                 "was null.");
+// Returns the plan for scaling the given area of frames of size frameRes, whose
+// pixels are of the given format, to an output of size outputRes with the
+// current scaler settings; making it, if it hasn't been made already.
+//
+static const scaling_plan_s& scaling_plan(const resolution_s &frameRes,
+                                          const PIXELFORMAT pixelFormat,
+                                          const frame_area_s &frameArea,
+                                          const resolution_s &outputRes)
+{
+    std::list<scaling_plan_s> &plans = pipeline().scalingPlans;
 
-        if (kc_pixel_format() == RGB_PIXELFORMAT_565)
+    for (const scaling_plan_s &plan: plans)
+    {
+        if ((plan.frameRes.w == frameRes.w) &&
+            (plan.frameRes.h == frameRes.h) &&
+            (plan.frameRes.bpp == frameRes.bpp) &&
+            (plan.pixelFormat == pixelFormat) &&
+            (plan.frameArea.x == frameArea.x) &&
+            (plan.frameArea.y == frameArea.y) &&
+            (plan.frameArea.w == frameArea.w) &&
+            (plan.frameArea.h == frameArea.h) &&
+            (plan.outputRes.w == outputRes.w) &&
+            (plan.outputRes.h == outputRes.h) &&
+            (plan.aspectMode == ASPECT_MODE) &&
+            (plan.forceAspect == FORCE_ASPECT))
         {
-            conversionType = CV_BGR5652BGRA;
+            return plan;
         }
-        else if (kc_pixel_format() == RGB_PIXELFORMAT_555)
+    }
+
+    if (plans.size() >= MAX_NUM_SCALING_PLANS)
+    {
+        plans.pop_front();
+    }
+
+    plans.push_back(scaling_plan_s());
+    scaling_plan_s &plan = plans.back();
+
+    plan.frameRes = frameRes;
+    plan.pixelFormat = pixelFormat;
+    plan.frameArea = frameArea;
+    plan.outputRes = outputRes;
+    plan.aspectMode = ASPECT_MODE;
+    plan.forceAspect = FORCE_ASPECT;
+    plan.filter = (((frameRes.w < outputRes.w) || (frameRes.h < outputRes.h))? UPSCALE_FILTER : DOWNSCALE_FILTER);
+    plan.isUnscaled = is_unscaled_output(frameRes, outputRes);
+    plan.outputImageArea = output_image_area(frameRes, frameArea, outputRes);
+    plan.nativeScaler = nullptr;
+
+    if (!plan.isUnscaled &&
+        plan.filter)
+    {
+        const resolution_s areaRes = {frameArea.w, frameArea.h, frameRes.bpp};
+
+        plan.nativeScaler = integer_ratio_scaler(plan.filter, areaRes, plan.outputImageArea);
+
+        if (!plan.nativeScaler)
         {
-            conversionType = CV_BGR5552BGRA;
+            plan.nativeScaler = single_axis_scaler(plan.filter, areaRes, plan.outputImageArea);
         }
-        else // The third pixel format we recognize is RGB_PIXELFORMAT_888; it should never need this conversion, as it arrives in BGRA.
-        {
-            // k_assert(0, "Was asked to scale a frame from an unknown pixel format.");
-             NBENE(("Detected an unknown output pixel format (depth: %u) while converting a frame to BGRA. Attempting to guess its type...",
-                    frame.r.bpp));
 
-            if (frame.r.bpp == 32)
-            {
-                conversionType = CV_RGBA2BGRA;
-            }
-            if (frame.r.bpp == 24)
-            {
-                conversionType = CV_BGR2BGRA;
-            }
-            else
-            {
-                conversionType = CV_BGR5652BGRA;
-            }
+        if (!plan.nativeScaler)
+        {
+            plan.nativeScaler = ((plan.filter->scale == s_scaler_native_nearest)? kns_scale_nearest
+                                 : (plan.filter->scale == s_scaler_native_linear)? kns_scale_linear
+                                 : nullptr);
         }
 
-        cv::cvtColor(input, colorConv, conversionType);
-    #else
-        (void)frame;
-        k_assert(0, "Was asked to convert the frame to BGRA, but OpenCV had been disabled in the build. Can't do it.");
-    #endif
+        kns_make_plan(&plan.nativePlan, areaRes, pixelFormat, {plan.outputImageArea.w, plan.outputImageArea.h, OUTPUT_BIT_DEPTH});
+    }
+
+    DEBUG(("Made a plan for scaling %lu x %lu (%u x %u of it) to %lu x %lu.",
+           frameRes.w, frameRes.h, frameArea.w, frameArea.h, outputRes.w, outputRes.h));
+
+    return plan;
+}
+
+// Makes ahead of time the plans for scaling the whole of the active capture
+// source's frames in its current video mode to the current output size, and has
+// the filters find the chain that applies to them; so that, after a mode switch,
+// the first frame in the new mode needn't wait for these. Plans for frames'
+// active areas, or for frames the capture hardware has downscaled, are still
+// made as such frames come in.
+//
+void ks_prepare_for_capture_mode(void)
+{
+    const resolution_s captureRes = kc_hardware().status.capture_resolution();
+    const resolution_s frameRes = {captureRes.w, captureRes.h, kc_output_color_depth()};
+    const PIXELFORMAT pixelFormat = kc_pixel_format();
+    const resolution_s outputRes = ks_output_resolution();
+    const frame_area_s fullArea = {0, 0, uint(frameRes.w), uint(frameRes.h)};
+
+    if (!frameRes.w ||
+        !frameRes.h ||
+        !kconv_can_convert_to_bgra(frameRes, pixelFormat))
+    {
+        return;
+    }
+
+    // Frames not in BGRA are scaled straight from their own format when nothing
+    // else needs to operate on them, and otherwise converted into BGRA first.
+    if (!kconv_is_bgra(frameRes, pixelFormat))
+    {
+        scaling_plan(frameRes, pixelFormat, fullArea, outputRes);
+    }
+
+    scaling_plan({frameRes.w, frameRes.h, 32}, RGB_PIXELFORMAT_888, fullArea, outputRes);
+
+    kf_prepare_filter_chain(frameRes, outputRes);
 
     return;
 }
@@ -461,9 +1018,22 @@ void ks_scale_frame(const captured_frame_s &frame)
     resolution_s frameRes = frame.r; /// Temp hack. May want to modify the .bpp value.
     resolution_s outputRes = ks_output_resolution();
 
+    // The size of the frame as captured, and the part of it whose pixels are
+    // being processed; which, if only the frame's active area is, is less than
+    // all of it.
+    const resolution_s fullRes = frame.r;
+    frame_area_s activeArea = {0, 0, uint(frame.r.w), uint(frame.r.h)};
+
     const resolution_s minres = kc_hardware().meta.minimum_capture_resolution();
     const resolution_s maxres = kc_hardware().meta.maximum_capture_resolution();
 
+    // Alignment, the active area and anti-tearing keep track of the selected
+    // capture source's frames, so a background source's frames skip them.
+    const bool isSelectedSource = kc_is_selected_source_active();
+    const bool isAligning = (isSelectedSource && (ALIGN_CAPTURE || kalign_wants_frame()));
+    const bool isAntiTearing = (isSelectedSource && kat_is_anti_tear_enabled());
+    const bool isFindingActiveArea = (isSelectedSource && karea_is_enabled());
+
     // Verify that we have a workable frame.
     {
         if (kc_should_current_frame_be_skipped())
@@ -471,9 +1041,9 @@ void ks_scale_frame(const captured_frame_s &frame)
             DEBUG(("Skipping a frame, as requested."));
             goto done;
         }
-        else if (frame.r.bpp != 16 && frame.r.bpp != 24 && frame.r.bpp != 32)
+        else if (!kconv_can_convert_to_bgra(frame.r, frame.pixelFormat))
         {
-            NBENE(("Was asked to scale a frame with an incompatible bit depth (%u). Ignoring it.",
+            NBENE(("Was asked to scale a frame with an incompatible bit depth (%u) or pixel format. Ignoring it.",
                     frame.r.bpp));
             goto done;
         }
@@ -515,20 +1085,49 @@ void ks_scale_frame(const captured_frame_s &frame)
                    frame.r.w, frame.r.h, maxres.w, maxres.h));
             goto done;
         }
-        else if (OUTPUT_BUFFER.is_null())
+        else if (back_buffer().is_null())
         {
             goto done;
         }
     }
 
-    // If needed, convert the color data to BGRA, which is what the scaling filters
-    // expect to receive. Note that this will only happen if the frame's bit depth
-    // doesn't match with the expected value - a frame with the same bit depth but
-    // different arrangement of the color channels would not get converted to the
-    // proper order.
-    if (frame.r.bpp != OUTPUT_BIT_DEPTH)
+    // While the output is being recorded, it's also output in BGR straight into
+    // the recorder's frame buffer, so that the recorder needn't convert or copy it.
+    BGR_TARGET = (pipeline().isBgrOutputEnabled? krecord_next_frame_slot() : nullptr);
+    IS_BGR_TARGET_FILLED = false;
+
+    // Alignment, anti-tearing, filtering, and the OpenCV scaling filters all
+    // operate on BGRA, so a frame in any other format needs converting. If none
+    // of them are going to operate on the frame, we convert it as we copy it
+    // into the output - or as VCS's own scalers scale it -, rather than writing
+    // it out in BGRA and then reading it back in.
+    if (!kconv_is_bgra(frame.r, frame.pixelFormat))
     {
-        s_convert_frame_to_bgra(frame);
+        if (!isAligning &&
+            !isAntiTearing &&
+            !kf_is_filtering_enabled() &&
+            !isFindingActiveArea)
+        {
+            const scaling_plan_s &plan = scaling_plan(frame.r, frame.pixelFormat, activeArea, outputRes);
+
+            if (plan.isUnscaled)
+            {
+                kconv_convert_frame_to_bgra(pixelData, back_buffer().ptr(), frame.r, frame.pixelFormat);
+                forget_black_border();
+
+                goto output_updated;
+            }
+            else if (plan.nativeScaler)
+            {
+                CURRENT_PLAN = &plan;
+                native_scale(pixelData, outputRes, plan.nativeScaler);
+                CURRENT_PLAN = nullptr;
+
+                goto output_updated;
+            }
+        }
+
+        kconv_convert_frame_to_bgra(pixelData, COLORCONV_BUFFER.ptr(), frame.r, frame.pixelFormat);
         frameRes.bpp = 32;
 
         pixelData = COLORCONV_BUFFER.ptr();
@@ -536,8 +1135,13 @@ void ks_scale_frame(const captured_frame_s &frame)
 
     // While we have access to the color-converted original frame, and if we've
     // been asked to do so, find out whether the frame is out of alignment with
-    // the screen; and if it is, adjust the capture properties to align it.
-    if (ALIGN_CAPTURE)
+    // the screen; and if it is, adjust the capture properties to align it. A
+    // frame the capture hardware has downscaled would give the wrong alignment,
+    // so it's left for a full-sized one.
+    if (isSelectedSource &&
+        ALIGN_CAPTURE &&
+        (frameRes.w == kc_hardware().status.capture_resolution().w) &&
+        (frameRes.h == kc_hardware().status.capture_resolution().h))
     {
         const auto alignment = kf_find_capture_alignment(pixelData, frameRes);
 
@@ -546,59 +1150,132 @@ void ks_scale_frame(const captured_frame_s &frame)
         ALIGN_CAPTURE = false;
     }
 
+    // Likewise for continuous alignment, which measures the alignment in the
+    // background on a copy of the frame.
+    if (isSelectedSource &&
+        kalign_wants_frame() &&
+        (frameRes.w == kc_hardware().status.capture_resolution().w) &&
+        (frameRes.h == kc_hardware().status.capture_resolution().h))
+    {
+        kalign_submit_frame(pixelData, frameRes);
+    }
+
+    // If the frame's image is contained within black borders, only the part of
+    // the frame inside them needs further processing; the borders are filled
+    // back in as black when the frame is placed into the output.
+    if (isFindingActiveArea &&
+        !kf_active_filters_need_full_frame() &&
+        karea_find_active_area(pixelData, frameRes, &activeArea))
+    {
+        crop_to_area(pixelData, frameRes, activeArea);
+
+        frameRes.w = activeArea.w;
+        frameRes.h = activeArea.h;
+    }
+
     // Perform anti-tearing on the (color-converted) frame. If the user has turned
     // anti-tearing off, this will just return without doing anything.
-    pixelData = kat_anti_tear(pixelData, frameRes);
-    if (pixelData == nullptr)
+    if (isSelectedSource)
     {
-        goto done;
+        pixelData = kat_anti_tear(pixelData, frameRes);
+        if (pixelData == nullptr)
+        {
+            goto done;
+        }
     }
 
     // Apply filtering, and scale the frame.
     {
-        kf_apply_filter_chain(pixelData, frameRes);
+        kf_apply_filter_chain(pixelData, frameRes, fullRes);
+
+        const scaling_plan_s &plan = scaling_plan({fullRes.w, fullRes.h, 32}, RGB_PIXELFORMAT_888, activeArea, outputRes);
 
         // If no need to scale, just copy the data over.
-        if ((!FORCE_ASPECT || ASPECT_MODE == aspect_mode_e::native) &&
-            frameRes.w == outputRes.w &&
-            frameRes.h == outputRes.h)
+        if (plan.isUnscaled)
+        {
+            copy_to_output_area(pixelData, activeArea, outputRes);
+        }
+        else if (!plan.filter)
         {
-            memcpy(OUTPUT_BUFFER.ptr(), pixelData, OUTPUT_BUFFER.up_to(frameRes.w * frameRes.h * (frameRes.bpp / 8)));
+            NBENE(("Upscale or downscale filter is null. Refusing to scale."));
+
+            outputRes = {fullRes.w, fullRes.h, frameRes.bpp};
+            copy_to_output_area(pixelData, activeArea, outputRes);
+
+            // The output no longer fits the recording.
+            BGR_TARGET = nullptr;
         }
         else
         {
-            const scaling_filter_s *scaler;
+            CURRENT_PLAN = &plan;
 
-            if ((frameRes.w < outputRes.w) ||
-                (frameRes.h < outputRes.h))
+            if (plan.nativeScaler)
             {
-                scaler = UPSCALE_FILTER;
+                native_scale(pixelData, outputRes, plan.nativeScaler);
             }
             else
             {
-                scaler = DOWNSCALE_FILTER;
+                plan.filter->scale(pixelData, frameRes, outputRes);
             }
 
-            if (!scaler)
-            {
-                NBENE(("Upscale or downscale filter is null. Refusing to scale."));
-
-                outputRes = frameRes;
-                memcpy(OUTPUT_BUFFER.ptr(), pixelData, OUTPUT_BUFFER.up_to(frameRes.w * frameRes.h * (frameRes.bpp / 8)));
-            }
-            else
-            {
-                scaler->scale(pixelData, frameRes, outputRes);
-            }
+            CURRENT_PLAN = nullptr;
         }
     }
 
-    LATEST_OUTPUT_SIZE = outputRes;
+    output_updated:
+    if (BGR_TARGET &&
+        !IS_BGR_TARGET_FILLED)
+    {
+        make_bgr_output(outputRes);
+    }
+
+    pipeline().latestBgrOutput = BGR_TARGET;
+    BGR_TARGET = nullptr;
+
+    pipeline().latestOutputSize = outputRes;
+    pipeline().latestOutputMeta = frame.meta;
+    publish_output();
 
     done:
     return;
 }
 
+// Returns the size to which the capture hardware could downscale frames on the
+// scaler's behalf, i.e. the size of the frames' image in the output; or, if the
+// frames are needed at their full size - e.g. for filtering, anti-tearing,
+// alignment, active area detection, or duplicate frame detection, all of which
+// operate on the frame as captured -, the capture resolution. See
+// kc_set_hardware_output_size().
+//
+resolution_s ks_hardware_downscaling_size(void)
+{
+    const resolution_s inputRes = kc_hardware().status.capture_resolution();
+    const resolution_s outputRes = ks_output_resolution();
+    resolution_s size;
+
+    if (ALIGN_CAPTURE ||
+        kalign_is_enabled() ||
+        karea_is_enabled() ||
+        kdedup_is_enabled() ||
+        kat_is_anti_tear_enabled() ||
+        kf_is_filtering_enabled() ||
+        kdump_is_dumping() ||
+        !inputRes.w ||
+        !inputRes.h)
+    {
+        return inputRes;
+    }
+
+    size = (FORCE_ASPECT? padded_resolution(inputRes, outputRes) : outputRes);
+
+    // The hardware only downscales; any upscaling is left to the scaler.
+    size.w = std::min(size.w, inputRes.w);
+    size.h = std::min(size.h, inputRes.h);
+    size.bpp = inputRes.bpp;
+
+    return size;
+}
+
 void ks_set_output_resolution_override_enabled(const bool state)
 {
     FORCE_BASE_RESOLUTION = state;
@@ -610,6 +1287,7 @@ void ks_set_output_resolution_override_enabled(const bool state)
 void ks_set_forced_aspect_enabled(const bool state)
 {
     FORCE_ASPECT = state;
+    invalidate_scaling_plans();
     kd_update_output_window_size();
 
     return;
@@ -668,17 +1346,88 @@ void ks_indicate_invalid_signal(void)
 
 void ks_clear_scaler_output_buffer(void)
 {
-    k_assert(!OUTPUT_BUFFER.is_null(),
+    k_assert(!back_buffer().is_null(),
              "Can't access the output buffer: it was unexpectedly null.");
 
-    memset(OUTPUT_BUFFER.ptr(), 0, OUTPUT_BUFFER.up_to(MAX_FRAME_SIZE));
+    memset(back_buffer().ptr(), 0, back_buffer().up_to(MAX_FRAME_SIZE));
+    forget_black_border();
+    pipeline().latestBgrOutput = nullptr;
+
+    // The output no longer holds a scaled frame.
+    pipeline().latestOutputSize = {0, 0, 0};
+    publish_output();
 
     return;
 }
 
+// Lets the scaler's current output stand in for the given frame, which repeats
+// the frame from which the output was produced, so that the frame needn't be
+// processed. Returns false if the output can't stand in for the frame - e.g.
+// because the output resolution has since changed -, in which case the frame
+// should be scaled as usual.
+//
+bool ks_reuse_output_for_repeat_frame(const captured_frame_s &frame)
+{
+    const resolution_s outputRes = ks_output_resolution();
+
+    if (ALIGN_CAPTURE ||
+        (outputRes.w != pipeline().latestOutputSize.w) ||
+        (outputRes.h != pipeline().latestOutputSize.h))
+    {
+        return false;
+    }
+
+    // The output now represents this frame, e.g. as far as the timing of
+    // recordings is concerned.
+    pipeline().latestOutputMeta = frame.meta;
+
+    return true;
+}
+
+// Returns the latest complete output, which stays as it is - the scaler writing
+// into other buffers - until the output is next asked for.
+//
 const u8* ks_scaler_output_as_raw_ptr(void)
 {
-    return OUTPUT_BUFFER.ptr();
+    return front_buffer().pixels.ptr();
+}
+
+// Returns where in the recorder's frame buffer the latest output was put in
+// packed 24-bit BGR - for a frame scaled while BGR output was enabled, the slot
+// given by krecord_next_frame_slot() at the time -; or nullptr if the output
+// isn't available in BGR, e.g. because it was produced before BGR output was
+// enabled.
+//
+const u8* ks_scaler_bgr_output_as_raw_ptr(void)
+{
+    return pipeline().latestBgrOutput;
+}
+
+// Sets whether the scaler also outputs its frames in packed 24-bit BGR, as video
+// recording takes them, straight into the recorder's frame buffer; so that they
+// can be recorded without the recorder having to convert or copy them. Meant to
+// be enabled for as long as the recorder's frame buffer exists, i.e. while
+// recording.
+//
+void ks_set_bgr_output_enabled(const bool state)
+{
+    pipeline().isBgrOutputEnabled = state;
+
+    // Whatever output there is in BGR is in a frame buffer that's either not yet
+    // or no longer in use.
+    pipeline().latestBgrOutput = nullptr;
+
+    return;
+}
+
+const captured_frame_meta_s& ks_scaler_output_meta(void)
+{
+    return pipeline().latestOutputMeta;
+}
+
+u32 ks_scaler_output_version(void)
+{
+    return pipeline().outputVersion;
 }
 
 // Returns a list of GUI-displayable names of the scaling filters that're
@@ -742,6 +1491,7 @@ const std::string& ks_downscaling_filter_name(void)
 void ks_set_upscaling_filter(const std::string &name)
 {
     UPSCALE_FILTER = ks_scaler_for_name_string(name);
+    invalidate_scaling_plans();
 
     DEBUG(("Assigned '%s' as the upscaling filter.", UPSCALE_FILTER->name.c_str()));
 
@@ -751,6 +1501,7 @@ void ks_set_upscaling_filter(const std::string &name)
 void ks_set_downscaling_filter(const std::string &name)
 {
     DOWNSCALE_FILTER = ks_scaler_for_name_string(name);
+    invalidate_scaling_plans();
 
     DEBUG(("Assigned '%s' as the downscaling filter.", DOWNSCALE_FILTER->name.c_str()));
 
@@ -760,6 +1511,6 @@ void ks_set_downscaling_filter(const std::string &name)
 #ifdef VALIDATION_RUN
     const u8* ks_VALIDATION_raw_output_buffer_ptr(void)
     {
-        return OUTPUT_BUFFER.ptr();
+        return ks_scaler_output_as_raw_ptr();
     }
 #endif
@@ -9,6 +9,7 @@
 
 #include "common/globals.h"
 
+struct captured_frame_meta_s;
 struct captured_frame_s;
 
 // The parameters accepted by scaling functions.
@@ -53,6 +54,12 @@ void ks_release_scaler(void);
 
 void ks_scale_frame(const captured_frame_s &frame);
 
+void ks_prepare_for_capture_mode(void);
+
+bool ks_reuse_output_for_repeat_frame(const captured_frame_s &frame);
+
+resolution_s ks_hardware_downscaling_size(void);
+
 resolution_s ks_resolution_to_aspect(const resolution_s &r);
 
 void ks_set_aspect_mode(const aspect_mode_e mode);
@@ -75,6 +82,14 @@ void ks_clear_scaler_output_buffer(void);
 
 const u8* ks_scaler_output_as_raw_ptr(void);
 
+const u8* ks_scaler_bgr_output_as_raw_ptr(void);
+
+void ks_set_bgr_output_enabled(const bool state);
+
+const captured_frame_meta_s& ks_scaler_output_meta(void);
+
+u32 ks_scaler_output_version(void);
+
 const std::string &ks_upscaling_filter_name(void);
 
 const std::string& ks_downscaling_filter_name(void);
@@ -0,0 +1,189 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ * A benchmark of the scaler's throughput. Runs frames through ks_scale_frame()
+ * with each of the scaling filters, at a range of source resolutions, output
+ * resolutions, color depths, and aspect modes, and prints out how long each
+ * combination took per frame.
+ *
+ * The results are printed as CSV into stdout, one line per combination after a
+ * header line; log messages from initialization precede them, prefixed with '['.
+ * The program's usual command-line options apply; e.g. -j to set the number of
+ * scaler threads.
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include "common/command_line.h"
+#include "filter/active_area.h"
+#include "filter/auto_align.h"
+#include "filter/anti_tear.h"
+#include "common/parallel.h"
+#include "capture/capture.h"
+#include "common/globals.h"
+#include "scaler/scaler.h"
+#include "filter/filter.h"
+#include "common/memory.h"
+#include "common/log.h"
+
+// Each combination is run for at least this long, and for at least this many
+// frames, after one frame to warm up with.
+static const std::chrono::milliseconds MIN_DURATION(100);
+static const uint MIN_NUM_FRAMES = 10;
+
+static const resolution_s SOURCE_RESOLUTIONS[] = {{320, 200, 0}, {640, 400, 0}, {640, 480, 0}, {720, 400, 0}, {800, 600, 0},
+                                                  {1024, 768, 0}, {1280, 1024, 0}, {1920, 1080, 0}, {1920, 1200, 0}};
+
+static const resolution_s OUTPUT_RESOLUTIONS[] = {{640, 480, 32}, {1280, 960, 32}, {1920, 1080, 32}};
+
+static const struct
+{
+    uint bpp;
+    PIXELFORMAT pixelFormat;
+} COLOR_FORMATS[] = {{16, RGB_PIXELFORMAT_565},
+                     {24, RGB_PIXELFORMAT_888},
+                     {32, RGB_PIXELFORMAT_888}};
+
+// With forced aspect disabled, frames are stretched to fill the output.
+static const struct
+{
+    const char *name;
+    bool isForced;
+    aspect_mode_e mode;
+} ASPECT_MODES[] = {{"stretch",         false, aspect_mode_e::native},
+                    {"native",          true,  aspect_mode_e::native},
+                    {"traditional_4_3", true,  aspect_mode_e::traditional_4_3},
+                    {"always_4_3",      true,  aspect_mode_e::always_4_3}};
+
+// Scales the given frame repeatedly, and prints out a line of results for it.
+//
+static void benchmark_frame(const captured_frame_s &frame, const std::string &filterName, const char *const aspectName)
+{
+    const resolution_s outputRes = ks_output_resolution();
+    const u32 initialVersion = ks_scaler_output_version();
+    std::chrono::steady_clock::duration elapsed;
+    uint numFrames = 0;
+
+    // The first frame makes the scaling plan.
+    ks_scale_frame(frame);
+
+    const auto startTime = std::chrono::steady_clock::now();
+    do
+    {
+        ks_scale_frame(frame);
+        numFrames++;
+
+        elapsed = (std::chrono::steady_clock::now() - startTime);
+    } while ((numFrames < MIN_NUM_FRAMES) || (elapsed < MIN_DURATION));
+
+    k_assert(((ks_scaler_output_version() - initialVersion) == (numFrames + 1)),
+             "The scaler didn't accept the benchmark's frames.");
+
+    const real seconds = std::chrono::duration<real>(elapsed).count();
+    const real frameBytes = (frame.r.w * frame.r.h * (frame.r.bpp / 8));
+
+    printf("%s,%s,%lu,%lu,%lu,%lu,%lu,%u,%u,%.0f,%.2f,%.2f\n",
+           filterName.c_str(), aspectName, frame.r.bpp, frame.r.w, frame.r.h, outputRes.w, outputRes.h,
+           kpar_num_threads(), numFrames,
+           ((seconds * 1000000000) / numFrames),
+           ((frameBytes * numFrames) / seconds / 1000000),
+           (numFrames / seconds));
+
+    fflush(stdout);
+
+    return;
+}
+
+int kbench_scaling(void)
+{
+    captured_frame_s f;
+
+    try
+    {
+        ks_initialize_scaler();
+        kc_initialize_capture();
+        kat_initialize_anti_tear();
+        kf_initialize_filters();
+        kalign_initialize();
+        karea_initialize();
+
+        k_assert(!PROGRAM_EXIT_REQUESTED, "Failed to initialize the units to be benchmarked.");
+
+        // Fill the frame with noise, so that no part of it looks like any other.
+        f.pixels.alloc(MAX_OUTPUT_WIDTH * MAX_OUTPUT_HEIGHT * (MAX_OUTPUT_BPP / 8), "Benchmark frame buffer");
+        for (uint i = 0; i < (MAX_OUTPUT_WIDTH * MAX_OUTPUT_HEIGHT * (MAX_OUTPUT_BPP / 8)); i++)
+        {
+            f.pixels.ptr()[i] = (rand() % 256);
+        }
+
+        klog_set_logging_enabled(false);
+
+        ks_set_output_resolution_override_enabled(true);
+        ks_set_output_scale_override_enabled(false);
+
+        printf("filter,aspect_mode,bpp,input_w,input_h,output_w,output_h,threads,frames,ns_per_frame,mb_per_s,fps\n");
+
+        for (const std::string &filterName: ks_list_of_scaling_filter_names())
+        {
+            ks_set_upscaling_filter(filterName);
+            ks_set_downscaling_filter(filterName);
+
+            for (const auto &aspect: ASPECT_MODES)
+            {
+                ks_set_forced_aspect_enabled(aspect.isForced);
+                ks_set_aspect_mode(aspect.mode);
+
+                for (const auto &format: COLOR_FORMATS)
+                {
+                    kc_VALIDATION_set_capture_color_depth(format.bpp);
+                    kc_VALIDATION_set_capture_pixel_format(format.pixelFormat);
+
+                    for (const resolution_s &sourceRes: SOURCE_RESOLUTIONS)
+                    {
+                        f.r = {sourceRes.w, sourceRes.h, format.bpp};
+                        f.pixelFormat = format.pixelFormat;
+
+                        for (const resolution_s &outputRes: OUTPUT_RESOLUTIONS)
+                        {
+                            ks_set_output_base_resolution(outputRes, true);
+
+                            benchmark_frame(f, filterName, aspect.name);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Release the subsystem.
+        klog_set_logging_enabled(true);
+        PROGRAM_EXIT_REQUESTED = 1;
+        f.pixels.release_memory();
+        ks_release_scaler();
+        kc_release_capture();
+        kat_release_anti_tear();
+        kf_release_filters();
+        kalign_release();
+        kmem_deallocate_memory_cache();
+    }
+    catch (std::exception &e)
+    {
+        fprintf(stderr, "The scaling benchmark failed. Encountered the following error: '%s'.\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!kcom_parse_command_line(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return kbench_scaling();
+}
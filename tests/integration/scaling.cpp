@@ -4,6 +4,10 @@
  *
  * An integration test to validate scaler functionality. Kind of a
  * kludge until a more refined testing system is in place.
+ *
+ * Also runs frames through chains of OpenCV filters, which keep scratch
+ * images and transforms of their own from frame to frame, and checks that
+ * the frames come out as expected.
  * 
  * Will print out "Successfully validated" or "Failed to validate",
  * depending on whether the test succeeded, and exit with either
@@ -11,6 +15,11 @@
  *
  */
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "display/qt/widgets/filter_widgets.h"
+#include "common/command_line.h"
 #include "scaling.h"
 #include "capture/capture.h"
 #include "scaler/scaler.h"
@@ -23,76 +32,157 @@ static const char ASPECT_TO_TEST[] = "Scaling";
     #error "OpenCV must be enabled for scaler validation. See toggle in the .pro file."
 #endif
 
+// Returns a new filter of the given type, with the given 8- and 16-bit parameter
+// values at the given offsets in its parameter data; the rest of its parameters
+// being zero.
+//
+static const filter_c* new_filter(const filter_type_enum_e type,
+                                  const std::vector<std::pair<uint, u8>> &u8Params,
+                                  const std::vector<std::pair<uint, u16>> &u16Params = {})
+{
+    u8 parameterData[FILTER_PARAMETER_ARRAY_LENGTH] = {0};
+
+    for (const auto &param: u8Params)
+    {
+        parameterData[param.first] = param.second;
+    }
+
+    for (const auto &param: u16Params)
+    {
+        memcpy(&parameterData[param.first], &param.second, sizeof(param.second));
+    }
+
+    return kf_create_new_filter_instance(type, parameterData);
+}
+
+// Returns a new filter chain of the given filters, gated to frames of the given
+// size; and to any output size.
+//
+static std::vector<const filter_c*> new_filter_chain(const resolution_s &frameRes, const std::vector<const filter_c*> &filters)
+{
+    std::vector<const filter_c*> chain;
+
+    chain.push_back(new_filter(filter_type_enum_e::input_gate, {},
+                               {{filter_widget_input_gate_s::OFFS_WIDTH, frameRes.w},
+                                {filter_widget_input_gate_s::OFFS_HEIGHT, frameRes.h}}));
+    chain.insert(chain.end(), filters.begin(), filters.end());
+    chain.push_back(new_filter(filter_type_enum_e::output_gate, {}));
+
+    return chain;
+}
+
+// Scales the given 32-bit pixels of the given size as a frame, and returns the
+// scaler's output.
+//
+static std::vector<u8> scaled_output(captured_frame_s &f, const std::vector<u32> &pixels, const resolution_s &r)
+{
+    const resolution_s outres = ks_output_resolution();
+
+    f.r = {r.w, r.h, 32};
+    f.pixelFormat = RGB_PIXELFORMAT_888;
+    std::copy(pixels.begin(), pixels.end(), (u32*)f.pixels.ptr());
+
+    ks_scale_frame(f);
+
+    return std::vector<u8>(ks_VALIDATION_raw_output_buffer_ptr(),
+                           (ks_VALIDATION_raw_output_buffer_ptr() + (outres.w * outres.h * 4)));
+}
+
+// Returns true if the scaler's output for the given frame pixels run through the
+// filter chain for their size is the same as its output for the given expected
+// pixels, unfiltered.
+//
+static bool is_filtered_output_as_expected(captured_frame_s &f, const resolution_s &r,
+                                           const std::vector<u32> &pixels, const std::vector<u32> &expectedPixels)
+{
+    kf_set_filtering_enabled(false);
+    const std::vector<u8> expectedOutput = scaled_output(f, expectedPixels, r);
+
+    kf_set_filtering_enabled(true);
+    const std::vector<u8> filteredOutput = scaled_output(f, pixels, r);
+
+    return (filteredOutput == expectedOutput);
+}
+
 int ktest_integration_scaling(void)
 {
     captured_frame_s f;
 
     try
     {
-        k_assert(((kc_hardware_max_capture_resolution().w <= MAX_OUTPUT_WIDTH) &&
-                    (kc_hardware_max_capture_resolution().h <= MAX_OUTPUT_HEIGHT)),
-                    "The maximum input size should not be larger than the maximum output size.");
+        const resolution_s minres = kc_hardware().meta.minimum_capture_resolution();
+        const resolution_s maxres = kc_hardware().meta.maximum_capture_resolution();
+
+        k_assert(((maxres.w <= MAX_OUTPUT_WIDTH) &&
+                  (maxres.h <= MAX_OUTPUT_HEIGHT)),
+                 "The maximum input size should not be larger than the maximum output size.");
 
         k_assert((ks_max_output_bit_depth() >= 32), "Support for 32-bit output depth is required for this test.");
 
         // Initialize the system subset to be tested.
         ks_initialize_scaler();
-        kc_initialize_capturer();
+        kc_initialize_capture();
         kf_initialize_filters();
-        kf_clear_filters();
+        kf_remove_all_filter_chains();
 
         // Initialize the frame to be tested with.
         f.pixels.alloc(MAX_OUTPUT_WIDTH * MAX_OUTPUT_HEIGHT * (ks_max_output_bit_depth() / 8), "Test frame buffer");
 
         // Test the scaler.
         {
-            // Ask to use invalid scalers. The system should ignore these requests.
+            // Ask to use unknown scalers. The system should fall back to the
+            // first of the known ones.
             INFO(("SCALING: testing invalid scaler assignment..."));
-            QString upName = ks_upscaling_filter_name();
-            QString downName = ks_downscaling_filter_name();
-            ks_set_downscaling_filter(NULL);
+            const std::string firstName = ks_list_of_scaling_filter_names().at(0);
+            ks_set_downscaling_filter("");
             ks_set_upscaling_filter("_^-_______________________");
-            k_assert((ks_upscaling_filter_name() == upName) &&
-                        (ks_downscaling_filter_name() == downName),
-                        "Detected possibly invalid scaler assignment.");
+            k_assert((ks_upscaling_filter_name() == firstName) &&
+                     (ks_downscaling_filter_name() == firstName),
+                     "Detected possibly invalid scaler assignment.");
 
-            // Test invalid frame scaling. The scaler should reject processing these.
+            // Test invalid frame scaling. The scaler should reject processing these,
+            // i.e. not publish new output for them.
             INFO(("SCALING: testing invalid resolutions..."));
-            for (uint y: {kc_hardware_min_capture_resolution().h-5, kc_hardware_max_capture_resolution().h+5})
+            for (uint y: {minres.h-5, maxres.h+5})
             {
-                for (uint x: {kc_hardware_min_capture_resolution().w-5, kc_hardware_max_capture_resolution().w+5})
+                for (uint x: {minres.w-5, maxres.w+5})
                 {
                     for (uint bpp: {0, 16, 24, 956})
                     {
-                        f.processed = false;
+                        const u32 outputVersion = ks_scaler_output_version();
+
                         f.r = {x, y, bpp};
 
                         kc_VALIDATION_set_capture_color_depth(bpp);
                         ks_scale_frame(f);
 
-                        k_assert(!f.processed, "An invalid frame may have been accepted for display.");
+                        k_assert((ks_scaler_output_version() == outputVersion),
+                                 "An invalid frame may have been accepted for display.");
                     }
                 }
             }
 
-            // Test invalid frame scaling. The scaler should accept these.
+            // Test valid frame scaling. The scaler should accept these.
             INFO(("SCALING: testing valid resolutions..."));
-            for (uint y: {kc_hardware_min_capture_resolution().h + ((kc_hardware_max_capture_resolution().h - kc_hardware_min_capture_resolution().h) / 2),
-                            kc_hardware_min_capture_resolution().h + ((kc_hardware_max_capture_resolution().h - kc_hardware_min_capture_resolution().h) / 4)})
+            for (uint y: {minres.h + ((maxres.h - minres.h) / 2),
+                          minres.h + ((maxres.h - minres.h) / 4)})
             {
-                for (uint x: {kc_hardware_min_capture_resolution().w + ((kc_hardware_max_capture_resolution().w - kc_hardware_min_capture_resolution().w) / 2),
-                                kc_hardware_min_capture_resolution().w + ((kc_hardware_max_capture_resolution().w - kc_hardware_min_capture_resolution().w) / 4)})
+                for (uint x: {minres.w + ((maxres.w - minres.w) / 2),
+                              minres.w + ((maxres.w - minres.w) / 4)})
                 {
                     for (uint bpp: {16, 32})
                     {
-                        f.processed = false;
+                        const u32 outputVersion = ks_scaler_output_version();
+
                         f.r = {x, y, bpp};
+                        f.pixelFormat = ((bpp == 32)? RGB_PIXELFORMAT_888 : RGB_PIXELFORMAT_565);
 
-                        kc_VALIDATION_set_capture_pixel_format(bpp == 32? RGB_PIXELFORMAT_888 : RGB_PIXELFORMAT_565);
+                        kc_VALIDATION_set_capture_pixel_format(f.pixelFormat);
                         kc_VALIDATION_set_capture_color_depth(bpp);
                         ks_scale_frame(f);
 
-                        k_assert(f.processed, "A valid frame was not accepted for display");
+                        k_assert((ks_scaler_output_version() != outputVersion),
+                                 "A valid frame was not accepted for display");
                     }
                 }
             }
@@ -104,11 +194,13 @@ int ktest_integration_scaling(void)
         {
             INFO(("SCALING: testing scaler output..."));
             k_assert(ks_downscaling_filter_name() == "Nearest", "Expected the nearest downscaler for this test.");
+            // The 5- and 6-bit channels of 16-bit color are expected to be expanded
+            // to 8 bits by replicating their top bits into the low ones.
             const u8 r = 45, g = 117, b = 150, a = 255;
             const u16 p16_565 =         (r/8)   | ((g/4)   << 5)   | ((b/8)   << 11);
-            const u32 p16_565_as_p32 =  (r/8*8) | ((g/4*4) << 8)   | ((b/8*8) << 16);
+            const u32 p16_565_as_p32 =  (r/8*8 | r/32) | ((g/4*4 | g/64) << 8) | ((b/8*8 | b/32) << 16);
             const u16 p16_555 =         (r/8)   | ((g/8)   << 5)   | ((b/8)   << 10);
-            const u32 p16_555_as_p32 =  (r/8*8) | ((g/8*8) << 8)   | ((b/8*8) << 16);
+            const u32 p16_555_as_p32 =  (r/8*8 | r/32) | ((g/8*8 | g/32) << 8) | ((b/8*8 | b/32) << 16);
             const u32 p32 =              r      |  (g      << 8)   |  (b      << 16)   | (a << 24);
 
             INFO(("\t32-bit (888)..."));
@@ -116,6 +208,7 @@ int ktest_integration_scaling(void)
             const resolution_s outresHalf = {outres.w / 2, outres.h / 2, outres.bpp};
 
             f.r = {outresHalf.w, outresHalf.h, 32};
+            f.pixelFormat = RGB_PIXELFORMAT_888;
             for (uint i = 0; i < (f.r.w * f.r.h); i++)
             {
                 ((u32*)f.pixels.ptr())[i] = p32;
@@ -131,6 +224,7 @@ int ktest_integration_scaling(void)
 
             INFO(("\t16-bit (565)..."));
             f.r = {outresHalf.w, outresHalf.h, 16};
+            f.pixelFormat = RGB_PIXELFORMAT_565;
             for (uint i = 0; i < (f.r.w * f.r.h); i++)
             {
                 ((u16*)f.pixels.ptr())[i] = p16_565;
@@ -146,6 +240,7 @@ int ktest_integration_scaling(void)
 
             INFO(("\t16-bit (555)..."));
             f.r = {outresHalf.w, outresHalf.h, 16};
+            f.pixelFormat = RGB_PIXELFORMAT_555;
             for (uint i = 0; i < (f.r.w * f.r.h); i++)
             {
                 ((u16*)f.pixels.ptr())[i] = p16_555;
@@ -160,11 +255,90 @@ int ktest_integration_scaling(void)
             }
         }
 
+        // Test running frames through chains of OpenCV filters. The filters keep
+        // their scratch images and transforms from frame to frame, per chain; so
+        // frames of different sizes are run through the chains in turn, with
+        // some of the filters shared between chains, and the frames checked to
+        // come out as they should. The frames' sizes are odd, so that a rotation
+        // by 180 degrees about the frame's center flips the frame exactly, but
+        // about any other point leaves some of it out.
+        {
+            INFO(("SCALING: testing OpenCV filter chains..."));
+
+            const resolution_s largeRes = {321, 241, 32};
+            const resolution_s smallRes = {161, 121, 32};
+            const u32 color = 0xff96752d;
+
+            kc_VALIDATION_set_capture_color_depth(32);
+            kc_VALIDATION_set_capture_pixel_format(RGB_PIXELFORMAT_888);
+
+            const filter_c *const blur = new_filter(filter_type_enum_e::blur,
+                                                    {{filter_widget_blur_s::OFFS_TYPE, filter_widget_blur_s::FILTER_TYPE_BOX},
+                                                     {filter_widget_blur_s::OFFS_KERNEL_SIZE, 10}});
+            const filter_c *const median = new_filter(filter_type_enum_e::median,
+                                                      {{filter_widget_median_s::OFFS_KERNEL_SIZE, 3}});
+            const filter_c *const unsharpMask = new_filter(filter_type_enum_e::unsharp_mask,
+                                                           {{filter_widget_unsharp_mask_s::OFFS_STRENGTH, 50},
+                                                            {filter_widget_unsharp_mask_s::OFFS_RADIUS, 10}});
+            const filter_c *const rotate = new_filter(filter_type_enum_e::rotate, {},
+                                                      {{filter_widget_rotate_s::OFFS_ROT, 1800},
+                                                       {filter_widget_rotate_s::OFFS_SCALE, 100}});
+            const filter_c *const flip = new_filter(filter_type_enum_e::flip,
+                                                    {{filter_widget_flip_s::OFFS_AXIS, 2}});
+
+            // A frame of a single color, which the smoothing filters should leave
+            // as it is.
+            std::vector<u32> uniformFrame(largeRes.w * largeRes.h, color);
+
+            // A frame whose color channels vary by position; and the same frame
+            // flipped both ways, which reverses the order of its pixels.
+            std::vector<u32> gradientFrame(smallRes.w * smallRes.h);
+            for (uint y = 0; y < smallRes.h; y++)
+            {
+                for (uint x = 0; x < smallRes.w; x++)
+                {
+                    gradientFrame[(y * smallRes.w) + x] = ((x & 0xff) | ((y & 0xff) << 8) | (((x * y) & 0xff) << 16) | (0xffu << 24));
+                }
+            }
+            const std::vector<u32> flippedGradientFrame(gradientFrame.rbegin(), gradientFrame.rend());
+
+            kf_add_filter_chain(new_filter_chain(largeRes, {blur, median, unsharpMask, rotate, flip}));
+            kf_add_filter_chain(new_filter_chain(smallRes, {rotate}));
+
+            for (uint i = 0; i < 3; i++)
+            {
+                k_assert(is_filtered_output_as_expected(f, largeRes, uniformFrame, uniformFrame),
+                         "A filter chain gave unexpected output.");
+
+                k_assert(is_filtered_output_as_expected(f, smallRes, gradientFrame, flippedGradientFrame),
+                         "A filter chain gave unexpected output.");
+            }
+
+            // A chain that takes frames of any size, whose filters thus see frames
+            // of different sizes in turn.
+            kf_remove_all_filter_chains();
+            kf_add_filter_chain(new_filter_chain({0, 0, 32}, {blur, median, unsharpMask, rotate}));
+
+            for (uint i = 0; i < 3; i++)
+            {
+                for (const resolution_s &r: {largeRes, smallRes})
+                {
+                    uniformFrame.assign((r.w * r.h), color);
+
+                    k_assert(is_filtered_output_as_expected(f, r, uniformFrame, uniformFrame),
+                             "A filter chain gave unexpected output.");
+                }
+            }
+
+            kf_set_filtering_enabled(false);
+            kf_remove_all_filter_chains();
+        }
+
         // Release the subsystem.
         PROGRAM_EXIT_REQUESTED = 1;
         f.pixels.release_memory();
         ks_release_scaler();
-        kc_release_capturer();
+        kc_release_capture();
         kf_release_filters();
         kmem_deallocate_memory_cache();
     }
@@ -179,7 +353,12 @@ int ktest_integration_scaling(void)
     return EXIT_SUCCESS;
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
+    if (!kcom_parse_command_line(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
     return ktest_integration_scaling();
 }
@@ -8,14 +8,10 @@
 #define CAPTURE_TEST_H
 
 #include "common/types.h"
-#ifndef USE_RGBEASY_API
-    #include "capture/null_rgbeasy.h"
-#endif
 
-// Helper functions to directly manipulate certain program-side capture
-// parameters, without involving the capture hardware.
-void kc_VALIDATION_set_capture_color_depth(const uint bpp);
-void kc_VALIDATION_set_capture_pixel_format(const PIXELFORMAT pf);
+// A helper function to directly access the scaler's output, for checking it
+// against what's expected. The helpers to manipulate the program-side capture
+// parameters are declared in capture/capture.h.
 const u8* ks_VALIDATION_raw_output_buffer_ptr(void);
 
 #endif
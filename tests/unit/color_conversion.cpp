@@ -0,0 +1,143 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ * A test of the color conversion of 16-bit pixels into BGRA, and of BGRA into
+ * BGR. Converts every possible 565 and 555 pixel, every possible YUY2 pair of
+ * pixels (for each combination of chroma, each luma value), and BGRA noise, both
+ * as a long row - which goes through the SIMD versions of the conversions, where
+ * they're available - and in runs too short for them, which go through the plain
+ * versions; and checks that the two give the same output.
+ *
+ * Will print out "Successfully validated" or "Failed to validate", depending on
+ * whether the test succeeded, and exit with either EXIT_SUCCESS or EXIT_FAILURE
+ * likewise.
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include "scaler/color_conversion.h"
+#include "common/globals.h"
+
+static const char ASPECT_TO_TEST[] = "Color conversion";
+
+// Converts the given pixels into BGRA both in one go and the given number of
+// pixels at a time, and returns true if both give the same result. The number
+// of pixels at a time is expected to be too few for the SIMD conversions.
+//
+static bool is_conversion_consistent(const std::vector<u8> &pixels, const PIXELFORMAT pixelFormat,
+                                     const uint numPixelsAtATime)
+{
+    const uint numPixels = (pixels.size() / 2);
+    std::vector<u8> rowOutput(numPixels * 4);
+    std::vector<u8> piecewiseOutput(numPixels * 4);
+
+    kconv_convert_row_to_bgra(pixels.data(), rowOutput.data(), numPixels, 16, pixelFormat);
+
+    for (uint i = 0; i < numPixels; i += numPixelsAtATime)
+    {
+        kconv_convert_row_to_bgra((pixels.data() + (i * 2)), (piecewiseOutput.data() + (i * 4)),
+                                  numPixelsAtATime, 16, pixelFormat);
+    }
+
+    return (rowOutput == piecewiseOutput);
+}
+
+// As is_conversion_consistent(), but for converting BGRA pixels into BGR, one
+// pixel at a time; also checking that the pixels are converted as they should.
+//
+static bool is_bgr_conversion_consistent(const std::vector<u8> &pixels)
+{
+    const uint numPixels = (pixels.size() / 4);
+    std::vector<u8> rowOutput(numPixels * 3);
+    std::vector<u8> piecewiseOutput(numPixels * 3);
+
+    kconv_convert_bgra_row_to_bgr(pixels.data(), rowOutput.data(), numPixels);
+
+    for (uint i = 0; i < numPixels; i++)
+    {
+        kconv_convert_bgra_row_to_bgr((pixels.data() + (i * 4)), (piecewiseOutput.data() + (i * 3)), 1);
+
+        if (!std::equal((pixels.data() + (i * 4)), (pixels.data() + (i * 4) + 3), (piecewiseOutput.data() + (i * 3))))
+        {
+            return false;
+        }
+    }
+
+    return (rowOutput == piecewiseOutput);
+}
+
+int ktest_unit_color_conversion(void)
+{
+    try
+    {
+#if !__SSE2__
+        INFO(("COLOR CONVERSION: SSE2 isn't available, so only the plain conversions are being tested."));
+#endif
+
+        // Every 16-bit value, as consecutive pixels.
+        std::vector<u8> allValues(65536 * 2);
+        for (uint i = 0; i < 65536; i++)
+        {
+            allValues[(i * 2) + 0] = (i & 0xff);
+            allValues[(i * 2) + 1] = (i >> 8);
+        }
+
+        INFO(("COLOR CONVERSION: testing 565..."));
+        k_assert(is_conversion_consistent(allValues, RGB_PIXELFORMAT_565, 1),
+                 "The SIMD and plain conversions of 565 pixels differ.");
+
+        INFO(("COLOR CONVERSION: testing 555..."));
+        k_assert(is_conversion_consistent(allValues, RGB_PIXELFORMAT_555, 1),
+                 "The SIMD and plain conversions of 555 pixels differ.");
+
+        // For each value of U, pairs of pixels with every combination of V and
+        // luma; the first pixel of a pair having the luma, and the second its
+        // inverse.
+        INFO(("COLOR CONVERSION: testing YUY2..."));
+        for (uint u = 0; u < 256; u++)
+        {
+            std::vector<u8> pairs(65536 * 4);
+
+            for (uint i = 0; i < 65536; i++)
+            {
+                pairs[(i * 4) + 0] = (i & 0xff);
+                pairs[(i * 4) + 1] = u;
+                pairs[(i * 4) + 2] = (255 - (i & 0xff));
+                pairs[(i * 4) + 3] = (i >> 8);
+            }
+
+            k_assert(is_conversion_consistent(pairs, RGB_PIXELFORMAT_YUY2, 2),
+                     "The SIMD and plain conversions of YUY2 pixels differ.");
+        }
+
+        // Rows of BGRA noise of a length that doesn't divide evenly into the SIMD
+        // version's chunks.
+        INFO(("COLOR CONVERSION: testing BGRA to BGR..."));
+        {
+            srand(1);
+
+            std::vector<u8> noise(1021 * 4);
+            std::generate(noise.begin(), noise.end(), []{return u8(rand() % 256);});
+
+            k_assert(is_bgr_conversion_consistent(noise),
+                     "The SIMD and plain conversions of BGRA pixels into BGR differ.");
+        }
+    }
+    catch (std::exception &e)
+    {
+        fprintf(stderr, "Failed to validate '%s'. Encountered the following error: '%s'.\n", ASPECT_TO_TEST, e.what());
+        return EXIT_FAILURE;
+    }
+
+    printf("Successfully validated: '%s'.\n", ASPECT_TO_TEST);
+    return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+    return ktest_unit_color_conversion();
+}
@@ -0,0 +1,190 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ * A test of having the capture hardware downscale frames on the scaler's behalf
+ * (the -s command-line option). Captures a 640 x 480 test pattern for display at
+ * 320 x 240, with the null RGBEASY driver's mock scaler standing in for the
+ * hardware's, and checks that the frames arrive downscaled when nothing needs
+ * them at their full size, and at the capture resolution when something does.
+ *
+ * Run it with -s, both alone and together with an option whose processing needs
+ * the frames at their full size - e.g. -e, -c, or -l. Anti-tearing, which can be
+ * toggled while running, is tested in all cases.
+ *
+ * Will print out "Successfully validated" or "Failed to validate", depending on
+ * whether the test succeeded, and exit with either EXIT_SUCCESS or EXIT_FAILURE
+ * likewise.
+ *
+ */
+
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include "common/command_line.h"
+#include "capture/test_pattern.h"
+#include "filter/active_area.h"
+#include "filter/auto_align.h"
+#include "filter/anti_tear.h"
+#include "capture/capture.h"
+#include "common/globals.h"
+#include "scaler/scaler.h"
+#include "filter/filter.h"
+#include "common/memory.h"
+
+static const char ASPECT_TO_TEST[] = "Hardware downscaling";
+
+extern std::mutex INPUT_OUTPUT_MUTEX;
+
+static const resolution_s CAPTURE_RESOLUTION = {640, 480, 32};
+static const resolution_s OUTPUT_RESOLUTION = {320, 240, 32};
+
+// Processes captured frames as VCS would, having the capture hardware downscale
+// them as the scaler asks, until the given number of frames has been processed.
+// Returns the resolution of the last of them.
+//
+static resolution_s process_frames(const uint numFrames)
+{
+    resolution_s frameRes = {0, 0, 0};
+    uint numProcessed = 0;
+
+    const auto startTime = std::chrono::steady_clock::now();
+    while (numProcessed < numFrames)
+    {
+        k_assert(((std::chrono::steady_clock::now() - startTime) < std::chrono::seconds(10)),
+                 "Timed out waiting for captured frames.");
+
+        {
+            std::lock_guard<std::mutex> lock(INPUT_OUTPUT_MUTEX);
+
+            switch (kc_latest_capture_event())
+            {
+                case capture_event_e::new_video_mode:
+                {
+                    kc_apply_new_capture_resolution();
+                    break;
+                }
+                case capture_event_e::new_frame:
+                {
+                    const captured_frame_s &frame = kc_latest_captured_frame();
+
+                    frameRes = frame.r;
+                    ks_scale_frame(frame);
+                    kc_set_hardware_output_size(ks_hardware_downscaling_size());
+                    kc_mark_current_frame_as_processed();
+
+                    numProcessed++;
+                    break;
+                }
+                case capture_event_e::unrecoverable_error:
+                {
+                    k_assert(0, "The capture met with an unrecoverable error.");
+                    break;
+                }
+                default: break;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return frameRes;
+}
+
+// Checks that frames arrive at the given resolution once the scaler's requested
+// hardware output size has taken effect.
+//
+static void verify_frame_resolution(const resolution_s &expectedRes, const char *const message)
+{
+    // Frames already queued may have been captured before the size changed.
+    process_frames(kcom_num_capture_buffers() + 2);
+
+    const resolution_s frameRes = process_frames(1);
+
+    k_assert(((frameRes.w == expectedRes.w) &&
+              (frameRes.h == expectedRes.h)), message);
+
+    return;
+}
+
+int ktest_unit_hardware_downscaling(void)
+{
+    try
+    {
+        k_assert(kcom_hardware_downscaling(), "This test expects to be run with -s.");
+
+        const bool isFullSizeNeeded = ((kcom_duplicate_frame_threshold() >= 0) ||
+                                       kcom_active_area_interval() ||
+                                       kcom_auto_align_interval());
+
+        // Initialize the system subset to be tested.
+        ks_initialize_scaler();
+        kc_initialize_capture();
+        kat_initialize_anti_tear();
+        kf_initialize_filters();
+        kalign_initialize();
+        karea_initialize();
+
+        k_assert(!PROGRAM_EXIT_REQUESTED, "Failed to initialize the units to be tested.");
+
+        k_assert(((kcom_test_pattern().r.w == CAPTURE_RESOLUTION.w) &&
+                  (kcom_test_pattern().r.h == CAPTURE_RESOLUTION.h)), "Expected a 640 x 480 test pattern.");
+
+        ks_set_forced_aspect_enabled(false);
+        ks_set_output_scale_override_enabled(false);
+        ks_set_output_resolution_override_enabled(true);
+        ks_set_output_base_resolution(OUTPUT_RESOLUTION, true);
+
+        INFO(("HARDWARE DOWNSCALING: testing with the command-line options given..."));
+        if (isFullSizeNeeded)
+        {
+            k_assert(((ks_hardware_downscaling_size().w == CAPTURE_RESOLUTION.w) &&
+                      (ks_hardware_downscaling_size().h == CAPTURE_RESOLUTION.h)),
+                     "Asked for hardware downscaling while the frames are needed at their full size.");
+
+            verify_frame_resolution(CAPTURE_RESOLUTION, "The frames were downscaled while needed at their full size.");
+        }
+        else
+        {
+            verify_frame_resolution(OUTPUT_RESOLUTION, "The frames weren't downscaled.");
+        }
+
+        INFO(("HARDWARE DOWNSCALING: testing with anti-tearing enabled..."));
+        kat_set_anti_tear_enabled(true);
+        verify_frame_resolution(CAPTURE_RESOLUTION, "The frames were downscaled while anti-tearing.");
+
+        INFO(("HARDWARE DOWNSCALING: testing with anti-tearing disabled again..."));
+        kat_set_anti_tear_enabled(false);
+        verify_frame_resolution((isFullSizeNeeded? CAPTURE_RESOLUTION : OUTPUT_RESOLUTION),
+                                "The frames didn't return to their expected size once anti-tearing was disabled.");
+
+        // Release the subsystem.
+        PROGRAM_EXIT_REQUESTED = 1;
+        ks_release_scaler();
+        kc_release_capture();
+        kat_release_anti_tear();
+        kf_release_filters();
+        kalign_release();
+        kmem_deallocate_memory_cache();
+    }
+    catch (std::exception &e)
+    {
+        fprintf(stderr, "Failed to validate '%s'. Encountered the following error: '%s'.\n", ASPECT_TO_TEST, e.what());
+        return EXIT_FAILURE;
+    }
+
+    printf("Successfully validated: '%s'.\n", ASPECT_TO_TEST);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!kcom_parse_command_line(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return ktest_unit_hardware_downscaling();
+}
@@ -0,0 +1,122 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ * A test of VCS's own whole-number ratio scalers against OpenCV's, which they
+ * stand in for. Scales BGRA noise up and down by a set of whole-number factors -
+ * including non-square and odd ones - with the native scalers, and with
+ * cv::resize() using nearest-neighbor (up) and area (down) interpolation; and
+ * checks that the two give the same output.
+ *
+ * Will print out "Successfully validated" or "Failed to validate", depending on
+ * whether the test succeeded, and exit with either EXIT_SUCCESS or EXIT_FAILURE
+ * likewise.
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include "scaler/native_scaler.h"
+#include "common/globals.h"
+
+#ifdef USE_OPENCV
+    #include <opencv2/imgproc/imgproc.hpp>
+    #include <opencv2/core/core.hpp>
+#endif
+
+static const char ASPECT_TO_TEST[] = "Whole-number ratio scaling";
+
+static const struct
+{
+    uint x;
+    uint y;
+} FACTORS[] = {{2, 2},
+               {3, 3},
+               {4, 4},
+               {5, 5},
+               {8, 8},
+               {2, 1},
+               {1, 2},
+               {3, 1},
+               {4, 2},
+               {2, 4},
+               {3, 2},
+               {6, 4}};
+
+// The size of the smaller of the two images being scaled between; odd, so that
+// the rows don't divide evenly into the SIMD versions' chunks.
+static const resolution_s SMALL_RES = {161, 121, 32};
+
+#ifdef USE_OPENCV
+// Scales the given BGRA pixels from srcRes to dstRes with the given native
+// scaler and with cv::resize() using the given interpolation, and returns true
+// if both give the same output.
+//
+static bool is_same_as_opencv(native_scaler_func_t scaler, const int interpolation,
+                              std::vector<u8> &src, const resolution_s &srcRes, const resolution_s &dstRes)
+{
+    std::vector<u8> nativeOutput(dstRes.w * dstRes.h * 4);
+    std::vector<u8> opencvOutput(dstRes.w * dstRes.h * 4);
+
+    native_scaling_plan_s plan;
+    kns_make_plan(&plan, srcRes, RGB_PIXELFORMAT_888, dstRes);
+    scaler(src.data(), nativeOutput.data(), (dstRes.w * 4), plan, 0, dstRes.h);
+
+    cv::Mat srcMat(srcRes.h, srcRes.w, CV_8UC4, src.data());
+    cv::Mat dstMat(dstRes.h, dstRes.w, CV_8UC4, opencvOutput.data());
+    cv::resize(srcMat, dstMat, dstMat.size(), 0, 0, interpolation);
+
+    return (nativeOutput == opencvOutput);
+}
+#endif
+
+int ktest_unit_integer_scaling(void)
+{
+    try
+    {
+#ifdef USE_OPENCV
+        srand(1);
+
+        for (const auto &factor: FACTORS)
+        {
+            const resolution_s largeRes = {(SMALL_RES.w * factor.x), (SMALL_RES.h * factor.y), 32};
+
+            INFO(("INTEGER SCALING: testing by %u x %u...", factor.x, factor.y));
+
+            std::vector<u8> small(SMALL_RES.w * SMALL_RES.h * 4);
+            std::generate(small.begin(), small.end(), []{return u8(rand() % 256);});
+
+            k_assert(is_same_as_opencv(kns_scale_integer_up, cv::INTER_NEAREST, small, SMALL_RES, largeRes),
+                     "Whole-number upscaling differs from OpenCV's nearest-neighbor upscaling.");
+
+            // Besides plain noise, noise of only the extreme values, for blocks
+            // whose averages fall halfway between two values.
+            for (const uint numLevels: {256u, 2u})
+            {
+                std::vector<u8> large(largeRes.w * largeRes.h * 4);
+                std::generate(large.begin(), large.end(), [numLevels]{return u8((rand() % numLevels) * (255 / (numLevels - 1)));});
+
+                k_assert(is_same_as_opencv(kns_scale_integer_down, cv::INTER_AREA, large, largeRes, SMALL_RES),
+                         "Whole-number downscaling differs from OpenCV's area downscaling.");
+            }
+        }
+#else
+        INFO(("INTEGER SCALING: VCS was built without OpenCV, so there's nothing to compare against."));
+#endif
+    }
+    catch (std::exception &e)
+    {
+        fprintf(stderr, "Failed to validate '%s'. Encountered the following error: '%s'.\n", ASPECT_TO_TEST, e.what());
+        return EXIT_FAILURE;
+    }
+
+    printf("Successfully validated: '%s'.\n", ASPECT_TO_TEST);
+    return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+    return ktest_unit_integer_scaling();
+}
@@ -0,0 +1,319 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ * A test of VCS's own scalers. Scales noise of each of the capture pixel formats
+ * between a set of sizes - including ones small and odd enough that the rows
+ * don't divide evenly into the SIMD versions' chunks - with each of the scalers
+ * that applies, and checks the output against a plain reference implementation
+ * of the same scaling in this file. Also checks that scaling in bands gives the
+ * same output as scaling the whole image, and that the scalers leave alone the
+ * parts of the output buffer outside the image.
+ *
+ * Will print out "Successfully validated" or "Failed to validate", depending on
+ * whether the test succeeded, and exit with either EXIT_SUCCESS or EXIT_FAILURE
+ * likewise.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include "scaler/color_conversion.h"
+#include "scaler/native_scaler.h"
+#include "common/globals.h"
+
+static const char ASPECT_TO_TEST[] = "Native scalers";
+
+// Bilinear blending weights are fixed-point fractions of this many bits, as in
+// the native scaler.
+static const uint WEIGHT_BITS = 7;
+static const uint WEIGHT_ONE = (1 << WEIGHT_BITS);
+
+// How many bytes past the end of each output row the output buffer extends, for
+// checking that nothing's written there.
+static const uint DST_PITCH_PADDING = 12;
+static const u8 PADDING_VALUE = 0xa5;
+
+static const struct
+{
+    resolution_s src;
+    resolution_s dst;
+} SIZES[] = {{{1,   1,   0}, {1,    1,   0}},
+             {{2,   2,   0}, {7,    5,   0}},
+             {{6,   5,   0}, {13,   11,  0}},
+             {{14,  11,  0}, {6,    5,   0}},
+             {{10,  7,   0}, {10,   33,  0}},
+             {{10,  7,   0}, {34,   7,   0}},
+             {{9,   6,   0}, {27,   18,  0}},
+             {{30,  20,  0}, {10,   4,   0}},
+             {{34,  18,  0}, {17,   9,   0}},
+             {{320, 200, 0}, {1280, 800, 0}},
+             {{640, 480, 0}, {320,  240, 0}},
+             {{642, 482, 0}, {321,  241, 0}},
+             {{720, 400, 0}, {720,  540, 0}},
+             {{720, 400, 0}, {960,  400, 0}},
+             {{800, 600, 0}, {640,  480, 0}}};
+
+static const struct
+{
+    uint bpp;
+    PIXELFORMAT pixelFormat;
+} FORMATS[] = {{32, RGB_PIXELFORMAT_888},
+               {24, RGB_PIXELFORMAT_888},
+               {16, RGB_PIXELFORMAT_565},
+               {16, RGB_PIXELFORMAT_555},
+               {16, RGB_PIXELFORMAT_YUY2}};
+
+// An image in BGRA.
+struct image_s
+{
+    uint w;
+    uint h;
+    std::vector<u8> pixels;
+
+    u8* pixel(const uint x, const uint y)
+    {
+        return &pixels[((y * w) + x) * 4];
+    }
+};
+
+// Returns the given source pixels converted into BGRA. Each pixel (or YUY2 pair
+// of pixels) is converted on its own, which is too few for the SIMD conversions.
+//
+static image_s bgra_image(const std::vector<u8> &src, const resolution_s &r, const PIXELFORMAT pixelFormat)
+{
+    const uint numPixelsAtATime = ((pixelFormat == RGB_PIXELFORMAT_YUY2)? 2 : 1);
+    image_s image = {uint(r.w), uint(r.h), std::vector<u8>(r.w * r.h * 4)};
+
+    for (uint i = 0; i < (r.w * r.h); i += numPixelsAtATime)
+    {
+        kconv_convert_row_to_bgra(&src[i * (r.bpp / 8)], &image.pixels[i * 4], numPixelsAtATime, r.bpp, pixelFormat);
+    }
+
+    return image;
+}
+
+static u8 blend(const uint a, const uint b, const uint weight)
+{
+    return (((a * (WEIGHT_ONE - weight)) + (b * weight) + (WEIGHT_ONE / 2)) >> WEIGHT_BITS);
+}
+
+static image_s reference_nearest(image_s &src, const native_scaling_plan_s &plan)
+{
+    image_s dst = {uint(plan.dstRes.w), uint(plan.dstRes.h), std::vector<u8>(plan.dstRes.w * plan.dstRes.h * 4)};
+
+    for (uint y = 0; y < dst.h; y++)
+    {
+        for (uint x = 0; x < dst.w; x++)
+        {
+            std::copy_n(src.pixel(plan.nearestColumns[x], plan.nearestRows[y]), 4, dst.pixel(x, y));
+        }
+    }
+
+    return dst;
+}
+
+// Bilinear scaling blends the source rows first, then the blended row's pixels;
+// either pass being left out along an axis whose size doesn't change, if so
+// asked.
+//
+static image_s reference_linear(image_s &src, const native_scaling_plan_s &plan,
+                                const bool scaleVertically, const bool scaleHorizontally)
+{
+    image_s dst = {uint(plan.dstRes.w), uint(plan.dstRes.h), std::vector<u8>(plan.dstRes.w * plan.dstRes.h * 4)};
+    std::vector<u8> blendedRow(src.w * 4);
+
+    for (uint y = 0; y < dst.h; y++)
+    {
+        if (scaleVertically)
+        {
+            const linear_sample_s &row = plan.linearRows[y];
+            const uint nextRowIdx = std::min((row.idx + 1), (src.h - 1));
+
+            for (uint i = 0; i < (src.w * 4); i++)
+            {
+                blendedRow[i] = blend(src.pixel(0, row.idx)[i], src.pixel(0, nextRowIdx)[i], row.weight);
+            }
+        }
+        else
+        {
+            std::copy_n(src.pixel(0, y), (src.w * 4), blendedRow.begin());
+        }
+
+        for (uint x = 0; x < dst.w; x++)
+        {
+            for (uint c = 0; c < 4; c++)
+            {
+                if (scaleHorizontally)
+                {
+                    const linear_sample_s &column = plan.linearColumns[x];
+                    const uint nextColumnIdx = std::min((column.idx + 1), (src.w - 1));
+
+                    dst.pixel(x, y)[c] = blend(blendedRow[(column.idx * 4) + c], blendedRow[(nextColumnIdx * 4) + c], column.weight);
+                }
+                else
+                {
+                    dst.pixel(x, y)[c] = blendedRow[(x * 4) + c];
+                }
+            }
+        }
+    }
+
+    return dst;
+}
+
+// Area downscaling by a whole number, each output pixel being the average of its
+// block of source pixels; rounded half up for 2 x 2 blocks, and otherwise to the
+// nearest value, or on a tie to the even one, as in OpenCV.
+//
+static image_s reference_integer_down(image_s &src, const native_scaling_plan_s &plan)
+{
+    image_s dst = {uint(plan.dstRes.w), uint(plan.dstRes.h), std::vector<u8>(plan.dstRes.w * plan.dstRes.h * 4)};
+    const uint factorX = (src.w / dst.w);
+    const uint factorY = (src.h / dst.h);
+    const uint blockSize = (factorX * factorY);
+
+    for (uint y = 0; y < dst.h; y++)
+    {
+        for (uint x = 0; x < dst.w; x++)
+        {
+            for (uint c = 0; c < 4; c++)
+            {
+                uint sum = 0;
+
+                for (uint by = 0; by < factorY; by++)
+                {
+                    for (uint bx = 0; bx < factorX; bx++)
+                    {
+                        sum += src.pixel(((x * factorX) + bx), ((y * factorY) + by))[c];
+                    }
+                }
+
+                dst.pixel(x, y)[c] = (((factorX == 2) && (factorY == 2))? ((sum + 2) / 4)
+                                      : u8(std::min(255L, lrintf(float(sum) * (1.0f / blockSize)))));
+            }
+        }
+    }
+
+    return dst;
+}
+
+// Scales the given source pixels with the given scaler, in the given number of
+// bands, and checks the output against the given reference image.
+//
+static void verify_scaler(native_scaler_func_t scaler, const char *const scalerName,
+                          const std::vector<u8> &src, const native_scaling_plan_s &plan,
+                          const image_s &reference, const uint numBands)
+{
+    const resolution_s &dstRes = plan.dstRes;
+    const uint dstPitch = ((dstRes.w * 4) + DST_PITCH_PADDING);
+    std::vector<u8> dst((dstPitch * dstRes.h), PADDING_VALUE);
+
+    for (uint b = 0; b < numBands; b++)
+    {
+        scaler(src.data(), dst.data(), dstPitch, plan, ((dstRes.h * b) / numBands), ((dstRes.h * (b + 1)) / numBands));
+    }
+
+    for (uint y = 0; y < dstRes.h; y++)
+    {
+        const u8 *const dstRow = &dst[y * dstPitch];
+
+        if (!std::equal(dstRow, (dstRow + (dstRes.w * 4)), &reference.pixels[y * dstRes.w * 4]) ||
+            !std::all_of((dstRow + (dstRes.w * 4)), (dstRow + dstPitch), [](const u8 v){return (v == PADDING_VALUE);}))
+        {
+            fprintf(stderr, "%s: %lu x %lu x %lu (format %d) to %lu x %lu in %u band(s), row %u.\n",
+                    scalerName, plan.srcRes.w, plan.srcRes.h, plan.srcRes.bpp, plan.srcPixelFormat,
+                    dstRes.w, dstRes.h, numBands, y);
+
+            k_assert(0, "A native scaler's output differs from the reference.");
+        }
+    }
+
+    return;
+}
+
+int ktest_unit_native_scaler(void)
+{
+    try
+    {
+        srand(1);
+
+        for (const auto &format: FORMATS)
+        {
+            for (const auto &size: SIZES)
+            {
+                const resolution_s srcRes = {size.src.w, size.src.h, format.bpp};
+                const resolution_s dstRes = {size.dst.w, size.dst.h, 32};
+
+                if (!kconv_can_convert_to_bgra(srcRes, format.pixelFormat))
+                {
+                    continue;
+                }
+
+                INFO(("NATIVE SCALERS: testing %lu x %lu x %lu (format %d) to %lu x %lu...",
+                      srcRes.w, srcRes.h, srcRes.bpp, format.pixelFormat, dstRes.w, dstRes.h));
+
+                std::vector<u8> src(srcRes.w * srcRes.h * (srcRes.bpp / 8));
+                std::generate(src.begin(), src.end(), []{return u8(rand() % 256);});
+
+                image_s bgraSrc = bgra_image(src, srcRes, format.pixelFormat);
+
+                native_scaling_plan_s plan;
+                kns_make_plan(&plan, srcRes, format.pixelFormat, dstRes);
+
+                const image_s nearest = reference_nearest(bgraSrc, plan);
+                const image_s linear = reference_linear(bgraSrc, plan, true, true);
+
+                for (const uint numBands: {1u, 3u})
+                {
+                    verify_scaler(kns_scale_nearest, "Nearest", src, plan, nearest, numBands);
+                    verify_scaler(kns_scale_linear, "Linear", src, plan, linear, numBands);
+
+                    if (srcRes.w == dstRes.w)
+                    {
+                        verify_scaler(kns_scale_nearest_vertical, "Nearest (vertical)", src, plan, nearest, numBands);
+                        verify_scaler(kns_scale_linear_vertical, "Linear (vertical)", src, plan,
+                                      reference_linear(bgraSrc, plan, true, false), numBands);
+                    }
+
+                    if (srcRes.h == dstRes.h)
+                    {
+                        verify_scaler(kns_scale_linear_horizontal, "Linear (horizontal)", src, plan,
+                                      reference_linear(bgraSrc, plan, false, true), numBands);
+                    }
+
+                    // Upscaling by whole numbers replicates pixels as nearest-
+                    // neighbor upscaling would.
+                    if (!(dstRes.w % srcRes.w) &&
+                        !(dstRes.h % srcRes.h))
+                    {
+                        verify_scaler(kns_scale_integer_up, "Integer (up)", src, plan, nearest, numBands);
+                    }
+
+                    if (!(srcRes.w % dstRes.w) &&
+                        !(srcRes.h % dstRes.h))
+                    {
+                        verify_scaler(kns_scale_integer_down, "Integer (down)", src, plan,
+                                      reference_integer_down(bgraSrc, plan), numBands);
+                    }
+                }
+            }
+        }
+    }
+    catch (std::exception &e)
+    {
+        fprintf(stderr, "Failed to validate '%s'. Encountered the following error: '%s'.\n", ASPECT_TO_TEST, e.what());
+        return EXIT_FAILURE;
+    }
+
+    printf("Successfully validated: '%s'.\n", ASPECT_TO_TEST);
+    return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+    return ktest_unit_native_scaler();
+}
@@ -0,0 +1,110 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft /
+ * VCS
+ *
+ * A test of VCS's own nearest-neighbor scalers against OpenCV's, which they
+ * stand in for when only one of the image's dimensions changes. Scales BGRA
+ * noise between a set of sizes - including ones for which OpenCV's floating-
+ * point arithmetic picks other pixels than exact division would - with the
+ * native scalers and with cv::resize() using nearest-neighbor interpolation,
+ * and checks that the two give the same output.
+ *
+ * Will print out "Successfully validated" or "Failed to validate", depending on
+ * whether the test succeeded, and exit with either EXIT_SUCCESS or EXIT_FAILURE
+ * likewise.
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include "scaler/native_scaler.h"
+#include "common/globals.h"
+
+#ifdef USE_OPENCV
+    #include <opencv2/imgproc/imgproc.hpp>
+    #include <opencv2/core/core.hpp>
+#endif
+
+static const char ASPECT_TO_TEST[] = "Nearest-neighbor scaling";
+
+static const struct
+{
+    resolution_s src;
+    resolution_s dst;
+} SIZES[] = {{{720, 400, 32}, {720,  540, 32}},
+             {{640, 400, 32}, {640,  480, 32}},
+             {{720, 400, 32}, {960,  400, 32}},
+             {{800, 600, 32}, {640,  600, 32}},
+             {{14,  14,  32}, {14,   400, 32}},
+             {{14,  14,  32}, {800,  14,  32}},
+             {{12,  6,   32}, {148,  6,   32}},
+             {{6,   12,  32}, {6,    106, 32}},
+             {{14,  12,  32}, {50,   148, 32}}};
+
+#ifdef USE_OPENCV
+// Scales the given BGRA pixels from srcRes to dstRes with the given native
+// scaler and with cv::resize() using nearest-neighbor interpolation, and returns
+// true if both give the same output.
+//
+static bool is_same_as_opencv(native_scaler_func_t scaler, std::vector<u8> &src,
+                              const resolution_s &srcRes, const resolution_s &dstRes)
+{
+    std::vector<u8> nativeOutput(dstRes.w * dstRes.h * 4);
+    std::vector<u8> opencvOutput(dstRes.w * dstRes.h * 4);
+
+    native_scaling_plan_s plan;
+    kns_make_plan(&plan, srcRes, RGB_PIXELFORMAT_888, dstRes);
+    scaler(src.data(), nativeOutput.data(), (dstRes.w * 4), plan, 0, dstRes.h);
+
+    cv::Mat srcMat(srcRes.h, srcRes.w, CV_8UC4, src.data());
+    cv::Mat dstMat(dstRes.h, dstRes.w, CV_8UC4, opencvOutput.data());
+    cv::resize(srcMat, dstMat, dstMat.size(), 0, 0, cv::INTER_NEAREST);
+
+    return (nativeOutput == opencvOutput);
+}
+#endif
+
+int ktest_unit_nearest_scaling(void)
+{
+    try
+    {
+#ifdef USE_OPENCV
+        srand(1);
+
+        for (const auto &size: SIZES)
+        {
+            INFO(("NEAREST SCALING: testing %lu x %lu to %lu x %lu...",
+                  size.src.w, size.src.h, size.dst.w, size.dst.h));
+
+            std::vector<u8> src(size.src.w * size.src.h * 4);
+            std::generate(src.begin(), src.end(), []{return u8(rand() % 256);});
+
+            k_assert(is_same_as_opencv(kns_scale_nearest, src, size.src, size.dst),
+                     "Nearest-neighbor scaling differs from OpenCV's.");
+
+            if (size.src.w == size.dst.w)
+            {
+                k_assert(is_same_as_opencv(kns_scale_nearest_vertical, src, size.src, size.dst),
+                         "Vertical nearest-neighbor scaling differs from OpenCV's.");
+            }
+        }
+#else
+        INFO(("NEAREST SCALING: VCS was built without OpenCV, so there's nothing to compare against."));
+#endif
+    }
+    catch (std::exception &e)
+    {
+        fprintf(stderr, "Failed to validate '%s'. Encountered the following error: '%s'.\n", ASPECT_TO_TEST, e.what());
+        return EXIT_FAILURE;
+    }
+
+    printf("Successfully validated: '%s'.\n", ASPECT_TO_TEST);
+    return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+    return ktest_unit_nearest_scaling();
+}
@@ -1,4 +1,4 @@
-# Comment out to disable OpenCV. You'll have no filtering or scaler, but you also don't need to provide the dependencies.
+# Comment out to disable OpenCV. You'll have no filtering, and only the native nearest and linear scalers, but you also don't need to provide the dependencies.
 DEFINES += USE_OPENCV
 
 # Comment out to disable capture functionality. Useful for testing the program where a capture card isn't present.
@@ -68,16 +68,26 @@ SOURCES += \
     src/display/qt/dialogs/alias_dialog.cpp \
     src/display/qt/dialogs/anti_tear_dialog.cpp \
     src/scaler/scaler.cpp \
+    src/scaler/color_conversion.cpp \
+    src/scaler/native_scaler.cpp \
     src/main.cpp \
     src/common/log.cpp \
     src/filter/filter.cpp \
     src/common/command_line.cpp \
     src/capture/capture.cpp \
+    src/capture/frame_ring.cpp \
+    src/capture/null_rgbeasy.cpp \
+    src/capture/capture_dump.cpp \
+    src/capture/frame_dedup.cpp \
+    src/capture/test_pattern.cpp \
+    src/filter/active_area.cpp \
     src/filter/anti_tear.cpp \
+    src/filter/auto_align.cpp \
     src/display/qt/persistent_settings.cpp \
     src/common/memory.cpp \
     src/record/record.cpp \
     src/common/propagate.cpp \
+    src/common/parallel.cpp \
     src/common/disk.cpp \
     src/capture/alias.cpp \
     src/display/qt/subclasses/QOpenGLWidget_opengl_renderer.cpp \
@@ -100,13 +110,21 @@ HEADERS += \
     src/display/qt/windows/output_window.h \
     src/display/qt/dialogs/resolution_dialog.h \
     src/scaler/scaler.h \
+    src/scaler/color_conversion.h \
+    src/scaler/native_scaler.h \
     src/capture/capture.h \
+    src/capture/frame_ring.h \
+    src/capture/capture_dump.h \
+    src/capture/frame_dedup.h \
+    src/capture/test_pattern.h \
     src/display/display.h \
     src/common/log.h \
     src/display/qt/dialogs/video_and_color_dialog.h \
     src/display/qt/dialogs/overlay_dialog.h \
     src/display/qt/dialogs/alias_dialog.h \
+    src/filter/active_area.h \
     src/filter/anti_tear.h \
+    src/filter/auto_align.h \
     src/display/qt/dialogs/anti_tear_dialog.h \
     src/filter/filter.h \
     src/common/command_line.h \
@@ -117,6 +135,7 @@ HEADERS += \
     src/common/memory_interface.h \
     src/record/record.h \
     src/common/propagate.h \
+    src/common/parallel.h \
     src/common/disk.h \
     src/capture/alias.h \
     src/display/qt/subclasses/QOpenGLWidget_opengl_renderer.h \